@@ -0,0 +1 @@
+#include "../src/arena.h"
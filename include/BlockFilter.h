@@ -0,0 +1 @@
+#include "../src/blockfilter.h"
@@ -0,0 +1 @@
+#include "../src/blockspiller.h"
@@ -0,0 +1 @@
+#include "../src/complexconverter.h"
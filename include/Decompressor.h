@@ -0,0 +1 @@
+#include "../src/decompressor.h"
@@ -0,0 +1 @@
+#include "../src/diagnostics.h"
@@ -0,0 +1 @@
+#include "../src/filefollower.h"
@@ -0,0 +1 @@
+#include "../src/idset.h"
@@ -0,0 +1 @@
+#include "../src/inputpipeline.h"
@@ -0,0 +1 @@
+#include "../src/numberparser.h"
@@ -0,0 +1 @@
+#include "../src/punchindex.h"
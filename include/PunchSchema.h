@@ -0,0 +1 @@
+#include "../src/punchschema.h"
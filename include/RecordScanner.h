@@ -0,0 +1 @@
+#include "../src/recordscanner.h"
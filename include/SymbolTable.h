@@ -0,0 +1 @@
+#include "../src/symboltable.h"
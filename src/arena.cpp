@@ -0,0 +1,176 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "arena.h"
+
+#include <cstdlib>
+
+/*! \class Arena
+ *  \brief The class Arena is a monotonic memory resource.
+ *
+ * The memory is reserved by chunks of C_ARENA_CHUNK_SIZE bytes, and the
+ * allocations are served by bumping a pointer in the current chunk.
+ * Deallocating is a no-op, except for the last allocation (so a growing
+ * vector can reuse its memory) and for the large allocations, that get their
+ * own memory. All the memory is released at once when the Arena is destroyed.
+ *
+ * Use an \a ArenaAllocator to back a standard container with an Arena.
+ * The Arena is thread-safe.
+ *
+ * The counters compare the number of allocations served by the Arena with
+ * the number of allocations actually made to the system.
+ *
+ * \example
+ *
+ * \code
+ * std::shared_ptr<Arena> arena = std::make_shared<Arena>();
+ * std::vector<int, ArenaAllocator<int> > v( (ArenaAllocator<int>(arena)) );
+ * \endcode
+ */
+/*! \brief Constructor.
+ */
+Arena::Arena()
+    : m_current(0)
+    , m_remaining(0)
+    , m_allocationCount(0)
+    , m_allocatedBytes(0)
+    , m_systemAllocationCount(0)
+    , m_reservedBytes(0)
+{
+}
+
+/*! \brief Destructor. Releases all the memory.
+ */
+Arena::~Arena()
+{
+    for (char *chunk : m_chunks) {
+        std::free(chunk);
+    }
+    for (void *block : m_largeBlocks) {
+        std::free(block);
+    }
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns \a size bytes aligned on \a alignment.
+ * Throws std::bad_alloc if the memory can't be reserved.
+ */
+void* Arena::allocate(const std::size_t size, const std::size_t alignment)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    ++m_allocationCount;
+    m_allocatedBytes += size;
+
+    if (size >= C_ARENA_LARGE_SIZE) {
+        void *block = std::malloc(size);
+        if (!block) {
+            throw std::bad_alloc();
+        }
+        try {
+            m_largeBlocks.insert( block );
+        } catch (...) {
+            std::free(block);
+            throw;
+        }
+        ++m_systemAllocationCount;
+        m_reservedBytes += size;
+        return block;
+    }
+
+    std::size_t padding = reinterpret_cast<std::size_t>(m_current) % alignment;
+    if (padding != 0) {
+        padding = alignment - padding;
+    }
+    if (!m_current || padding + size > m_remaining) {
+        m_chunks.reserve( m_chunks.size() + 1 );
+        char *chunk = static_cast<char*>(std::malloc(C_ARENA_CHUNK_SIZE));
+        if (!chunk) {
+            throw std::bad_alloc();
+        }
+        ++m_systemAllocationCount;
+        m_reservedBytes += C_ARENA_CHUNK_SIZE;
+        m_chunks.push_back( chunk );
+        m_current = chunk;
+        m_remaining = C_ARENA_CHUNK_SIZE;
+        padding = 0;
+    }
+
+    char *p = m_current + padding;
+    m_current = p + size;
+    m_remaining -= padding + size;
+    return p;
+}
+
+/*! \brief Releases the memory \a p of \a size bytes.
+ *
+ * Only the large allocations and the last allocation are actually released.
+ * The large allocations are found in constant time.
+ */
+void Arena::deallocate(void *p, const std::size_t size)
+{
+    if (!p) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (size >= C_ARENA_LARGE_SIZE) {
+        if (m_largeBlocks.erase(p) > 0) {
+            std::free(p);
+            m_reservedBytes -= size;
+        }
+        return;
+    }
+
+    if (static_cast<char*>(p) + size == m_current) {
+        m_current = static_cast<char*>(p);
+        m_remaining += size;
+    }
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns the number of allocations served by the Arena.
+ */
+std::size_t Arena::allocationCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_allocationCount;
+}
+
+/*! \brief Returns the total number of bytes allocated in the Arena.
+ */
+std::size_t Arena::allocatedBytes() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_allocatedBytes;
+}
+
+/*! \brief Returns the number of allocations made to the system.
+ */
+std::size_t Arena::systemAllocationCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_systemAllocationCount;
+}
+
+/*! \brief Returns the number of bytes currently reserved from the system.
+ */
+std::size_t Arena::reservedBytes() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_reservedBytes;
+}
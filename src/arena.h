@@ -0,0 +1,131 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+/*!
+ * C_ARENA_CHUNK_SIZE
+ *
+ * Size (in bytes) of the chunks reserved by the Arena.
+ */
+#define C_ARENA_CHUNK_SIZE (1024 * 1024)
+
+/*!
+ * C_ARENA_LARGE_SIZE
+ *
+ * Minimal size (in bytes) of the allocations that get their own memory,
+ * and are released as soon as they are deallocated.
+ */
+#define C_ARENA_LARGE_SIZE (64 * 1024)
+
+class Arena
+{
+public:
+    explicit Arena();
+    ~Arena();
+
+    void* allocate(const std::size_t size, const std::size_t alignment);
+    void deallocate(void *p, const std::size_t size);
+
+    /* Counters */
+    std::size_t allocationCount() const;
+    std::size_t allocatedBytes() const;
+    std::size_t systemAllocationCount() const;
+    std::size_t reservedBytes() const;
+
+private:
+    Arena(const Arena &);               /* Not copyable */
+    Arena& operator=(const Arena &);
+
+    mutable std::mutex m_mutex;
+    std::vector<char*> m_chunks;
+    std::unordered_set<void*> m_largeBlocks;
+    char *m_current;
+    std::size_t m_remaining;
+
+    std::size_t m_allocationCount;
+    std::size_t m_allocatedBytes;
+    std::size_t m_systemAllocationCount;
+    std::size_t m_reservedBytes;
+};
+
+/*!
+ * ArenaAllocator
+ *
+ * A standard allocator that allocates the memory in an Arena.
+ * The allocator shares the ownership of the Arena, so the memory remains
+ * valid as long as a container uses it.
+ *
+ * A default-constructed allocator (without Arena) uses the heap.
+ */
+template <class T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    ArenaAllocator() {}
+    explicit ArenaAllocator(const std::shared_ptr<Arena> &arena) : m_arena(arena) {}
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : m_arena(other.arena()) {}
+
+    T* allocate(const std::size_t n)
+    {
+        if (!m_arena) {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *p, const std::size_t n)
+    {
+        if (!m_arena) {
+            ::operator delete(p);
+            return;
+        }
+        m_arena->deallocate(p, n * sizeof(T));
+    }
+
+    const std::shared_ptr<Arena>& arena() const { return m_arena; }
+
+private:
+    std::shared_ptr<Arena> m_arena;
+};
+
+template <class T, class U>
+inline bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+{
+    return a.arena() == b.arena();
+}
+
+template <class T, class U>
+inline bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+{
+    return a.arena() != b.arena();
+}
+
+#endif // ARENA_H
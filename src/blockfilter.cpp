@@ -0,0 +1,224 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "blockfilter.h"
+
+#include "idset.h"
+#include "punchfile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>  // strtol()
+
+using namespace std;
+
+/*! \class BlockFilter
+ *  \brief The class BlockFilter selects the blocks from their header.
+ *
+ * The criteria are:
+ * - the subcases (header 'SUBCASE ID'), as a list of ids and ranges,
+ * - the value of any header (for instance 'LABEL'),
+ * - the result type, i.e. the title of the result ('DISPLACEMENTS',
+ *   'ELEMENT FORCES'...), case-insensitive,
+ * - the entity ids (grids, elements...), as a \a IdSet tested against
+ *   the first field of each row.
+ *
+ * A block is accepted if it matches all the criteria. Several values
+ * of the same criterion are alternatives. An empty filter accepts
+ * all the blocks.
+ *
+ * The \a Reader evaluates the filter as soon as the header section of
+ * a block ends: the rows of the rejected blocks aren't tokenized.
+ * Likewise, the rows of the rejected ids, and their continuation lines,
+ * are skipped, and the blocks left without row are dropped.
+ *
+ * \example
+ *
+ * \code
+ * BlockFilter filter;
+ * filter.addSubcases("1,10-20");
+ * filter.addResultType("displacements");
+ * reader.setFilter(filter);
+ * \endcode
+ */
+/*! \brief Constructor.
+ */
+BlockFilter::BlockFilter()
+{
+}
+
+/******************************************************************************
+ ******************************************************************************/
+bool BlockFilter::isEmpty() const
+{
+    return m_subcases.empty() && m_headers.empty() && m_resultTypes.empty() && !m_ids;
+}
+
+void BlockFilter::clear()
+{
+    m_subcases.clear();
+    m_headers.clear();
+    m_resultTypes.clear();
+    m_ids.reset();
+}
+
+/******************************************************************************
+ ******************************************************************************/
+static string toUpper(string text)
+{
+    std::transform(text.begin(), text.end(), text.begin(), ::toupper);
+    return text;
+}
+
+static bool parseInt(const string &text, int *value)
+{
+    const char *begin = text.c_str();
+    char *end = 0;
+    const long result = std::strtol(begin, &end, 10);
+    if (end == begin) {
+        return false;
+    }
+    while (*end == ' ' || *end == '\t') {
+        ++end;
+    }
+    if (*end != '\0') {
+        return false;
+    }
+    *value = static_cast<int>(result);
+    return true;
+}
+
+/*! \brief Accepts the subcases of the given \a list, for instance "1,3,10-20".
+ * Returns \a false if the list is invalid.
+ */
+bool BlockFilter::addSubcases(const string &list)
+{
+    std::vector<std::pair<int, int> > ranges;
+    string::size_type begin = 0;
+    while (begin <= list.size()) {
+        string::size_type end = list.find(',', begin);
+        if (end == string::npos) {
+            end = list.size();
+        }
+        const string item = list.substr(begin, end - begin);
+        const string::size_type dash = item.find('-', 1);
+        int first = 0;
+        int last = 0;
+        if (dash == string::npos) {
+            if (!parseInt(item, &first)) {
+                return false;
+            }
+            last = first;
+        } else if (!parseInt(item.substr(0, dash), &first)
+                   || !parseInt(item.substr(dash + 1), &last)
+                   || last < first) {
+            return false;
+        }
+        ranges.push_back( std::make_pair(first, last) );
+        begin = end + 1;
+    }
+    m_subcases.insert(m_subcases.end(), ranges.begin(), ranges.end());
+    return true;
+}
+
+/*! \brief Accepts the blocks whose header \a key has the given \a value.
+ */
+void BlockFilter::addHeader(const string &key, const string &value)
+{
+    m_headers[key].insert(value);
+}
+
+/*! \brief Accepts the blocks of the given result \a title
+ * (case-insensitive).
+ */
+void BlockFilter::addResultType(const string &title)
+{
+    m_resultTypes.insert( toUpper(title) );
+}
+
+/*! \brief Accepts the rows whose first field is one of the given \a ids.
+ * The set is shared by the copies of the filter.
+ */
+void BlockFilter::setIds(const IdSet &ids)
+{
+    m_ids = std::make_shared<const IdSet>(ids);
+}
+
+/******************************************************************************
+ ******************************************************************************/
+static const string* findPrefix(const PunchBlock &block, const string &key)
+{
+    for (int i = 0; i < block.prefixCount(); ++i) {
+        if (block.prefixKey(i) == key) {
+            return &block.prefixValue(i);
+        }
+    }
+    return 0;
+}
+
+/*! \brief Returns \a true if the block, with the given header and
+ * \a resultTitle, matches the criteria.
+ */
+bool BlockFilter::accepts(const PunchBlock &block, const string &resultTitle) const
+{
+    if (!m_subcases.empty()) {
+        const string *value = findPrefix(block, "SUBCASE ID");
+        int id = 0;
+        if (!value || !parseInt(*value, &id)) {
+            return false;
+        }
+        bool found = false;
+        for (auto &range : m_subcases) {
+            if (range.first <= id && id <= range.second) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    for (auto &header : m_headers) {
+        const string *value = findPrefix(block, header.first);
+        if (!value || header.second.count(*value) == 0) {
+            return false;
+        }
+    }
+    if (!m_resultTypes.empty() && m_resultTypes.count( toUpper(resultTitle) ) == 0) {
+        return false;
+    }
+    return true;
+}
+
+/*! \brief Returns \a true if the first field of a row, from \a begin
+ * to \a end, begins with an accepted id.
+ */
+bool BlockFilter::acceptsId(const char *begin, const char *end) const
+{
+    if (!m_ids) {
+        return true;
+    }
+    std::uint32_t id = 0;
+    return IdSet::parseId(begin, end, &id) && m_ids->contains(id);
+}
+
+/*! \brief Returns the criteria of the rows only, i.e. the ids.
+ */
+BlockFilter BlockFilter::rowFilter() const
+{
+    BlockFilter filter;
+    filter.m_ids = m_ids;
+    return filter;
+}
@@ -0,0 +1,58 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BLOCK_FILTER_H
+#define BLOCK_FILTER_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+class IdSet;
+class PunchBlock;
+
+class BlockFilter
+{
+public:
+    explicit BlockFilter();
+
+    bool isEmpty() const;
+    void clear();
+
+    /* Criteria */
+    bool addSubcases(const std::string &list);
+    void addHeader(const std::string &key, const std::string &value);
+    void addResultType(const std::string &title);
+    void setIds(const IdSet &ids);
+
+    bool accepts(const PunchBlock &block, const std::string &resultTitle) const;
+
+    /* Rows */
+    bool hasIds() const { return static_cast<bool>(m_ids); }
+    bool acceptsId(const char *begin, const char *end) const;
+    BlockFilter rowFilter() const;
+
+private:
+    std::vector<std::pair<int, int> > m_subcases;
+    std::map<std::string, std::set<std::string> > m_headers;
+    std::set<std::string> m_resultTypes;
+    std::shared_ptr<const IdSet> m_ids;
+};
+
+#endif // BLOCK_FILTER_H
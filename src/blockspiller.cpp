@@ -0,0 +1,224 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "blockspiller.h"
+
+#include <cstdio>   // std::rename(), std::remove()
+
+using namespace std;
+
+/*! \class BlockSpiller
+ *  \brief The class BlockSpiller groups the blocks by format on disk,
+ * instead of in memory.
+ *
+ * Each block is converted to CSV as soon as it's appended, and written to
+ * the run file of its format (the \a prefix, then ".run" and the id of the
+ * format, then ".tmp"). So the memory doesn't depend on the size of the
+ * input files.
+ *
+ * At the end, a run is the CSV of its format: \a writeRun() moves it to its
+ * output file. \a writeUnique() concatenates the runs in the order of the
+ * keys, like the unique csv of a \a PunchFile. The first header line of a
+ * run is skipped if the previous run ends with the same header, so the
+ * output is the same as the CSV written from a \a PunchFile.
+ *
+ * The run files left are removed by \a clear() and by the destructor.
+ *
+ * \example
+ *
+ * \code
+ * BlockSpiller spiller("output.csv", "", false);
+ * reader.parsePUNCH(&ifs, [&](PunchBlock &block) { spiller.append(block); });
+ * spiller.writeUnique("output.csv");
+ * \endcode
+ */
+/*! \brief Constructor. The run files begin with the given \a prefix.
+ * The other arguments are the ones of the \a Writer.
+ */
+BlockSpiller::BlockSpiller(const string &prefix,
+                           const string &columnHeaderLine, const bool skipColumnHeaders,
+                           const bool namedColumns)
+    : m_prefix(prefix)
+    , m_writer(columnHeaderLine, skipColumnHeaders, namedColumns)
+    , m_size(0)
+{
+}
+
+BlockSpiller::~BlockSpiller()
+{
+    clear();
+}
+
+/******************************************************************************
+ ******************************************************************************/
+bool BlockSpiller::isEmpty() const
+{
+    return m_runs.empty();
+}
+
+/*! \brief Returns the number of bytes written to the run files.
+ */
+std::size_t BlockSpiller::size() const
+{
+    return m_size;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Writes the given \a block to the run of its format.
+ * Returns \a false if the run can't be written.
+ */
+bool BlockSpiller::append(const PunchBlock &block)
+{
+    const int id = m_keys.addKey(block);
+    if (id >= static_cast<int>(m_runs.size())) {
+        std::unique_ptr<Run> run(new Run());
+        run->filename = runFilename(id);
+        run->stream.open( run->filename.c_str() );
+        run->writer = m_writer;
+        run->headerSize = 0;
+        m_runs.push_back( std::move(run) );
+        if (!m_runs.back()->stream.is_open()) {
+            return false;
+        }
+        /* The header line of the first block can be skipped by writeUnique() */
+        Run &first = *m_runs.back();
+        if (!write(first, block)) {
+            return false;
+        }
+        first.firstHeaders = first.writer.previousLeftHeaders();
+        first.headerSize = first.writer.headerSize();
+        return true;
+    }
+    return write(*m_runs[id], block);
+}
+
+/*! \brief Writes the blocks of the given \a pch, format by format.
+ */
+bool BlockSpiller::append(const PunchFile &pch)
+{
+    bool ok = true;
+    for (int keyId = 0; keyId < pch.keyCount(); ++keyId) {
+        auto range = pch.blockRange(keyId);
+        for (auto it = range.first; it != range.second; ++it) {
+            ok &= append(*it);
+        }
+    }
+    return ok;
+}
+
+bool BlockSpiller::write(Run &run, const PunchBlock &block)
+{
+    const std::streampos begin = run.stream.tellp();
+    if (!run.writer.writeCSV(block, &run.stream)) {
+        return false;
+    }
+    m_size += static_cast<std::size_t>(run.stream.tellp() - begin);
+    return run.stream.good();
+}
+
+bool BlockSpiller::close(Run &run)
+{
+    if (!run.stream.is_open()) {
+        return true;
+    }
+    run.stream.close();
+    return !run.stream.fail();
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns the ids of the formats, in the order of the keys.
+ */
+std::vector<int> BlockSpiller::keyIds() const
+{
+    return m_keys.keyIds();
+}
+
+std::string BlockSpiller::runFilename(const int keyId) const
+{
+    return m_prefix + ".run" + to_string(keyId) + ".tmp";
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Moves the run of the format \a keyId to the given \a filename.
+ */
+bool BlockSpiller::writeRun(const int keyId, const string &filename)
+{
+    Run &run = *m_runs.at(keyId);
+    if (!close(run)) {
+        return false;
+    }
+    if (std::rename(run.filename.c_str(), filename.c_str()) == 0) {
+        return true;
+    }
+    /* Not the same file system */
+    ifstream ifs(run.filename.c_str(), ios::binary);
+    ofstream ofs(filename.c_str(), ios::binary);
+    if (!ifs.is_open() || !ofs.is_open()) {
+        return false;
+    }
+    if (ifs.peek() != ifstream::traits_type::eof()) {
+        ofs << ifs.rdbuf();
+    }
+    ifs.close();
+    std::remove(run.filename.c_str());
+    return ofs.good();
+}
+
+/*! \brief Concatenates the runs, in the order of the keys, to the given
+ * \a filename.
+ */
+bool BlockSpiller::writeUnique(const string &filename)
+{
+    ofstream ofs(filename.c_str(), ios::binary);
+    if (!ofs.is_open()) {
+        return false;
+    }
+    string previousHeaders;
+    for (const int keyId : keyIds()) {
+        Run &run = *m_runs[keyId];
+        if (!close(run)) {
+            return false;
+        }
+        ifstream ifs(run.filename.c_str(), ios::binary);
+        if (!ifs.is_open()) {
+            return false;
+        }
+        /* Like the Writer, the header isn't repeated */
+        if (run.headerSize > 0 && run.firstHeaders == previousHeaders) {
+            ifs.seekg(run.headerSize);
+        }
+        if (ifs.peek() != ifstream::traits_type::eof()) {
+            ofs << ifs.rdbuf();
+        }
+        previousHeaders = run.writer.previousLeftHeaders();
+    }
+    return ofs.good();
+}
+
+/*! \brief Removes the run files.
+ */
+void BlockSpiller::clear()
+{
+    for (std::size_t i = 0; i < m_runs.size(); ++i) {
+        close(*m_runs[i]);
+        std::remove(m_runs[i]->filename.c_str());
+    }
+    m_runs.clear();
+    m_keys = PunchFile();
+    m_size = 0;
+}
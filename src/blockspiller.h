@@ -0,0 +1,72 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BLOCK_SPILLER_H
+#define BLOCK_SPILLER_H
+
+#include "punchfile.h"
+#include "writer.h"
+
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+class BlockSpiller
+{
+public:
+    explicit BlockSpiller(const std::string &prefix,
+                          const std::string &columnHeaderLine, const bool skipColumnHeaders,
+                          const bool namedColumns = false);
+    ~BlockSpiller();
+
+    bool isEmpty() const;
+    std::size_t size() const;
+
+    /* Runs */
+    bool append(const PunchBlock &block);
+    bool append(const PunchFile &pch);
+
+    std::vector<int> keyIds() const;
+    std::string runFilename(const int keyId) const;
+
+    /* Output */
+    bool writeRun(const int keyId, const std::string &filename);
+    bool writeUnique(const std::string &filename);
+    void clear();
+
+private:
+    /* The CSV of the blocks of a format, in the order of the file */
+    struct Run
+    {
+        std::string filename;
+        std::ofstream stream;
+        Writer writer;
+        std::string firstHeaders;   /* Header of the first block */
+        std::size_t headerSize;     /* Size of the header line of the first block */
+    };
+
+    bool write(Run &run, const PunchBlock &block);
+    bool close(Run &run);
+
+    std::string m_prefix;
+    Writer m_writer;
+    PunchFile m_keys;
+    std::vector<std::unique_ptr<Run> > m_runs;
+    std::size_t m_size;
+};
+
+#endif // BLOCK_SPILLER_H
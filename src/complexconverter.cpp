@@ -0,0 +1,262 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "complexconverter.h"
+
+#include "numberparser.h"
+#include "punchfile.h"
+#include "punchschema.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+#include <vector>
+
+static const double s_pi = 3.14159265358979323846;
+
+/*! \class ComplexConverter
+ *  \brief The class ComplexConverter decodes the complex results into pairs.
+ *
+ * In the Punch file, the complex results (REAL-IMAGINARY or MAGNITUDE-PHASE
+ * output, for instance of a frequency response) are written with all the
+ * real parts (or magnitudes) of a row first, then all the imaginary parts
+ * (or phases), spread across the -CONT- lines.
+ *
+ * \a convert() reorders the columns of a block of a known complex result type
+ * (see \a PunchSchema), so the two parts of each value are adjacent:
+ * (ID, T1 REAL, T1 IMAG, T2 REAL, T2 IMAG...). Optionally, the values are
+ * converted between the rectangular (real-imaginary) and the polar
+ * (magnitude-phase) forms. As in Nastran, the phases are in degrees,
+ * between 0 and 360.
+ *
+ * The conversion is done by batch: the parts of all the rows of the block are
+ * gathered into contiguous arrays, converted in a single pass by
+ * \a toPolar() or \a toRectangular(), then written back.
+ *
+ * The fields that aren't numbers are kept unchanged.
+ */
+
+/******************************************************************************
+ ******************************************************************************/
+static inline bool toDouble(const PunchValue &value, double *result)
+{
+    switch (value.type) {
+    case PunchValue::Real:
+        *result = value.real;
+        return true;
+    case PunchValue::Integer:
+        *result = static_cast<double>(value.integer);
+        return true;
+    case PunchValue::Empty:
+    case PunchValue::Text:
+    default:
+        return false;
+    }
+}
+
+/* Appends a copy of the cell (row, column) of the block */
+static void appendCell(const PunchBlock &block, const int row, const int column,
+                       std::vector<PunchValue> *values, std::vector<char> *chars)
+{
+    PunchValue value = block.value(row, column);
+    if (value.type == PunchValue::Text) {
+        char buffer[C_NUMBER_BUFFER_SIZE];
+        PunchField field = block.field(row, column, buffer);
+        value.text = chars->size();
+        chars->insert( chars->end(), field.data, field.data + field.size );
+    }
+    values->push_back( value );
+}
+
+static void appendReal(const double real, const int precision,
+                       std::vector<PunchValue> *values)
+{
+    PunchValue value;
+    value.type = PunchValue::Real;
+    value.precision = static_cast<unsigned char>(precision);
+    value.size = 0;
+    value.real = real;
+    values->push_back( value );
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns the schema of the blocks of the given \a schema,
+ * once converted with the given \a mode.
+ * Returns 0 if such blocks aren't converted.
+ */
+const PunchSchema* ComplexConverter::targetSchema(const PunchSchema *schema, const Mode mode)
+{
+    if (mode == Mode::None || !schema
+            || schema->format == PunchSchema::Real || schema->interleaved) {
+        return 0;
+    }
+
+    PunchSchema::Format format = schema->format;
+    if (mode == Mode::Rectangular) {
+        format = PunchSchema::RealImaginary;
+    } else if (mode == Mode::Polar) {
+        format = PunchSchema::MagnitudePhase;
+    }
+    return PunchSchema::find(schema->result, format, schema->elementType, true);
+}
+
+/*! \brief Converts the complex values of the given \a block, with the given \a mode.
+ * Returns \a true if the block is converted, otherwise \a false
+ * (unknown or real result type, or already interleaved).
+ *
+ * The rows must be typed, i.e. the parts must be decoded into numbers.
+ */
+bool ComplexConverter::convert(PunchBlock *block, const Mode mode)
+{
+    assert(block);
+    const PunchSchema *schema = block->schema();
+    const PunchSchema *target = targetSchema(schema, mode);
+    if (!target) {
+        return false;
+    }
+    const PunchSchema::Format format = target->format;
+
+    /* Number of complex values per row, after the identifier */
+    const int count = (schema->columnCount - 1) / 2;
+    const int rowCount = block->rowCount();
+    const std::size_t size = static_cast<std::size_t>(rowCount) * count;
+
+    /* Gather the parts */
+    std::vector<double> first(size);
+    std::vector<double> second(size);
+    std::vector<unsigned char> precisions(size);
+    std::vector<bool> numeric(size);
+    for (int row = 0; row < rowCount; ++row) {
+        for (int k = 0; k < count; ++k) {
+            const std::size_t i = static_cast<std::size_t>(row) * count + k;
+            const PunchValue a = block->value(row, 1 + k);
+            const PunchValue b = block->value(row, 1 + count + k);
+            numeric[i] = toDouble(a, &first[i]) && toDouble(b, &second[i]);
+            precisions[i] = std::max(a.type == PunchValue::Real ? a.precision : 0,
+                                     b.type == PunchValue::Real ? b.precision : 0);
+        }
+    }
+
+    /* Convert in a single pass */
+    const bool converted = (format != schema->format);
+    if (converted) {
+        std::vector<double> outFirst(size);
+        std::vector<double> outSecond(size);
+        if (format == PunchSchema::MagnitudePhase) {
+            toPolar(first.data(), second.data(), outFirst.data(), outSecond.data(), size);
+        } else {
+            toRectangular(first.data(), second.data(), outFirst.data(), outSecond.data(), size);
+        }
+        first.swap(outFirst);
+        second.swap(outSecond);
+    }
+
+    /* Write back the interleaved rows (the source rows are moved out, not copied) */
+    PunchBlock source(block->arena());
+    block->swapRows(source);
+    block->setSchema(target);
+
+    std::vector<PunchValue> values;
+    std::vector<char> chars;
+    for (int row = 0; row < rowCount; ++row) {
+        values.clear();
+        chars.clear();
+        appendCell(source, row, 0, &values, &chars);
+        for (int k = 0; k < count; ++k) {
+            const std::size_t i = static_cast<std::size_t>(row) * count + k;
+            if (converted && numeric[i]) {
+                const int precision = precisions[i] > 0 ? precisions[i] : 6;
+                appendReal(first[i], precision, &values);
+                appendReal(second[i], precision, &values);
+            } else {
+                appendCell(source, row, 1 + k, &values, &chars);
+                appendCell(source, row, 1 + count + k, &values, &chars);
+            }
+        }
+        /* Extra fields, if any */
+        for (int column = 1 + 2 * count; column < source.fieldCount(row); ++column) {
+            appendCell(source, row, column, &values, &chars);
+        }
+        while (!values.empty() && values.back().type == PunchValue::Empty) {
+            values.pop_back();
+        }
+        block->append( values.data(), values.size(), chars.data() );
+    }
+    return true;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns the complex value at the given \a index (from 0) of the
+ * given \a row of a complex \a block, in rectangular form.
+ * The block can be interleaved or not, real-imaginary or magnitude-phase.
+ * Returns 0 if the block isn't complex or the parts aren't numbers.
+ */
+std::complex<double> ComplexConverter::value(const PunchBlock &block, const int row, const int index)
+{
+    const PunchSchema *schema = block.schema();
+    if (!schema || schema->format == PunchSchema::Real) {
+        return std::complex<double>();
+    }
+    const int count = (schema->columnCount - 1) / 2;
+    if (index < 0 || index >= count) {
+        return std::complex<double>();
+    }
+    const int firstColumn = schema->interleaved ? 1 + 2 * index : 1 + index;
+    const int secondColumn = schema->interleaved ? 2 + 2 * index : 1 + count + index;
+
+    double a = 0;
+    double b = 0;
+    if (!toDouble(block.value(row, firstColumn), &a)
+            || !toDouble(block.value(row, secondColumn), &b)) {
+        return std::complex<double>();
+    }
+    if (schema->format == PunchSchema::MagnitudePhase) {
+        return std::polar(a, b * s_pi / 180.0);
+    }
+    return std::complex<double>(a, b);
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Converts \a count values from the rectangular form to the polar form.
+ * The phases are in degrees, between 0 and 360.
+ */
+void ComplexConverter::toPolar(const double *real, const double *imaginary,
+                               double *magnitude, double *phase, const std::size_t count)
+{
+    /* Separate loops, so the compiler can vectorize the magnitudes */
+    for (std::size_t i = 0; i < count; ++i) {
+        magnitude[i] = std::sqrt(real[i] * real[i] + imaginary[i] * imaginary[i]);
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        const double degrees = std::atan2(imaginary[i], real[i]) * (180.0 / s_pi);
+        phase[i] = degrees < 0 ? degrees + 360.0 : degrees;
+    }
+}
+
+/*! \brief Converts \a count values from the polar form to the rectangular form.
+ * The phases are in degrees.
+ */
+void ComplexConverter::toRectangular(const double *magnitude, const double *phase,
+                                     double *real, double *imaginary, const std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        const double radians = phase[i] * (s_pi / 180.0);
+        real[i] = magnitude[i] * std::cos(radians);
+        imaginary[i] = magnitude[i] * std::sin(radians);
+    }
+}
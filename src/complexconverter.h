@@ -0,0 +1,47 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef COMPLEX_CONVERTER_H
+#define COMPLEX_CONVERTER_H
+
+#include <complex>
+#include <cstddef>
+
+class PunchBlock;
+struct PunchSchema;
+
+class ComplexConverter
+{
+public:
+    enum class Mode {
+        None,           /* The blocks are kept as read */
+        Pairs,          /* The parts of each value are interleaved */
+        Rectangular,    /* Interleaved, and converted to real-imaginary */
+        Polar           /* Interleaved, and converted to magnitude-phase */
+    };
+
+    static bool convert(PunchBlock *block, const Mode mode);
+    static const PunchSchema* targetSchema(const PunchSchema *schema, const Mode mode);
+
+    static std::complex<double> value(const PunchBlock &block, const int row, const int index);
+
+    /* Batch conversions, on contiguous arrays of \a count values */
+    static void toPolar(const double *real, const double *imaginary,
+                        double *magnitude, double *phase, const std::size_t count);
+    static void toRectangular(const double *magnitude, const double *phase,
+                              double *real, double *imaginary, const std::size_t count);
+};
+
+#endif // COMPLEX_CONVERTER_H
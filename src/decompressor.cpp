@@ -0,0 +1,354 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "decompressor.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cstring>  // memcpy()
+
+#if defined(PCH2CSV_HAS_ZLIB)
+#  include <zlib.h>
+#endif
+#if defined(PCH2CSV_HAS_ZSTD)
+#  include <zstd.h>
+#endif
+
+using namespace std;
+
+/*! \class Decompressor
+ *  \brief The class Decompressor decompresses a stream while it's read.
+ *
+ * The Decompressor is a stream buffer: it reads the compressed bytes
+ * from the \a source stream by chunks, and gives the decompressed bytes
+ * to the stream that reads it. No temporary file is written.
+ *
+ * The format is detected from the magic bytes at the start of the source:
+ * gzip (1F 8B) or zstd (28 B5 2F FD). Other bytes are passed through,
+ * so any stream can be read through a Decompressor. Concatenated gzip
+ * members and zstd frames are read in turn.
+ *
+ * The gzip format requires zlib (PCH2CSV_HAS_ZLIB), and the zstd format
+ * requires libzstd (PCH2CSV_HAS_ZSTD). See \a isSupported().
+ *
+ * When read by the \a Reader (through an \a InputPipeline), the data
+ * is decompressed on the I/O thread, while the parser works on the
+ * previous buffer.
+ *
+ * \example
+ *
+ * \code
+ * std::ifstream ifs("model.pch.gz", std::ios::in | std::ios::binary);
+ * Decompressor decompressor(&ifs);
+ * std::istream stream(&decompressor);
+ * PunchFile pch = reader.parsePUNCH(&stream);
+ * if (decompressor.hasError()) {
+ *     // corrupted or truncated file
+ * }
+ * \endcode
+ */
+/*! \brief Constructor. Reads the first bytes of the \a source,
+ * to detect its format.
+ */
+Decompressor::Decompressor(std::istream * const source)
+    : m_source(source)
+    , m_format(None)
+    , m_error(false)
+    , m_sourceEnd(false)
+    , m_input(C_DECOMPRESSOR_BUFFER_SIZE)
+    , m_inputPos(0)
+    , m_inputSize(0)
+    , m_stream(0)
+    , m_frameOpen(false)
+{
+    assert(source);
+
+    fill();
+    m_format = detect(m_input.data(), m_inputSize);
+
+    if (!isSupported(m_format)) {
+        m_error = true;
+        return;
+    }
+
+#if defined(PCH2CSV_HAS_ZLIB)
+    if (m_format == Gzip) {
+        z_stream *stream = new z_stream;
+        std::memset(stream, 0, sizeof(z_stream));
+        /* 16: gzip wrapper only */
+        if (inflateInit2(stream, 15 + 16) != Z_OK) {
+            delete stream;
+            m_error = true;
+            return;
+        }
+        m_stream = stream;
+    }
+#endif
+#if defined(PCH2CSV_HAS_ZSTD)
+    if (m_format == Zstd) {
+        ZSTD_DStream *stream = ZSTD_createDStream();
+        if (!stream || ZSTD_isError(ZSTD_initDStream(stream))) {
+            ZSTD_freeDStream(stream);
+            m_error = true;
+            return;
+        }
+        m_stream = stream;
+    }
+#endif
+}
+
+/*! \brief Destructor.
+ */
+Decompressor::~Decompressor()
+{
+#if defined(PCH2CSV_HAS_ZLIB)
+    if (m_format == Gzip && m_stream) {
+        z_stream *stream = static_cast<z_stream*>(m_stream);
+        inflateEnd(stream);
+        delete stream;
+    }
+#endif
+#if defined(PCH2CSV_HAS_ZSTD)
+    if (m_format == Zstd && m_stream) {
+        ZSTD_freeDStream(static_cast<ZSTD_DStream*>(m_stream));
+    }
+#endif
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns the format of the given \a data, from its magic bytes.
+ */
+Decompressor::Format Decompressor::detect(const char *data, const std::size_t size)
+{
+    const unsigned char *bytes = reinterpret_cast<const unsigned char*>(data);
+    if (size >= 2 && bytes[0] == 0x1F && bytes[1] == 0x8B) {
+        return Gzip;
+    }
+    if (size >= 4 && bytes[0] == 0x28 && bytes[1] == 0xB5
+            && bytes[2] == 0x2F && bytes[3] == 0xFD) {
+        return Zstd;
+    }
+    return None;
+}
+
+/*! \brief Returns \a true if the given \a format can be decompressed,
+ * i.e. if the program is built with its library.
+ */
+bool Decompressor::isSupported(const Format format)
+{
+    switch (format) {
+    case None:
+        return true;
+    case Gzip:
+#if defined(PCH2CSV_HAS_ZLIB)
+        return true;
+#else
+        return false;
+#endif
+    case Zstd:
+#if defined(PCH2CSV_HAS_ZSTD)
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+Decompressor::Format Decompressor::format() const
+{
+    return m_format;
+}
+
+/*! \brief Returns \a true if the source can't be decompressed:
+ * unsupported format, corrupted or truncated data.
+ */
+bool Decompressor::hasError() const
+{
+    return m_error;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+Decompressor::int_type Decompressor::underflow()
+{
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+    if (m_output.empty()) {
+        m_output.resize(C_DECOMPRESSOR_BUFFER_SIZE);
+    }
+    const std::size_t size = decompress(m_output.data(), m_output.size());
+    if (size == 0) {
+        return traits_type::eof();
+    }
+    setg(m_output.data(), m_output.data(), m_output.data() + size);
+    return traits_type::to_int_type(*gptr());
+}
+
+/*! \internal
+ * Reads \a count bytes. The bytes are decompressed directly into \a s,
+ * without intermediate copy.
+ */
+std::streamsize Decompressor::xsgetn(char *s, std::streamsize count)
+{
+    std::streamsize done = 0;
+
+    /* Bytes already decompressed by underflow() */
+    const std::streamsize available = egptr() - gptr();
+    if (available > 0) {
+        done = std::min(available, count);
+        std::memcpy(s, gptr(), static_cast<std::size_t>(done));
+        setg(eback(), gptr() + done, egptr());
+    }
+
+    while (done < count) {
+        const std::size_t size = decompress(s + done, static_cast<std::size_t>(count - done));
+        if (size == 0) {
+            break;
+        }
+        done += size;
+    }
+    return done;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \internal
+ * Reads the next chunk of the source.
+ * Returns \a false at the end of the source.
+ */
+bool Decompressor::fill()
+{
+    if (m_sourceEnd) {
+        return false;
+    }
+    m_source->read(m_input.data(), m_input.size());
+    m_inputPos = 0;
+    m_inputSize = static_cast<std::size_t>(m_source->gcount());
+    if (m_inputSize == 0) {
+        m_sourceEnd = true;
+        return false;
+    }
+    return true;
+}
+
+/*! \internal
+ * Decompresses at most \a size bytes into \a out.
+ * Returns the number of bytes, or 0 at the end of the data.
+ */
+std::size_t Decompressor::decompress(char *out, const std::size_t size)
+{
+    if (m_error || size == 0) {
+        return 0;
+    }
+    switch (m_format) {
+    case None: return passThrough(out, size);
+    case Gzip: return inflateGzip(out, size);
+    case Zstd: return inflateZstd(out, size);
+    }
+    return 0;
+}
+
+std::size_t Decompressor::passThrough(char *out, const std::size_t size)
+{
+    /* First, the bytes read to detect the format */
+    if (m_inputPos < m_inputSize) {
+        const std::size_t count = std::min(size, m_inputSize - m_inputPos);
+        std::memcpy(out, m_input.data() + m_inputPos, count);
+        m_inputPos += count;
+        return count;
+    }
+    if (m_sourceEnd) {
+        return 0;
+    }
+    m_source->read(out, size);
+    const std::size_t count = static_cast<std::size_t>(m_source->gcount());
+    if (count == 0) {
+        m_sourceEnd = true;
+    }
+    return count;
+}
+
+std::size_t Decompressor::inflateGzip(char *out, const std::size_t size)
+{
+#if defined(PCH2CSV_HAS_ZLIB)
+    z_stream *stream = static_cast<z_stream*>(m_stream);
+    const uInt capacity = static_cast<uInt>(std::min<std::size_t>(size, 1u << 30));
+    stream->next_out = reinterpret_cast<Bytef*>(out);
+    stream->avail_out = capacity;
+
+    while (stream->avail_out == capacity && !m_error) {
+        if (m_inputPos == m_inputSize && !fill()) {
+            /* Truncated member */
+            m_error = m_frameOpen;
+            break;
+        }
+        stream->next_in = reinterpret_cast<Bytef*>(m_input.data() + m_inputPos);
+        stream->avail_in = static_cast<uInt>(m_inputSize - m_inputPos);
+        const int ret = inflate(stream, Z_NO_FLUSH);
+        m_inputPos = m_inputSize - stream->avail_in;
+
+        if (ret == Z_STREAM_END) {
+            /* Another member may follow */
+            m_frameOpen = false;
+            inflateReset(stream);
+        } else if (ret == Z_OK || ret == Z_BUF_ERROR) {
+            m_frameOpen = true;
+        } else {
+            m_error = true;
+        }
+    }
+    return capacity - stream->avail_out;
+#else
+    (void)out;
+    (void)size;
+    return 0;
+#endif
+}
+
+std::size_t Decompressor::inflateZstd(char *out, const std::size_t size)
+{
+#if defined(PCH2CSV_HAS_ZSTD)
+    ZSTD_DStream *stream = static_cast<ZSTD_DStream*>(m_stream);
+    ZSTD_outBuffer output = { out, size, 0 };
+
+    while (output.pos == 0 && !m_error) {
+        if (m_inputPos == m_inputSize && !fill()) {
+            /* Truncated frame */
+            m_error = m_frameOpen;
+            break;
+        }
+        ZSTD_inBuffer input = { m_input.data() + m_inputPos, m_inputSize - m_inputPos, 0 };
+        const std::size_t ret = ZSTD_decompressStream(stream, &output, &input);
+        m_inputPos += input.pos;
+
+        if (ZSTD_isError(ret)) {
+            m_error = true;
+        } else {
+            /* 0 when a frame is complete */
+            m_frameOpen = (ret != 0);
+        }
+    }
+    return output.pos;
+#else
+    (void)out;
+    (void)size;
+    return 0;
+#endif
+}
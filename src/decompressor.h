@@ -0,0 +1,80 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DECOMPRESSOR_H
+#define DECOMPRESSOR_H
+
+#include <cstddef>
+#include <istream>
+#include <streambuf>
+#include <vector>
+
+/*!
+ * C_DECOMPRESSOR_BUFFER_SIZE
+ *
+ * Size (in bytes) of the chunks of compressed data read from the source.
+ */
+#define C_DECOMPRESSOR_BUFFER_SIZE (256 * 1024)
+
+class Decompressor : public std::streambuf
+{
+public:
+    enum Format {
+        None,       /* Not compressed: the bytes are passed through */
+        Gzip,
+        Zstd
+    };
+
+    explicit Decompressor(std::istream * const source);
+    ~Decompressor();
+
+    static Format detect(const char *data, const std::size_t size);
+    static bool isSupported(const Format format);
+
+    Format format() const;
+    bool hasError() const;
+
+protected:
+    int_type underflow() override;
+    std::streamsize xsgetn(char *s, std::streamsize count) override;
+
+private:
+    Decompressor(const Decompressor &);             /* Not copyable */
+    Decompressor& operator=(const Decompressor &);
+
+    bool fill();
+    std::size_t decompress(char *out, const std::size_t size);
+    std::size_t passThrough(char *out, const std::size_t size);
+    std::size_t inflateGzip(char *out, const std::size_t size);
+    std::size_t inflateZstd(char *out, const std::size_t size);
+
+    std::istream *m_source;
+    Format m_format;
+    bool m_error;
+    bool m_sourceEnd;
+
+    /* Compressed bytes */
+    std::vector<char> m_input;
+    std::size_t m_inputPos;
+    std::size_t m_inputSize;
+
+    /* Decompressed bytes, for underflow() */
+    std::vector<char> m_output;
+
+    void *m_stream;     /* z_stream or ZSTD_DStream */
+    bool m_frameOpen;   /* The current gzip member or zstd frame isn't complete */
+};
+
+#endif // DECOMPRESSOR_H
@@ -0,0 +1,228 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "diagnostics.h"
+
+#include <assert.h>
+#include <cstdio>   // snprintf()
+
+using namespace std;
+
+/*! \class Diagnostics
+ *  \brief The class Diagnostics collects the anomalies found while parsing.
+ *
+ * A diagnostic is a compact record: its category, and the line number
+ * and the byte offset of the line in the input. The messages are only
+ * formatted when they're printed (see \a format()), so a file with
+ * millions of bad lines doesn't slow the parser.
+ *
+ * The counters of each category are exact. The records are limited to
+ * C_DIAGNOSTIC_RECORDS_SIZE, in order to bound the memory.
+ *
+ * \a writeJson() dumps the counters and the records in JSON,
+ * for the tools that check the files.
+ */
+/*! \brief Constructor.
+ */
+Diagnostics::Diagnostics()
+{
+    clear();
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns the identifier of the \a category, used in JSON.
+ */
+const char* Diagnostics::name(const Diagnostic::Category category)
+{
+    switch (category) {
+    case Diagnostic::LineLength:          return "line-length";
+    case Diagnostic::MissingHeader:       return "missing-header";
+    case Diagnostic::OrphanContinuation:  return "orphan-continuation";
+    case Diagnostic::CategoryCount:       break;
+    }
+    return "unknown";
+}
+
+/*! \brief Returns the message of the \a category.
+ */
+const char* Diagnostics::message(const Diagnostic::Category category)
+{
+    switch (category) {
+    case Diagnostic::LineLength:
+        return "The line must be 80 characters long.";
+    case Diagnostic::MissingHeader:
+        return "A header ('$' section) should prepend the data.";
+    case Diagnostic::OrphanContinuation:
+        return "A continued -CONT- field shouldn't starts a new block.";
+    case Diagnostic::CategoryCount:
+        break;
+    }
+    return "Unknown error.";
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void Diagnostics::clear()
+{
+    for (int i = 0; i < Diagnostic::CategoryCount; ++i) {
+        m_counts[i] = 0;
+    }
+    m_records.clear();
+}
+
+/*! \brief Reports a diagnostic of the given \a category, at the given
+ * \a line number and byte \a offset.
+ */
+void Diagnostics::report(const Diagnostic::Category category, const int line,
+                         const std::size_t offset)
+{
+    assert(category >= 0 && category < Diagnostic::CategoryCount);
+    ++m_counts[category];
+    if (m_records.size() < C_DIAGNOSTIC_RECORDS_SIZE) {
+        Diagnostic diagnostic;
+        diagnostic.category = category;
+        diagnostic.line = line;
+        diagnostic.offset = offset;
+        m_records.push_back(diagnostic);
+    }
+}
+
+/*! \brief Appends the diagnostics of \a other, found after these ones
+ * (e.g. in the next chunk). Their line numbers are shifted by \a lineOffset.
+ */
+void Diagnostics::merge(const Diagnostics &other, const int lineOffset)
+{
+    for (int i = 0; i < Diagnostic::CategoryCount; ++i) {
+        m_counts[i] += other.m_counts[i];
+    }
+    for (const Diagnostic &diagnostic : other.m_records) {
+        if (m_records.size() >= C_DIAGNOSTIC_RECORDS_SIZE) {
+            break;
+        }
+        m_records.push_back(diagnostic);
+        m_records.back().line += lineOffset;
+    }
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns the total number of diagnostics.
+ */
+long long Diagnostics::count() const
+{
+    long long total = 0;
+    for (int i = 0; i < Diagnostic::CategoryCount; ++i) {
+        total += m_counts[i];
+    }
+    return total;
+}
+
+/*! \brief Returns the number of diagnostics of the given \a category.
+ */
+long long Diagnostics::count(const Diagnostic::Category category) const
+{
+    assert(category >= 0 && category < Diagnostic::CategoryCount);
+    return m_counts[category];
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns the number of recorded diagnostics.
+ * It's less than \a count() if the records reached C_DIAGNOSTIC_RECORDS_SIZE.
+ */
+int Diagnostics::recordCount() const
+{
+    return m_records.size();
+}
+
+const Diagnostic& Diagnostics::at(const int index) const
+{
+    return m_records.at(index);
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns the message of the \a diagnostic, with its line number.
+ */
+std::string Diagnostics::format(const Diagnostic &diagnostic)
+{
+    return "[Warning] line " + std::to_string(diagnostic.line) + ": "
+            + message(diagnostic.category);
+}
+
+static void writeJsonString(std::ostream &stream, const std::string &text)
+{
+    stream << '"';
+    for (const char c : text) {
+        switch (c) {
+        case '"':  stream << "\\\""; break;
+        case '\\': stream << "\\\\"; break;
+        case '\n': stream << "\\n"; break;
+        case '\r': stream << "\\r"; break;
+        case '\t': stream << "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                stream << escaped;
+            } else {
+                stream << c;
+            }
+            break;
+        }
+    }
+    stream << '"';
+}
+
+/*! \brief Writes the counters and the records in JSON, as an object:
+ *
+ * \code
+ * {
+ *   "file": "model.pch",
+ *   "count": 2,
+ *   "categories": {"line-length": 2, "missing-header": 0, "orphan-continuation": 0},
+ *   "recorded": 2,
+ *   "diagnostics": [
+ *     {"category": "line-length", "line": 12, "offset": 880, "message": "..."},
+ *     {"category": "line-length", "line": 15, "offset": 1121, "message": "..."}
+ *   ]
+ * }
+ * \endcode
+ */
+void Diagnostics::writeJson(std::ostream &stream, const std::string &filename) const
+{
+    stream << "{\n  \"file\": ";
+    writeJsonString(stream, filename);
+    stream << ",\n  \"count\": " << count();
+    stream << ",\n  \"categories\": {";
+    for (int i = 0; i < Diagnostic::CategoryCount; ++i) {
+        const Diagnostic::Category category = static_cast<Diagnostic::Category>(i);
+        stream << (i > 0 ? ", " : "") << '"' << name(category) << "\": " << m_counts[i];
+    }
+    stream << "},\n  \"recorded\": " << m_records.size();
+    stream << ",\n  \"diagnostics\": [";
+    for (std::size_t i = 0; i < m_records.size(); ++i) {
+        const Diagnostic &diagnostic = m_records[i];
+        stream << (i > 0 ? ",\n" : "\n")
+               << "    {\"category\": \"" << name(diagnostic.category) << '"'
+               << ", \"line\": " << diagnostic.line
+               << ", \"offset\": " << diagnostic.offset
+               << ", \"message\": ";
+        writeJsonString(stream, message(diagnostic.category));
+        stream << '}';
+    }
+    stream << (m_records.empty() ? "]\n}" : "\n  ]\n}");
+}
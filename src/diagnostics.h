@@ -0,0 +1,75 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*!
+ * C_DIAGNOSTIC_RECORDS_SIZE
+ *
+ * Maximum number of diagnostics recorded with their position.
+ * The counters aren't limited.
+ */
+#define C_DIAGNOSTIC_RECORDS_SIZE 100000
+
+struct Diagnostic
+{
+    enum Category {
+        LineLength = 0,         /* The line isn't 80 characters long */
+        MissingHeader,          /* Data without '$' header section */
+        OrphanContinuation,     /* -CONT- line without row to continue */
+        CategoryCount
+    };
+
+    Category category;
+    int line;
+    std::size_t offset;
+};
+
+class Diagnostics
+{
+public:
+    explicit Diagnostics();
+
+    static const char* name(const Diagnostic::Category category);
+    static const char* message(const Diagnostic::Category category);
+
+    void clear();
+    void report(const Diagnostic::Category category, const int line, const std::size_t offset);
+    void merge(const Diagnostics &other, const int lineOffset);
+
+    /* Counters */
+    long long count() const;
+    long long count(const Diagnostic::Category category) const;
+
+    /* Records */
+    int recordCount() const;
+    const Diagnostic& at(const int index) const;
+
+    /* Output */
+    static std::string format(const Diagnostic &diagnostic);
+    void writeJson(std::ostream &stream, const std::string &filename) const;
+
+private:
+    long long m_counts[Diagnostic::CategoryCount];
+    std::vector<Diagnostic> m_records;
+};
+
+#endif // DIAGNOSTICS_H
@@ -0,0 +1,317 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "filefollower.h"
+
+#include "qsystemdetection.h"
+
+#include <cstdio>   // std::rename(), std::remove()
+#include <fstream>
+
+#if defined(Q_OS_LINUX)
+#  include <dirent.h>
+#  include <errno.h>
+#  include <fcntl.h>      // O_ACCMODE
+#  include <poll.h>
+#  include <sys/inotify.h>
+#  include <sys/stat.h>
+#  include <unistd.h>     // read(), close()
+#else
+#  include <chrono>
+#  include <thread>
+#endif
+
+using namespace std;
+
+/*! \class FileFollower
+ *  \brief The class FileFollower waits for the changes of a file
+ *  that is being written.
+ *
+ * On Linux, the file is watched with inotify: \a wait() returns as soon as
+ * bytes are written, or the file is closed by a writer, or removed.
+ * Since the file can be closed before it's watched, \a isWritten() tells
+ * if a process still has it open for writing.
+ * On the other systems, \a wait() only sleeps: the caller checks the size
+ * of the file after each timeout.
+ *
+ * The position of the conversion of a followed file is saved in a
+ * '.pchpos' file (see \a FollowState), so that a new run resumes where
+ * the previous one stopped.
+ *
+ * \example
+ *
+ * \code
+ * FileFollower follower;
+ * follower.open("model.pch");
+ * while (follower.wait(500) != FileFollower::Closed) {
+ *     // convert the complete blocks written since the last time
+ * }
+ * \endcode
+ */
+/*! \brief Constructor.
+ */
+FileFollower::FileFollower()
+    : m_fd(-1)
+    , m_watch(-1)
+{
+}
+
+/*! \brief Destructor.
+ */
+FileFollower::~FileFollower()
+{
+    close();
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Starts to watch the given \a filename.
+ * Returns \a true if successful, otherwise returns \a false.
+ */
+bool FileFollower::open(const string &filename)
+{
+    close();
+#if defined(Q_OS_LINUX)
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+        return false;
+    }
+    m_watch = inotify_add_watch(m_fd, filename.c_str(),
+                                IN_MODIFY | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF);
+    if (m_watch < 0) {
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+#else
+    ifstream ifs(filename.c_str());
+    if (!ifs.is_open()) {
+        return false;
+    }
+#endif
+    m_filename = filename;
+    return true;
+}
+
+void FileFollower::close()
+{
+#if defined(Q_OS_LINUX)
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+#endif
+    m_fd = -1;
+    m_watch = -1;
+    m_filename.clear();
+}
+
+bool FileFollower::isOpen() const
+{
+    return !m_filename.empty();
+}
+
+/*! \brief Returns true if a process has the file open for writing.
+ *
+ * On Linux, the descriptors of the processes are searched in /proc (the
+ * processes of the other users are usually not readable, so they're
+ * ignored). On the other systems, the writers are unknown: it returns
+ * true, and the file is considered closed after a \a Closed event only.
+ */
+bool FileFollower::isWritten() const
+{
+    if (!isOpen()) {
+        return false;
+    }
+#if defined(Q_OS_LINUX)
+    struct stat file;
+    if (::stat(m_filename.c_str(), &file) != 0) {
+        return false;
+    }
+    DIR *processes = ::opendir("/proc");
+    if (!processes) {
+        return true;
+    }
+    bool written = false;
+    struct dirent *process;
+    while (!written && (process = ::readdir(processes)) != 0) {
+        if (process->d_name[0] < '0' || process->d_name[0] > '9') {
+            continue;
+        }
+        const string dir = string("/proc/") + process->d_name;
+        DIR *descriptors = ::opendir((dir + "/fd").c_str());
+        if (!descriptors) {
+            continue;
+        }
+        struct dirent *descriptor;
+        while (!written && (descriptor = ::readdir(descriptors)) != 0) {
+            struct stat target;
+            if (descriptor->d_name[0] == '.'
+                    || ::stat((dir + "/fd/" + descriptor->d_name).c_str(), &target) != 0
+                    || target.st_dev != file.st_dev || target.st_ino != file.st_ino) {
+                continue;
+            }
+            /* The flags of the descriptor, in octal */
+            ifstream info((dir + "/fdinfo/" + descriptor->d_name).c_str());
+            string key;
+            while (info >> key) {
+                if (key == "flags:") {
+                    int flags = 0;
+                    info >> std::oct >> flags;
+                    written = (flags & O_ACCMODE) != O_RDONLY;
+                    break;
+                }
+            }
+        }
+        ::closedir(descriptors);
+    }
+    ::closedir(processes);
+    return written;
+#else
+    return true;
+#endif
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Waits for a change of the file, at most \a timeout milliseconds.
+ *
+ * If several events happened, the most significant one is returned
+ * (Removed, then Closed, then Modified).
+ * A signal interrupts the wait, and Timeout is returned.
+ */
+FileFollower::Event FileFollower::wait(const int timeout)
+{
+    if (!isOpen()) {
+        return Error;
+    }
+#if defined(Q_OS_LINUX)
+    struct pollfd descriptor;
+    descriptor.fd = m_fd;
+    descriptor.events = POLLIN;
+    descriptor.revents = 0;
+    const int ret = ::poll(&descriptor, 1, timeout);
+    if (ret == 0) {
+        return Timeout;
+    }
+    if (ret < 0) {
+        return errno == EINTR ? Timeout : Error;
+    }
+
+    Event event = Timeout;
+    alignas(struct inotify_event) char buffer[4096];
+    ssize_t size;
+    while ((size = ::read(m_fd, buffer, sizeof(buffer))) > 0) {
+        const char *p = buffer;
+        while (p < buffer + size) {
+            const struct inotify_event *e = reinterpret_cast<const struct inotify_event*>(p);
+            if (e->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                event = Removed;
+            } else if ((e->mask & IN_CLOSE_WRITE) && event != Removed) {
+                event = Closed;
+            } else if ((e->mask & IN_MODIFY) && event == Timeout) {
+                event = Modified;
+            }
+            p += sizeof(struct inotify_event) + e->len;
+        }
+    }
+    return event;
+#else
+    std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
+    ifstream ifs(m_filename.c_str());
+    return ifs.is_open() ? Timeout : Removed;
+#endif
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns the name of the state of the given punch \a filename,
+ * i.e. the \a filename with the '.pchpos' extension.
+ */
+string FileFollower::stateFilename(const string &filename)
+{
+    const string::size_type dot = filename.find_last_of('.');
+    const string::size_type separator = filename.find_last_of("/\\");
+    if (dot == string::npos || (separator != string::npos && dot < separator)) {
+        return filename + ".pchpos";
+    }
+    return filename.substr(0, dot) + ".pchpos";
+}
+
+/*! \brief Loads the \a state from the given \a filename.
+ * Returns \a false if the file doesn't exist or isn't a valid state.
+ */
+bool FileFollower::loadState(const string &filename, FollowState *state)
+{
+    ifstream ifs(filename.c_str());
+    if (!ifs.is_open()) {
+        return false;
+    }
+    string line;
+    if (!std::getline(ifs, line) || line != "PCHPOS " + to_string(C_FOLLOW_VERSION)) {
+        return false;
+    }
+    FollowState loaded;
+    if (!(ifs >> loaded.offset >> loaded.line) || loaded.line < 0) {
+        return false;
+    }
+    ifs.ignore(1); /* end of line */
+    if (!std::getline(ifs, loaded.output) || !std::getline(ifs, loaded.headers)) {
+        return false;
+    }
+    *state = loaded;
+    return true;
+}
+
+/*! \brief Saves the \a state to the given \a filename.
+ *
+ * The state is a text file:
+ * \code
+ * PCHPOS 1
+ * <offset> <line>
+ * <output>
+ * <header of the last block written>
+ * \endcode
+ *
+ * The state is written in a temporary file first, then renamed,
+ * so an interrupted save doesn't corrupt the previous state.
+ */
+bool FileFollower::saveState(const string &filename, const FollowState &state)
+{
+    const string temporary = filename + ".tmp";
+    {
+        ofstream ofs(temporary.c_str());
+        if (!ofs.is_open()) {
+            return false;
+        }
+        ofs << "PCHPOS " << C_FOLLOW_VERSION << '\n';
+        ofs << state.offset << ' ' << state.line << '\n';
+        ofs << state.output << '\n';
+        ofs << state.headers << '\n';
+        ofs.close();
+        if (ofs.fail()) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    if (std::rename(temporary.c_str(), filename.c_str()) != 0) {
+        /* Windows doesn't replace an existing file */
+        std::remove(filename.c_str());
+        if (std::rename(temporary.c_str(), filename.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,78 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef FILE_FOLLOWER_H
+#define FILE_FOLLOWER_H
+
+#include <cstddef>
+#include <string>
+
+/*!
+ * C_FOLLOW_VERSION
+ *
+ * Version of the format of the '.pchpos' files.
+ * A state of another version is ignored.
+ */
+#define C_FOLLOW_VERSION 1
+
+/*!
+ * FollowState
+ *
+ * Position of the conversion of a followed file, saved between two runs.
+ */
+struct FollowState
+{
+    std::size_t offset;     /* Offset (in bytes) of the first line not converted */
+    int line;               /* Number of the lines before the offset */
+    std::string output;     /* Name of the csv output */
+    std::string headers;    /* Header of the last block written in the output */
+};
+
+class FileFollower
+{
+public:
+    enum Event {
+        Timeout,    /* Nothing happened */
+        Modified,   /* Bytes were written */
+        Closed,     /* A writer closed the file */
+        Removed,    /* The file was removed or moved */
+        Error
+    };
+
+    explicit FileFollower();
+    ~FileFollower();
+
+    bool open(const std::string &filename);
+    void close();
+    bool isOpen() const;
+
+    bool isWritten() const;
+    Event wait(const int timeout);
+
+    /* Saved state */
+    static std::string stateFilename(const std::string &filename);
+    static bool loadState(const std::string &filename, FollowState *state);
+    static bool saveState(const std::string &filename, const FollowState &state);
+
+private:
+    FileFollower(const FileFollower &);             /* Not copyable */
+    FileFollower& operator=(const FileFollower &);
+
+    std::string m_filename;
+    int m_fd;
+    int m_watch;
+};
+
+#endif // FILE_FOLLOWER_H
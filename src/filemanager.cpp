@@ -15,8 +15,14 @@
  */
 #include "filemanager.h"
 
+#include "qsystemdetection.h"
+
 #include <algorithm>    // std::transform()
-#include <io.h>         // access()
+#if defined(Q_OS_WIN)
+#  include <io.h>       // access()
+#else
+#  include <unistd.h>   // access()
+#endif
 #include <string>
 
 using namespace std;
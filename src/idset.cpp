@@ -0,0 +1,290 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "idset.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+/* A container becomes a bitmap beyond 4096 ids (i.e. 8 KB, the size of
+ * the bitmap). */
+static const std::size_t C_ARRAY_MAX_SIZE = 4096;
+static const std::size_t C_BITMAP_SIZE = 65536 / 64;
+
+/*! \class IdSet
+ *  \brief The class IdSet is a compressed bitmap of entity ids (grids,
+ * elements...).
+ *
+ * The ids are grouped by their 16 high bits. Each group is stored as a
+ * sorted array of the 16 low bits while it's small, and as a bitmap of
+ * 65536 bits otherwise. A set of 50,000 scattered ids takes about 100 KB,
+ * and the lookup is a binary search of the group, then a bit test or a
+ * binary search in the group.
+ *
+ * The ids are loaded from a list, where they're separated by blanks,
+ * commas or new lines. A range is written "first-last", or
+ * "first THRU last" like in the Nastran sets. The comments begin with '#'.
+ *
+ * \example
+ *
+ * \code
+ * IdSet ids;
+ * ids.parse("1001, 1003\n2000-2999\n3000 THRU 3999 # Wing");
+ * ids.contains(2500); // true
+ * \endcode
+ */
+/*! \brief Constructor.
+ */
+IdSet::IdSet()
+{
+}
+
+/******************************************************************************
+ ******************************************************************************/
+bool IdSet::isEmpty() const
+{
+    return m_containers.empty();
+}
+
+void IdSet::clear()
+{
+    m_containers.clear();
+}
+
+/*! \brief Returns the number of ids.
+ */
+std::size_t IdSet::count() const
+{
+    std::size_t result = 0;
+    for (auto &container : m_containers) {
+        result += container.cardinality;
+    }
+    return result;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void IdSet::insert(const std::uint32_t id)
+{
+    insert(id, id);
+}
+
+/*! \brief Inserts the ids from \a first to \a last, included.
+ */
+void IdSet::insert(const std::uint32_t first, const std::uint32_t last)
+{
+    if (last < first) {
+        return;
+    }
+    const std::uint32_t firstKey = first >> 16;
+    const std::uint32_t lastKey = last >> 16;
+    for (std::uint32_t key = firstKey; ; ++key) {
+        const std::uint32_t low = (key == firstKey) ? (first & 0xFFFF) : 0;
+        const std::uint32_t high = (key == lastKey) ? (last & 0xFFFF) : 0xFFFF;
+
+        Container &c = container( static_cast<std::uint16_t>(key) );
+        if (c.bitmap.empty() && c.array.size() + (high - low + 1) > C_ARRAY_MAX_SIZE) {
+            toBitmap(&c);
+        }
+        if (!c.bitmap.empty()) {
+            for (std::uint32_t value = low; value <= high; ++value) {
+                const std::uint64_t mask = std::uint64_t(1) << (value & 63);
+                if (!(c.bitmap[value >> 6] & mask)) {
+                    c.bitmap[value >> 6] |= mask;
+                    ++c.cardinality;
+                }
+            }
+        } else {
+            for (std::uint32_t value = low; value <= high; ++value) {
+                const std::uint16_t v = static_cast<std::uint16_t>(value);
+                /* The ids are usually sorted: append */
+                if (c.array.empty() || c.array.back() < v) {
+                    c.array.push_back(v);
+                    ++c.cardinality;
+                } else {
+                    auto it = std::lower_bound(c.array.begin(), c.array.end(), v);
+                    if (*it != v) {
+                        c.array.insert(it, v);
+                        ++c.cardinality;
+                    }
+                }
+            }
+        }
+        if (key == lastKey) {
+            break;
+        }
+    }
+}
+
+/*! \brief Returns \a true if the set contains the given \a id.
+ */
+bool IdSet::contains(const std::uint32_t id) const
+{
+    const std::uint16_t key = static_cast<std::uint16_t>(id >> 16);
+    auto it = std::lower_bound(m_containers.begin(), m_containers.end(), key,
+                               [](const Container &c, const std::uint16_t k) { return c.key < k; });
+    if (it == m_containers.end() || it->key != key) {
+        return false;
+    }
+    const std::uint16_t value = static_cast<std::uint16_t>(id & 0xFFFF);
+    if (!it->bitmap.empty()) {
+        return (it->bitmap[value >> 6] >> (value & 63)) & 1;
+    }
+    return std::binary_search(it->array.begin(), it->array.end(), value);
+}
+
+/******************************************************************************
+ ******************************************************************************/
+IdSet::Container& IdSet::container(const std::uint16_t key)
+{
+    auto it = std::lower_bound(m_containers.begin(), m_containers.end(), key,
+                               [](const Container &c, const std::uint16_t k) { return c.key < k; });
+    if (it == m_containers.end() || it->key != key) {
+        Container container;
+        container.key = key;
+        container.cardinality = 0;
+        it = m_containers.insert(it, container);
+    }
+    return *it;
+}
+
+void IdSet::toBitmap(Container *container)
+{
+    container->bitmap.assign(C_BITMAP_SIZE, 0);
+    for (const std::uint16_t value : container->array) {
+        container->bitmap[value >> 6] |= std::uint64_t(1) << (value & 63);
+    }
+    container->array.clear();
+    container->array.shrink_to_fit();
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Parses the leading id of the field from \a begin to \a end,
+ * for instance "2001" in "2001       G".
+ * Returns \a false if the field doesn't begin with an unsigned integer.
+ */
+bool IdSet::parseId(const char *begin, const char *end, std::uint32_t *id)
+{
+    while (begin != end && (*begin == ' ' || *begin == '\t')) {
+        ++begin;
+    }
+    if (begin == end || *begin < '0' || *begin > '9') {
+        return false;
+    }
+    std::uint64_t result = 0;
+    while (begin != end && *begin >= '0' && *begin <= '9') {
+        result = result * 10 + static_cast<std::uint64_t>(*begin - '0');
+        if (result > 0xFFFFFFFFu) {
+            return false;
+        }
+        ++begin;
+    }
+    if (begin != end && *begin != ' ' && *begin != '\t') {
+        return false;
+    }
+    *id = static_cast<std::uint32_t>(result);
+    return true;
+}
+
+static bool parseToken(const string &token, std::uint32_t *id)
+{
+    const char *begin = token.data();
+    const char *end = token.data() + token.size();
+    return !token.empty() && token.find_first_of(" \t") == string::npos
+            && IdSet::parseId(begin, end, id);
+}
+
+/*! \brief Inserts the ids of the given list \a text.
+ * Returns \a false if the list is invalid, and the number
+ * of the invalid line in \a errorLine (if not null).
+ */
+bool IdSet::parse(const string &text, int *errorLine)
+{
+    istringstream iss(text);
+    string line;
+    int lineNumber = 0;
+    while (std::getline(iss, line)) {
+        ++lineNumber;
+        const string::size_type comment = line.find('#');
+        if (comment != string::npos) {
+            line.erase(comment);
+        }
+        std::replace(line.begin(), line.end(), ',', ' ');
+
+        istringstream tokens(line);
+        string token;
+        bool valid = true;
+        while (valid && tokens >> token) {
+            std::uint32_t first = 0;
+            std::uint32_t last = 0;
+            const string::size_type dash = token.find('-', 1);
+            if (dash != string::npos) {
+                valid = parseToken(token.substr(0, dash), &first)
+                        && parseToken(token.substr(dash + 1), &last);
+            } else {
+                valid = parseToken(token, &first);
+                last = first;
+                /* Nastran style: "first THRU last" */
+                const std::streampos position = tokens.tellg();
+                string thru;
+                if (valid && tokens >> thru) {
+                    std::transform(thru.begin(), thru.end(), thru.begin(), ::toupper);
+                    if (thru == "THRU") {
+                        string next;
+                        valid = (tokens >> next) && parseToken(next, &last);
+                    } else {
+                        tokens.clear();
+                        tokens.seekg(position);
+                    }
+                }
+            }
+            if (valid && last < first) {
+                valid = false;
+            }
+            if (valid) {
+                insert(first, last);
+            }
+        }
+        if (!valid) {
+            if (errorLine) {
+                *errorLine = lineNumber;
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+/*! \brief Inserts the ids of the list saved in the given file.
+ * Returns \a false if the file can't be read or if the list is invalid.
+ */
+bool IdSet::load(const string &filename, int *errorLine)
+{
+    ifstream ifs(filename.c_str());
+    if (!ifs.is_open()) {
+        if (errorLine) {
+            *errorLine = 0;
+        }
+        return false;
+    }
+    stringstream buffer;
+    buffer << ifs.rdbuf();
+    return parse(buffer.str(), errorLine);
+}
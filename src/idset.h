@@ -0,0 +1,59 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ID_SET_H
+#define ID_SET_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class IdSet
+{
+public:
+    explicit IdSet();
+
+    bool isEmpty() const;
+    void clear();
+    std::size_t count() const;
+
+    void insert(const std::uint32_t id);
+    void insert(const std::uint32_t first, const std::uint32_t last);
+    bool contains(const std::uint32_t id) const;
+
+    /* I/O */
+    bool parse(const std::string &text, int *errorLine = nullptr);
+    bool load(const std::string &filename, int *errorLine = nullptr);
+
+    static bool parseId(const char *begin, const char *end, std::uint32_t *id);
+
+private:
+    /* The ids that share the same 16 high bits. A container is a sorted
+     * array of the 16 low bits while it's small, and a bitmap otherwise. */
+    struct Container
+    {
+        std::uint16_t key;
+        std::uint32_t cardinality;
+        std::vector<std::uint16_t> array;
+        std::vector<std::uint64_t> bitmap;
+    };
+
+    Container& container(const std::uint16_t key);
+    static void toBitmap(Container *container);
+
+    std::vector<Container> m_containers;
+};
+
+#endif // ID_SET_H
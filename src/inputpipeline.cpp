@@ -0,0 +1,154 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "inputpipeline.h"
+
+#include <assert.h>
+#include <memory>   // std::align()
+
+using namespace std;
+
+/*! \class InputPipeline
+ *  \brief The class InputPipeline reads a stream on a dedicated I/O thread.
+ *
+ * The I/O thread fills a ring of large aligned buffers, while the caller
+ * consumes the previous ones with \a next(). Hence the reads overlap
+ * the parsing: the CPU doesn't wait for the disk, and the disk doesn't
+ * wait for the CPU. The buffers are reused, so the memory doesn't grow
+ * with the size of the stream.
+ *
+ * The buffers are cut at fixed sizes, regardless of the lines: a line
+ * can straddle two buffers.
+ *
+ * \example
+ *
+ * \code
+ * InputPipeline pipeline(&ifs);
+ * const char *data;
+ * std::size_t size;
+ * while (pipeline.next(&data, &size)) {
+ *     // [data, data + size) remains valid until the next call
+ * }
+ * \endcode
+ */
+/*! \brief Constructor. Starts to read the stream \a idevice into
+ * \a bufferCount buffers of \a bufferSize bytes.
+ */
+InputPipeline::InputPipeline(std::istream * const idevice,
+                             const std::size_t bufferSize, const int bufferCount)
+    : m_device(idevice)
+    , m_bufferSize(bufferSize > 0 ? bufferSize : 1)
+    , m_filledCount(0)
+    , m_readIndex(0)
+    , m_consumeIndex(0)
+    , m_holding(false)
+    , m_atEnd(false)
+    , m_stopped(false)
+{
+    assert(idevice);
+
+    /* One memory block for all the buffers, each aligned */
+    const std::size_t count = bufferCount > 1 ? bufferCount : 2;
+    const std::size_t stride = (m_bufferSize + C_READ_BUFFER_ALIGNMENT - 1)
+            / C_READ_BUFFER_ALIGNMENT * C_READ_BUFFER_ALIGNMENT;
+    m_memory.resize(count * stride + C_READ_BUFFER_ALIGNMENT);
+    void *p = m_memory.data();
+    std::size_t space = m_memory.size();
+    std::align(C_READ_BUFFER_ALIGNMENT, count * stride, p, space);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        Buffer buffer = { static_cast<char*>(p) + i * stride, 0 };
+        m_buffers.push_back(buffer);
+    }
+
+    m_thread = std::thread(&InputPipeline::run, this);
+}
+
+/*! \brief Destructor. Stops the I/O thread.
+ */
+InputPipeline::~InputPipeline()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+    }
+    m_condition.notify_all();
+    m_thread.join();
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Gets the next buffer of the stream.
+ * Returns \a false at the end of the stream.
+ *
+ * The buffer returned by the previous call is released, i.e.
+ * it can be filled again by the I/O thread.
+ */
+bool InputPipeline::next(const char **data, std::size_t *size)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_holding) {
+        m_holding = false;
+        m_consumeIndex = (m_consumeIndex + 1) % m_buffers.size();
+        --m_filledCount;
+        m_condition.notify_all();
+    }
+    m_condition.wait(lock, [this]() { return m_filledCount > 0 || m_atEnd; });
+    if (m_filledCount == 0) {
+        return false;
+    }
+    m_holding = true;
+    *data = m_buffers[m_consumeIndex].data;
+    *size = m_buffers[m_consumeIndex].size;
+    return true;
+}
+
+/*! \internal
+ * Fills the buffers, until the end of the stream.
+ */
+void InputPipeline::run()
+{
+    while (true) {
+        Buffer *buffer;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() {
+                return m_stopped || m_filledCount < m_buffers.size();
+            });
+            if (m_stopped) {
+                return;
+            }
+            buffer = &m_buffers[m_readIndex];
+        }
+
+        /* The stream is read without holding the lock */
+        m_device->read(buffer->data, m_bufferSize);
+        buffer->size = static_cast<std::size_t>(m_device->gcount());
+        const bool atEnd = !(*m_device);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (buffer->size > 0) {
+                m_readIndex = (m_readIndex + 1) % m_buffers.size();
+                ++m_filledCount;
+            }
+            m_atEnd = atEnd;
+        }
+        m_condition.notify_all();
+        if (atEnd) {
+            return;
+        }
+    }
+}
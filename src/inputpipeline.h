@@ -0,0 +1,85 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef INPUT_PIPELINE_H
+#define INPUT_PIPELINE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <istream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+ * C_READ_BUFFER_SIZE
+ *
+ * Size (in bytes) of the buffers filled by the I/O thread.
+ */
+#define C_READ_BUFFER_SIZE (4 * 1024 * 1024)
+
+/*!
+ * C_READ_BUFFER_COUNT
+ *
+ * Number of buffers of the ring: one is parsed while the others are filled.
+ */
+#define C_READ_BUFFER_COUNT 2
+
+/*!
+ * C_READ_BUFFER_ALIGNMENT
+ *
+ * Alignment (in bytes) of the buffers.
+ */
+#define C_READ_BUFFER_ALIGNMENT 4096
+
+class InputPipeline
+{
+public:
+    explicit InputPipeline(std::istream * const idevice,
+                           const std::size_t bufferSize = C_READ_BUFFER_SIZE,
+                           const int bufferCount = C_READ_BUFFER_COUNT);
+    ~InputPipeline();
+
+    bool next(const char **data, std::size_t *size);
+
+private:
+    InputPipeline(const InputPipeline &);             /* Not copyable */
+    InputPipeline& operator=(const InputPipeline &);
+
+    void run();
+
+    struct Buffer
+    {
+        char *data;
+        std::size_t size;
+    };
+
+    std::istream *m_device;
+    std::size_t m_bufferSize;
+    std::vector<char> m_memory;
+    std::vector<Buffer> m_buffers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::size_t m_filledCount;      /* Buffers filled, and not consumed yet */
+    std::size_t m_readIndex;        /* Next buffer to fill */
+    std::size_t m_consumeIndex;     /* Next buffer to consume */
+    bool m_holding;                 /* The consumer holds a buffer */
+    bool m_atEnd;
+    bool m_stopped;
+    std::thread m_thread;
+};
+
+#endif // INPUT_PIPELINE_H
@@ -14,17 +14,30 @@
  * License along with this program; If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "blockfilter.h"
+#include "blockspiller.h"
+#include "decompressor.h"
+#include "filefollower.h"
 #include "filemanager.h"
+#include "idset.h"
+#include "mappedfile.h"
+#include "punchindex.h"
 #include "reader.h"
 #include "writer.h"
 #include "version.h"
 
+#include <algorithm>
 #include <assert.h>
+#include <cctype>
+#include <csignal>
+#include <cstdlib>
 #include <fstream>
 #include <getopt.h>
 #include <iostream> // std::cout
 #include <stdio.h>
 #include <string>
+#include <string.h> // strlen()
+#include <thread>
 
 
 using namespace std;
@@ -39,6 +52,7 @@ void usage()
     cout << endl;
     cout << " [USAGE] " << endl;
     cout << "    pch2csv [options] filename" << endl;
+    cout << "    solver | pch2csv [options] --stdout - | gzip > output.csv.gz" << endl;
     cout << endl;
     cout << " [OPTIONS]" << endl;
     cout << "    -h, --help" << endl;
@@ -59,6 +73,11 @@ void usage()
     cout << "        surrounded by a double-quote, for instance: " << endl;
     cout << "            -c \"CBUSH ID;;CS;X in mm;Y [mm];CSout\"" << endl;
     cout << endl;
+    cout << "    -n, --named-columns " << endl;
+    cout << "        Name the columns of the known result types" << endl;
+    cout << "        (DISPLACEMENTS, SPCF, ELEMENT FORCES of BUSH...)" << endl;
+    cout << "        instead of 'unknown'." << endl;
+    cout << endl;
     cout << "    -s, --skip-header " << endl;
     cout << "        Do not print the csv header. Data begins at the first line." << endl;
     cout << endl;
@@ -66,6 +85,110 @@ void usage()
     cout << "        Force the tool to produce an unique csv, even if several" << endl;
     cout << "        element types / totals are detected." << endl;
     cout << endl;
+    cout << "    -k, --keep-order " << endl;
+    cout << "        Produce an unique csv (like -u) in the order of the file." << endl;
+    cout << "        The blocks are written as soon as they're read, in a" << endl;
+    cout << "        single pass on a single thread (-j is ignored), so only" << endl;
+    cout << "        one block is in memory at a time." << endl;
+    cout << endl;
+    cout << "    -t, --typed " << endl;
+    cout << "        Decode the fields into numbers while parsing." << endl;
+    cout << "        It reduces the memory used by large files." << endl;
+    cout << endl;
+    cout << "    -x MODE, --complex=MODE " << endl;
+    cout << "        Interleave the real and imaginary parts (or magnitude" << endl;
+    cout << "        and phase) of the complex results into column pairs." << endl;
+    cout << "        MODE is one of:" << endl;
+    cout << "            pairs        keep the form of the punch file," << endl;
+    cout << "            rectangular  convert to real-imaginary," << endl;
+    cout << "            polar        convert to magnitude-phase (degrees)." << endl;
+    cout << endl;
+    cout << "    -j N, --jobs=N " << endl;
+    cout << "        Parse each input file with N threads." << endl;
+    cout << "        By default, N is the number of cores." << endl;
+    cout << endl;
+    cout << "    -i, --index " << endl;
+    cout << "        Use the index of the blocks saved next to the input" << endl;
+    cout << "        file (same name, with .pchidx extension)." << endl;
+    cout << "        The index is created, or updated, if it doesn't match" << endl;
+    cout << "        the input file." << endl;
+    cout << endl;
+    cout << "    -l, --list " << endl;
+    cout << "        List the blocks (line, numbers of rows and columns," << endl;
+    cout << "        header) instead of converting the file." << endl;
+    cout << "        The rows aren't parsed, the file is only scanned." << endl;
+    cout << "        With -i, the file isn't scanned if its index is valid." << endl;
+    cout << endl;
+    cout << "    -b, --buffered " << endl;
+    cout << "        Read the input files into buffers, with a dedicated" << endl;
+    cout << "        I/O thread, instead of mapping them into memory." << endl;
+    cout << "        It's faster on network file systems." << endl;
+    cout << "        The files that can't be mapped (pipes...) are always" << endl;
+    cout << "        read this way." << endl;
+    cout << endl;
+    cout << "    -m SIZE, --max-memory=SIZE " << endl;
+    cout << "        Keep at most SIZE bytes of blocks in memory (with K, M" << endl;
+    cout << "        or G suffix, for instance 2G). Beyond, the blocks are" << endl;
+    cout << "        written to temporary files (one per format, next to" << endl;
+    cout << "        the output), that are concatenated at the end." << endl;
+    cout << endl;
+    cout << "    -d FILE, --diagnostics=FILE " << endl;
+    cout << "        Write the diagnostics of the input files (category," << endl;
+    cout << "        line, offset, and the number of each category)" << endl;
+    cout << "        to FILE, in JSON." << endl;
+    cout << endl;
+    cout << "    --stdout " << endl;
+    cout << "        Write the csv to the standard output, block by block," << endl;
+    cout << "        as soon as each block is read, in the order of the file." << endl;
+    cout << "        The blocks aren't kept in memory after they're written," << endl;
+    cout << "        and the file is parsed on a single thread (-j is ignored)," << endl;
+    cout << "        so only one block is in memory at a time." << endl;
+    cout << "        The blocks aren't grouped by format (like -u)." << endl;
+    cout << endl;
+    cout << "    -f, --follow " << endl;
+    cout << "        Convert the file while it's written by the solver." << endl;
+    cout << "        The complete blocks are appended to the csv as soon as" << endl;
+    cout << "        they're written, until the solver closes the file" << endl;
+    cout << "        or pch2csv is interrupted (Ctrl+C). On Linux, a file that" << endl;
+    cout << "        isn't open for writing anymore is converted at once." << endl;
+    cout << "        The position is saved next to the input file (same name," << endl;
+    cout << "        with .pchpos extension), and a new run resumes there." << endl;
+    cout << "        The blocks aren't grouped by format (like -u)." << endl;
+    cout << endl;
+    cout << " [FILTERS]" << endl;
+    cout << "    The blocks can be selected from their header. The rows of the" << endl;
+    cout << "    other blocks aren't parsed. A block is converted if it matches" << endl;
+    cout << "    all the filters. Each filter can be repeated (alternatives)." << endl;
+    cout << endl;
+    cout << "    --subcase=LIST " << endl;
+    cout << "        Select the subcases of the LIST of ids and ranges," << endl;
+    cout << "        for instance: --subcase=1,3,10-20" << endl;
+    cout << endl;
+    cout << "    --label=LABEL " << endl;
+    cout << "        Select the blocks with the given LABEL." << endl;
+    cout << endl;
+    cout << "    --result-type=TYPE " << endl;
+    cout << "        Select the blocks of the given result type," << endl;
+    cout << "        for instance: --result-type=\"ELEMENT FORCES\"" << endl;
+    cout << endl;
+    cout << "    --header=\"KEY=VALUE\" " << endl;
+    cout << "        Select the blocks whose header KEY has exactly the given" << endl;
+    cout << "        VALUE, for instance: --header=\"ELEMENT TYPE=102  BUSH\"" << endl;
+    cout << endl;
+    cout << "    --ids=FILE " << endl;
+    cout << "        Select the rows whose first field is one of the grid or" << endl;
+    cout << "        element ids listed in FILE. The ids are separated by blanks," << endl;
+    cout << "        commas or new lines, and the ranges are written 10-20" << endl;
+    cout << "        or 10 THRU 20. The blocks without selected row are skipped." << endl;
+    cout << endl;
+    cout << " [STANDARD INPUT]" << endl;
+    cout << "    The filename '-' is the standard input. It requires -o or --stdout." << endl;
+    cout << endl;
+    cout << " [COMPRESSED FILES]" << endl;
+    cout << "    The input files can be compressed with gzip (.pch.gz)" << endl;
+    cout << "    or zstd (.pch.zst). They're decompressed while they're read," << endl;
+    cout << "    without temporary file." << endl;
+    cout << endl;
 }
 
 void version()
@@ -89,6 +212,220 @@ void version()
     cout << endl;
 }
 
+/*! \brief Returns the extension of the punch \a filename,
+ * or an empty string if it isn't a punch file.
+ */
+string punchSuffix(const string &filename)
+{
+    static const char* const suffixes[] = { ".pch", ".pch.gz", ".pch.zst" };
+    for (auto suffix : suffixes) {
+        if (FileManager::hasSuffix(filename, suffix)) {
+            return filename.substr(filename.length() - strlen(suffix));
+        }
+    }
+    return string();
+}
+
+/*! \brief Parses the size in bytes given in \a text, with an optional
+ * suffix K, M or G (powers of 1024), for instance "512M".
+ * Returns \a false if the size is invalid.
+ */
+bool parseSize(const string &text, std::size_t *size)
+{
+    const char *begin = text.c_str();
+    char *end = nullptr;
+    const unsigned long long value = std::strtoull(begin, &end, 10);
+    if (end == begin || text[0] == '-') {
+        return false;
+    }
+    unsigned long long multiplier = 1;
+    switch (::toupper(*end)) {
+    case 'K': multiplier = 1ULL << 10; ++end; break;
+    case 'M': multiplier = 1ULL << 20; ++end; break;
+    case 'G': multiplier = 1ULL << 30; ++end; break;
+    default: break;
+    }
+    if (::toupper(*end) == 'B') {
+        ++end;
+    }
+    if (*end != '\0') {
+        return false;
+    }
+    *size = static_cast<std::size_t>(value * multiplier);
+    return true;
+}
+
+/* Set when pch2csv is interrupted (Ctrl+C) */
+static volatile sig_atomic_t interrupted = 0;
+
+static void interrupt(int)
+{
+    interrupted = 1;
+}
+
+/*! \brief Converts the punch \a filename while it's written.
+ *
+ * The complete blocks are appended to the \a output (or the standard
+ * output) as soon as they're written, until the writer closes the file,
+ * or pch2csv is interrupted. After each step, the position is saved in
+ * the '.pchpos' state, and a new run resumes there.
+ *
+ * Returns \a false if an error occurred.
+ */
+bool followFile(const string &filename, const string &output, const bool toStdout,
+                Writer &writer, const int threadCount, const bool typed,
+                const ComplexConverter::Mode complexMode, const BlockFilter &filter)
+{
+    FileFollower follower;
+    if (!follower.open( filename )) {
+        cerr << "Error: Cannot follow the file '" << filename << "'." << endl;
+        return false;
+    }
+
+    /* Resume the previous run, if it wrote the same output */
+    const string stateFilename = FileFollower::stateFilename( filename );
+    FollowState state;
+    state.offset = 0;
+    state.line = 0;
+    state.output = toStdout ? string("-") : output;
+    FollowState saved;
+    const bool resumed = FileFollower::loadState( stateFilename, &saved )
+            && saved.output == state.output;
+    if (resumed) {
+        state = saved;
+        writer.setPreviousLeftHeaders( state.headers );
+    }
+
+    ofstream ofs;
+    if (!toStdout) {
+        if (!resumed && !FileManager::doBackup( output )) {
+            cerr << "Error: Backup failed, cannot move '" << output << "'." << endl;
+            return false;
+        }
+        ofs.open( output.c_str(), resumed ? ios::out | ios::app : ios::out );
+        if (!ofs.is_open()) {
+            cerr << "Error: Cannot write the file '" << output << "'." << endl;
+            return false;
+        }
+    }
+    ostream &out = toStdout ? cout : ofs;
+
+    signal(SIGINT, interrupt);
+    signal(SIGTERM, interrupt);
+
+    /* Already closed by the writer (finished before, or resumed run):
+     * the whole file is converted */
+    bool converted = true;
+    bool closed = !follower.isWritten();
+    std::size_t searched = state.offset;    /* Lines already searched for a block */
+    while (true) {
+
+        MappedFile file;
+        if (file.open( filename ) && file.size() > state.offset) {
+            const char *begin = file.data();
+            const char *end = file.data() + file.size();
+            const char *from = begin + state.offset;
+
+            if (Decompressor::detect( begin, file.size() ) != Decompressor::None) {
+                cerr << "Error: Cannot follow the compressed file '" << filename << "'." << endl;
+                return false;
+            }
+
+            /* The last block is converted when the file is closed,
+             * otherwise only the complete blocks are converted */
+            const char *cut = end;
+            if (!closed) {
+                const char *complete = end;
+                while (complete > from && complete[-1] != '\n') {
+                    --complete;
+                }
+                const char *search = begin + std::min<std::size_t>(std::max(searched, state.offset),
+                                                                   complete - begin);
+                cut = Reader::lastBlockStart( search, from, complete );
+
+                /* The next search starts at the last complete line */
+                const char *last = complete;
+                if (last > from) {
+                    --last;
+                    while (last > from && last[-1] != '\n') {
+                        --last;
+                    }
+                }
+                searched = last - begin;
+            }
+
+            if (cut > from) {
+                Reader reader;
+                reader.setThreadCount( threadCount );
+                reader.setTyped( typed );
+                reader.setComplexMode( complexMode );
+                reader.setFilter( filter );
+                reader.setOrigin( state.offset, state.line );
+                reader.parsePUNCH( from, cut, [&](PunchBlock &block) {
+                    converted &= writer.writeCSV( block, &out );
+                });
+                out.flush();
+
+                for (auto& msg : reader.getWarnings()) {
+                    std::cerr << msg << std::endl;
+                }
+
+                state.line += std::count( from, cut, '\n' );
+                if (cut[-1] != '\n') {
+                    ++state.line;
+                }
+                state.offset = cut - begin;
+                state.headers = writer.previousLeftHeaders();
+                if (!FileFollower::saveState( stateFilename, state )) {
+                    cerr << "Warning: Cannot write the state '" << stateFilename << "'." << endl;
+                }
+            }
+
+        } else if (file.isOpen() && file.size() < state.offset) {
+            cerr << "Error: The file '" << filename << "' is shorter than its saved position. "
+                 << "Remove '" << stateFilename << "' to convert it again." << endl;
+            return false;
+        }
+        file.close();
+
+        if (closed || interrupted) {
+            break;
+        }
+
+        const FileFollower::Event event = follower.wait( 500 );
+        if (event == FileFollower::Closed) {
+            closed = true;
+        } else if (event == FileFollower::Removed) {
+            cerr << "Warning: The file '" << filename << "' was removed." << endl;
+            break;
+        } else if (event == FileFollower::Error) {
+            cerr << "Error: Cannot follow the file '" << filename << "'." << endl;
+            return false;
+        }
+    }
+
+    if (!toStdout) {
+        ofs.close();
+        cout << "file output: '" << output << "'." << endl;
+    }
+    return converted && !out.fail();
+}
+
+void printBlocks(const string &filename, const PunchIndex &index)
+{
+    cout << "file '" << filename << "': " << index.count() << " blocks." << endl;
+    for (int i = 0; i < index.count(); ++i) {
+        const PunchIndexEntry &entry = index.at(i);
+        cout << "block " << (i + 1)
+             << ": line " << entry.line
+             << ", " << entry.rowCount << " rows"
+             << ", " << entry.columnCount << " columns" << endl;
+        for (auto &header : entry.headers) {
+            cout << "    " << header.first << " = " << header.second << endl;
+        }
+    }
+}
+
 
 /*******************************************************************************
  *******************************************************************************/
@@ -99,6 +436,30 @@ int main( int argc, char *argv[] )
     string output;
     bool mustOutputBeUnique = false;
     bool skipColumnHeaders = false;
+    bool namedColumns = false;
+    bool typed = false;
+    ComplexConverter::Mode complexMode = ComplexConverter::Mode::None;
+    int threadCount = std::thread::hardware_concurrency();
+    bool useIndex = false;
+    bool listBlocks = false;
+    bool buffered = false;
+    string diagnosticsFilename;
+    bool toStdout = false;
+    bool keepOrder = false;
+    bool follow = false;
+    std::size_t maxMemory = 0;
+    BlockFilter filter;
+    IdSet ids;
+    bool hasIds = false;
+
+    /* Options without short name */
+    enum {
+        OPTION_SUBCASE = 256,
+        OPTION_LABEL,
+        OPTION_RESULT_TYPE,
+        OPTION_HEADER,
+        OPTION_IDS
+    };
 
     int c;
     while (1) {
@@ -107,13 +468,30 @@ int main( int argc, char *argv[] )
         { "version"        , no_argument        , nullptr, 'v'},
         { "output"         , required_argument  , nullptr, 'o'},
         { "column-header"  , required_argument  , nullptr, 'c'},
+        { "named-columns"  , no_argument        , nullptr, 'n'},
         { "skip-header"    , no_argument        , nullptr, 's'},
         { "unique"         , no_argument        , nullptr, 'u'},
+        { "keep-order"     , no_argument        , nullptr, 'k'},
+        { "typed"          , no_argument        , nullptr, 't'},
+        { "complex"        , required_argument  , nullptr, 'x'},
+        { "jobs"           , required_argument  , nullptr, 'j'},
+        { "index"          , no_argument        , nullptr, 'i'},
+        { "list"           , no_argument        , nullptr, 'l'},
+        { "buffered"       , no_argument        , nullptr, 'b'},
+        { "max-memory"     , required_argument  , nullptr, 'm'},
+        { "diagnostics"    , required_argument  , nullptr, 'd'},
+        { "stdout"         , no_argument        , nullptr, 'S'},
+        { "follow"         , no_argument        , nullptr, 'f'},
+        { "subcase"        , required_argument  , nullptr, OPTION_SUBCASE},
+        { "label"          , required_argument  , nullptr, OPTION_LABEL},
+        { "result-type"    , required_argument  , nullptr, OPTION_RESULT_TYPE},
+        { "header"         , required_argument  , nullptr, OPTION_HEADER},
+        { "ids"            , required_argument  , nullptr, OPTION_IDS},
         {nullptr, 0, nullptr, 0}
     };
         /* getopt_long stores the option index here. */
         int option_index = 0;
-        c = getopt_long(argc, argv, "hvo:c:su", long_options, &option_index);
+        c = getopt_long(argc, argv, "hvo:c:nsuktx:j:ilbm:d:f", long_options, &option_index);
 
         /* Detect the end of the options. */
         if (c == -1)
@@ -148,6 +526,10 @@ int main( int argc, char *argv[] )
             columnHeaderLine = optarg;
             break;
 
+        case 'n':
+            namedColumns = true;
+            break;
+
         case 's':
             skipColumnHeaders = true;
             break;
@@ -156,6 +538,104 @@ int main( int argc, char *argv[] )
             mustOutputBeUnique = true;
             break;
 
+        case 'k':
+            keepOrder = true;
+            break;
+
+        case 't':
+            typed = true;
+            break;
+
+        case 'x':
+            if (string(optarg) == "pairs") {
+                complexMode = ComplexConverter::Mode::Pairs;
+            } else if (string(optarg) == "rectangular") {
+                complexMode = ComplexConverter::Mode::Rectangular;
+            } else if (string(optarg) == "polar") {
+                complexMode = ComplexConverter::Mode::Polar;
+            } else {
+                cerr << "Error: Unknown complex mode '" << optarg << "'; type '-h' for details." << endl;
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 'j':
+            threadCount = atoi(optarg);
+            break;
+
+        case 'i':
+            useIndex = true;
+            break;
+
+        case 'l':
+            listBlocks = true;
+            break;
+
+        case 'b':
+            buffered = true;
+            break;
+
+        case 'm':
+            if (!parseSize(optarg, &maxMemory) || maxMemory == 0) {
+                cerr << "Error: Invalid memory size '" << optarg << "'; type '-h' for details." << endl;
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 'd':
+            diagnosticsFilename = optarg;
+            break;
+
+        case 'S':
+            toStdout = true;
+            break;
+
+        case 'f':
+            follow = true;
+            break;
+
+        case OPTION_SUBCASE:
+            if (!filter.addSubcases(optarg)) {
+                cerr << "Error: Invalid list of subcases '" << optarg << "'; type '-h' for details." << endl;
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case OPTION_LABEL:
+            filter.addHeader("LABEL", optarg);
+            break;
+
+        case OPTION_RESULT_TYPE:
+            filter.addResultType(optarg);
+            break;
+
+        case OPTION_HEADER:
+        {
+            const string header(optarg);
+            const string::size_type equal = header.find('=');
+            if (equal == string::npos || equal == 0) {
+                cerr << "Error: Invalid header filter '" << optarg << "'; type '-h' for details." << endl;
+                exit(EXIT_FAILURE);
+            }
+            filter.addHeader(header.substr(0, equal), header.substr(equal + 1));
+            break;
+        }
+
+        case OPTION_IDS:
+        {
+            int errorLine = 0;
+            if (!ids.load(optarg, &errorLine)) {
+                if (errorLine > 0) {
+                    cerr << "Error: Invalid id at line " << errorLine << " of '" << optarg << "'; type '-h' for details." << endl;
+                } else {
+                    cerr << "Error: Cannot read the ids from '" << optarg << "'." << endl;
+                }
+                exit(EXIT_FAILURE);
+            }
+            hasIds = true;
+            break;
+        }
+
         case '?':
             /* getopt_long already printed an error message. */
             break;
@@ -166,6 +646,10 @@ int main( int argc, char *argv[] )
         }
     }
 
+    if (hasIds) {
+        filter.setIds(ids);
+    }
+
     /* Remaining command line arguments */
     if (optind < argc) {
         while (optind < argc) {
@@ -183,8 +667,9 @@ int main( int argc, char *argv[] )
     }
 
     for (auto& filename : filenames) {
-        if (!FileManager::hasSuffix(filename, ".PCH")) {
-            cerr << "Error: The file must have a '.pch' extension. "
+        if (filename != "-" && punchSuffix(filename).empty()) {
+            cerr << "Error: The file must have a '.pch' extension "
+                 << "(or '.pch.gz', '.pch.zst'). "
                  << "Wrong extension in '" << filename << "'. "
                  << "Maybe not a punch file?" << endl;
             cerr << "Error: Type '-h' for details." << endl;
@@ -192,44 +677,277 @@ int main( int argc, char *argv[] )
         }
     }
 
+    if (follow && (filenames.size() != 1 || filenames.front() == "-" || listBlocks)) {
+        cerr << "Error: --follow requires one punch file, and can't list the blocks; "
+             << "type '-h' for details." << endl;
+        exit(EXIT_FAILURE);
+    }
+
     /* *********************************************** */
     /* Set the output file                             */
     /* *********************************************** */
     assert(!filenames.empty());
-    if (output.empty()) {
+    const bool toFile = !listBlocks && !toStdout && !follow;
+    if (output.empty() && (toFile || (follow && !toStdout))) {
         string filename = filenames.front();
-        output = filename.substr(0, filename.length() - 4);
+        if (filename == "-") {
+            cerr << "Error: Need an output file (-o) or --stdout to read the standard input; "
+                 << "type '-h' for details." << endl;
+            exit(EXIT_FAILURE);
+        }
+        output = filename.substr(0, filename.length() - punchSuffix(filename).length());
         output += string(".csv");
     }
-    if (!FileManager::doBackup(output)) {
+    if (toFile && !FileManager::doBackup(output)) {
         cerr << "Error: Backup failed, cannot move '" << output << "'." << endl;
         exit(EXIT_FAILURE);
     }
 
 
+    /* *********************************************** */
+    /* Follow the file while it's written              */
+    /* *********************************************** */
+    if (follow) {
+        Writer writer(columnHeaderLine, skipColumnHeaders, namedColumns);
+        const bool followed = followFile( filenames.front(), output, toStdout, writer,
+                                          threadCount, typed, complexMode, filter );
+        exit(followed ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
     /* *********************************************** */
     /* Do the conversion                               */
     /* *********************************************** */
     PunchFile pch;
 
+    /* The diagnostics of all the files, as a JSON array */
+    ofstream diagnosticsStream;
+    if (!diagnosticsFilename.empty()) {
+        diagnosticsStream.open( diagnosticsFilename.c_str() );
+        if (!diagnosticsStream.is_open()) {
+            cerr << "Error: Cannot write the file '" << diagnosticsFilename << "'." << endl;
+            exit(EXIT_FAILURE);
+        }
+        diagnosticsStream << "[";
+    }
+    bool hasDiagnostics = false;
+
+    /* With --stdout or --keep-order, the blocks are written as soon as
+     * they're read, instead of being kept and grouped by format */
+    const bool streaming = !listBlocks && (toStdout || keepOrder);
+    Writer streamWriter(columnHeaderLine, skipColumnHeaders, namedColumns);
+    bool streamed = true;
+    bool corrupted = false;     /* A compressed input is corrupted or truncated */
+    ofstream streamFile;
+    if (streaming && !toStdout) {
+        streamFile.open( output.c_str() );
+        if (!streamFile.is_open()) {
+            cerr << "Error: Cannot write the file '" << output << "'." << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    ostream &streamOutput = toStdout ? cout : streamFile;
+
+    /* With --max-memory, once the blocks kept in memory exceed the budget,
+     * they're grouped by format in run files, next to the output */
+    const bool spillable = !listBlocks && !streaming && maxMemory > 0;
+    BlockSpiller spiller(output, columnHeaderLine, skipColumnHeaders, namedColumns);
+    bool spilling = false;
+    bool spilled = true;
+    std::size_t heldBytes = 0;  /* Memory of the blocks of the previous files */
+
     for (auto& filename : filenames) {
 
+        /* The file is read as a stream if it can't be mapped into memory
+         * (pipe, device...), or if the buffered read is required */
+        const bool isStdin = (filename == "-");
+        MappedFile file;
         ifstream ifs;
-        ifs.open( filename.c_str(), std::ios::in | std::ios::binary );
-        if( !ifs.is_open() ){
+        bool mapped = !buffered && !isStdin && file.open( filename );
+
+        /* The compressed files are decompressed while they're read */
+        if (mapped && Decompressor::detect( file.data(), file.size() ) != Decompressor::None) {
+            file.close();
+            mapped = false;
+        }
+        if (!mapped && !isStdin) {
+            ifs.open( filename.c_str(), ios::in | ios::binary );
+        }
+        istream &input = isStdin ? cin : ifs;
+
+        if( !mapped && !isStdin && !ifs.is_open() ){
             cerr << "Error: Cannot open the file '" << filename << "'." << endl;
         } else {
 
+            const char *begin = file.data();
+            const char *end = file.data() + file.size();
+
+            /* The index is valid if it matches the current file */
+            const string indexFilename = PunchIndex::indexFilename( filename );
+            PunchIndex index;
+            long long size = 0;
+            long long modificationTime = 0;
+            bool indexed = false;
+            if (useIndex && mapped) {
+                indexed = PunchIndex::fileStamp( filename, &size, &modificationTime )
+                        && index.load( indexFilename )
+                        && index.fileSize() == size
+                        && index.modificationTime() == modificationTime
+                        && index.isConsistent( begin, end );
+            }
+
+            /* The index lists all the blocks, even those filtered out:
+             * the filtered list is scanned into a new index */
+            if (listBlocks && indexed) {
+                if (filter.isEmpty()) {
+                    printBlocks( filename, index );
+                    file.close();
+                    continue;
+                }
+                indexed = false;
+            }
+
+            /* The streamed blocks are parsed serially: the parallel parse
+             * would hold 2 chunks of parsed blocks per thread */
             Reader reader;
-            PunchFile p = reader.parsePUNCH( &ifs );
-            pch += p;
+            reader.setThreadCount( streaming ? 1 : threadCount );
+            reader.setTyped( typed );
+            reader.setComplexMode( complexMode );
+            reader.setFilter( filter );
+
+            PunchFile p;
+            auto store = [&](PunchBlock &block) {
+                if (streaming) {
+                    streamed &= streamWriter.writeCSV( block, &streamOutput );
+                } else if (spilling) {
+                    spilled &= spiller.append( block );
+                } else {
+                    p.append( block );
+                    if (spillable && heldBytes + p.arena()->reservedBytes() > maxMemory) {
+                        /* The blocks in memory go first, in the order of the files */
+                        spilled &= spiller.append( pch );
+                        spilled &= spiller.append( p );
+                        pch = PunchFile();
+                        p = PunchFile();
+                        heldBytes = 0;
+                        spilling = true;
+                    }
+                }
+            };
+            if (indexed) {
+                reader.parsePUNCH( begin, end, index, store );
+            } else {
+                index.clear();
+                index.setStamp( size, modificationTime );
+                auto handler = [&](PunchBlock &block) {
+                    if (useIndex || listBlocks) {
+                        index.append( block, begin, end );
+                    }
+                    if (!listBlocks) {
+                        store( block );
+                    }
+                };
+                /* The list only needs the structure of the blocks */
+                if (!mapped) {
+                    Decompressor decompressor( &input );
+                    if (!Decompressor::isSupported( decompressor.format() )) {
+                        cerr << "Error: Cannot decompress the file '" << filename << "': "
+                             << "pch2csv is built without support of its format." << endl;
+                        exit(EXIT_FAILURE);
+                    }
+                    istream stream( &decompressor );
+                    reader.parsePUNCH( &stream, handler );
+                    if (decompressor.hasError()) {
+                        cerr << "Error: The file '" << filename << "' is corrupted or truncated." << endl;
+                        corrupted = true;
+                    }
+                } else if (listBlocks) {
+                    reader.scanPUNCH( begin, end, handler );
+                } else {
+                    reader.parsePUNCH( begin, end, handler );
+                }
+                /* The index of the filtered blocks would be incomplete */
+                if (useIndex && mapped && filter.isEmpty() && !index.save( indexFilename )) {
+                    cerr << "Warning: Cannot write the index '" << indexFilename << "'." << endl;
+                }
+            }
+            heldBytes += p.arena()->reservedBytes();
+            pch += std::move(p);
 
             for (auto& msg : reader.getWarnings()) {
                 std::cerr << msg << std::endl;
             }
+            if (diagnosticsStream.is_open()) {
+                diagnosticsStream << (hasDiagnostics ? ",\n" : "\n");
+                reader.diagnostics().writeJson( diagnosticsStream, filename );
+                hasDiagnostics = true;
+            }
+
+            if (listBlocks) {
+                printBlocks( filename, index );
+            }
+
+            file.close();
+        }
+    }
+
+    if (diagnosticsStream.is_open()) {
+        diagnosticsStream << "\n]\n";
+        diagnosticsStream.close();
+    }
+
+    /* The csv of a corrupted input is incomplete: it's not a success */
+    if (corrupted) {
+        if (streaming) {
+            streamOutput.flush();
+        }
+        spiller.clear();
+        cerr << "Error: The conversion is incomplete." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (listBlocks) {
+        exit(EXIT_SUCCESS);
+    }
+
+    if (streaming) {
+        streamOutput.flush();
+        if (!streamed || !streamOutput) {
+            cerr << "Error: scanner encountered an error." << endl;
+            exit(EXIT_FAILURE);
+        }
+        if (!toStdout) {
+            streamFile.close();
+            cout << "file output: '" << output << "'." << endl;
+        }
+        exit(EXIT_SUCCESS);
+    }
+
+    if (spilling) {
+
+        bool converted = spilled;
+        int i = 0;
+        if (mustOutputBeUnique) {
+            converted = converted && spiller.writeUnique( output );
+        } else {
+            for (const int keyId : spiller.keyIds()) {
+                string outputIncr = FileManager::formatIncrement(output, i);
+                FileManager::doBackup( outputIncr );
+                converted &= spiller.writeRun( keyId, outputIncr );
+                i++;
+            }
+        }
+        spiller.clear();
 
-            ifs.close();
+        if( !converted ) {
+            cerr << "Error: Cannot write the files of the formats (disk full?)." << endl;
+            exit(EXIT_FAILURE);
+        } else if (mustOutputBeUnique) {
+            cout << "file output: '" << output << "'." << endl;
+        } else {
+            cout << "Warning: pch2csv detected " << to_string(i) << " different formats." << endl;
+            cout << "Then, " << to_string(i) << " files are produced. " << endl;
         }
+        exit(EXIT_SUCCESS);
     }
 
     if (mustOutputBeUnique) {
@@ -241,14 +959,13 @@ int main( int argc, char *argv[] )
             exit(EXIT_FAILURE);
         } else {
 
-            Writer writer(columnHeaderLine, skipColumnHeaders);
+            Writer writer(columnHeaderLine, skipColumnHeaders, namedColumns);
 
             bool converted = true;
-            for (auto & key : pch.blockKeys()) {
-                auto br = pch.blockRange(key);
+            for (const int keyId : pch.keyIds()) {
+                auto br = pch.blockRange(keyId);
                 for (auto b = br.first; b != br.second; ++b) {
-                    PunchBlock block = b->second;
-                    converted &= writer.writeCSV(block, &ofs);
+                    converted &= writer.writeCSV(*b, &ofs);
                 }
             }
             ofs.close();
@@ -265,7 +982,7 @@ int main( int argc, char *argv[] )
 
         bool converted = true;
         int i = 0;
-        for (auto & key : pch.blockKeys()) {
+        for (const int keyId : pch.keyIds()) {
 
             string outputIncr = FileManager::formatIncrement(output, i);
             FileManager::doBackup( outputIncr );
@@ -277,12 +994,11 @@ int main( int argc, char *argv[] )
                 exit(EXIT_FAILURE);
             } else {
 
-                Writer writer(columnHeaderLine, skipColumnHeaders);
+                Writer writer(columnHeaderLine, skipColumnHeaders, namedColumns);
 
-                auto pp = pch.blockRange(key);
+                auto pp = pch.blockRange(keyId);
                 for (auto p = pp.first; p != pp.second; ++p) {
-                    PunchBlock block = p->second;
-                    converted &= writer.writeCSV(block, &ofs);
+                    converted &= writer.writeCSV(*p, &ofs);
                 }
 
                 ofs.close();
@@ -0,0 +1,182 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mappedfile.h"
+
+#include "qsystemdetection.h"
+
+#if defined(Q_OS_WIN)
+#  include <windows.h>
+#else
+#  include <fcntl.h>      // open()
+#  include <sys/mman.h>   // mmap()
+#  include <sys/stat.h>   // fstat()
+#  include <unistd.h>     // close()
+#endif
+
+/*! \class MappedFile
+ *  \brief The class MappedFile maps a file read-only into memory.
+ *
+ * The content is available with \a data() and \a size(), without
+ * copying the bytes into a buffer. The mapping remains valid until
+ * \a close() is called or the MappedFile is destroyed.
+ *
+ * An empty file can be opened, but then \a data() returns 0.
+ *
+ * \example
+ *
+ * \code
+ * MappedFile file;
+ * if (file.open("input.pch")) {
+ *     Reader reader;
+ *     PunchFile pch = reader.parsePUNCH(file.data(), file.data() + file.size());
+ * }
+ * \endcode
+ */
+/*! \brief Constructor.
+ */
+MappedFile::MappedFile()
+    : m_data(0)
+    , m_size(0)
+    , m_fileHandle(0)
+    , m_mappingHandle(0)
+{
+}
+
+/*! \brief Destructor.
+ */
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Maps the given \a filename into memory.
+ * Returns \a true if successful, otherwise returns \a false.
+ */
+#if defined(Q_OS_WIN)
+bool MappedFile::open(const std::string &filename)
+{
+    close();
+
+    HANDLE file = ::CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                                NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!::GetFileSizeEx(file, &size)) {
+        ::CloseHandle(file);
+        return false;
+    }
+    m_fileHandle = file;
+    m_size = static_cast<std::size_t>(size.QuadPart);
+    if (m_size == 0) {
+        return true;
+    }
+    HANDLE mapping = ::CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        close();
+        return false;
+    }
+    m_mappingHandle = mapping;
+    m_data = static_cast<const char*>(::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_data) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data) {
+        ::UnmapViewOfFile(m_data);
+    }
+    if (m_mappingHandle) {
+        ::CloseHandle(static_cast<HANDLE>(m_mappingHandle));
+    }
+    if (m_fileHandle) {
+        ::CloseHandle(static_cast<HANDLE>(m_fileHandle));
+    }
+    m_data = 0;
+    m_size = 0;
+    m_fileHandle = 0;
+    m_mappingHandle = 0;
+}
+
+#else
+bool MappedFile::open(const std::string &filename)
+{
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+    /* The file descriptor is stored as a pointer-sized handle */
+    m_fileHandle = reinterpret_cast<void*>(static_cast<std::ptrdiff_t>(fd) + 1);
+    m_size = static_cast<std::size_t>(st.st_size);
+    if (m_size == 0) {
+        return true;
+    }
+    void *addr = ::mmap(0, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        close();
+        return false;
+    }
+    ::madvise(addr, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const char*>(addr);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data) {
+        ::munmap(const_cast<char*>(m_data), m_size);
+    }
+    if (m_fileHandle) {
+        int fd = static_cast<int>(reinterpret_cast<std::ptrdiff_t>(m_fileHandle) - 1);
+        ::close(fd);
+    }
+    m_data = 0;
+    m_size = 0;
+    m_fileHandle = 0;
+    m_mappingHandle = 0;
+}
+#endif
+
+/******************************************************************************
+ ******************************************************************************/
+bool MappedFile::isOpen() const
+{
+    return (m_fileHandle != 0);
+}
+
+const char* MappedFile::data() const
+{
+    return m_data;
+}
+
+std::size_t MappedFile::size() const
+{
+    return m_size;
+}
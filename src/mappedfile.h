@@ -0,0 +1,45 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+class MappedFile
+{
+public:
+    explicit MappedFile();
+    ~MappedFile();
+
+    bool open(const std::string &filename);
+    void close();
+
+    bool isOpen() const;
+    const char* data() const;
+    std::size_t size() const;
+
+private:
+    MappedFile(const MappedFile &);             /* Not copyable */
+    MappedFile& operator=(const MappedFile &);
+
+    const char *m_data;
+    std::size_t m_size;
+    void *m_fileHandle;
+    void *m_mappingHandle;
+};
+
+#endif // MAPPED_FILE_H
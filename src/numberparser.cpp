@@ -0,0 +1,249 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "numberparser.h"
+
+#include <cmath>    // isfinite(), isnormal()
+#include <cstdio>   // snprintf()
+#include <cstdlib>  // strtod()
+
+/*!
+ * C_MAX_PRECISION
+ *
+ * Maximum number of digits after the decimal point of a real number.
+ * With 15 significant digits, a double converts back to the same digits.
+ */
+#define C_MAX_PRECISION 14
+
+/*! \class NumberParser
+ *  \brief The class NumberParser decodes the numbers of the Punch fields.
+ *
+ * The parser is locale-independent, and tuned for the Fortran E-format
+ * written by Nastran, like \a 4.462737E-06 or \a -1.600000E+00.
+ *
+ * The parser only accepts the \e canonical representations, i.e. the texts
+ * that the formatter writes back exactly (byte-identical). Other texts are
+ * rejected, and should be kept as text:
+ *
+ * \li Integer: an optional minus sign followed by 1 to 18 digits, without
+ *     leading zero. For instance: \a 0, \a 80004230, \a -12.
+ * \li Real: an optional minus sign, one digit, a decimal point, 1 to 14 digits,
+ *     \a E, the sign of the exponent, and a 2-digit exponent (3-digit if
+ *     greater than 99). The first digit is not zero, except for a null value
+ *     with exponent \a +00.
+ *     For instance: \a 4.462737E-06, \a -0.000000E+00.
+ *
+ */
+
+static const double s_powersOf10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool isDigit(const char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Decodes the canonical integer in [\a begin, \a end) into \a value.
+ * Returns \a false if the text isn't a canonical integer.
+ */
+bool NumberParser::parseInteger(const char *begin, const char *end, long long *value)
+{
+    const char *p = begin;
+    const bool negative = (p != end && *p == '-');
+    if (negative) {
+        ++p;
+    }
+    const int digits = static_cast<int>(end - p);
+    if (digits < 1 || digits > 18) {
+        return false;
+    }
+    if (*p == '0' && (digits > 1 || negative)) {
+        return false;
+    }
+    long long n = 0;
+    for (; p != end; ++p) {
+        if (!isDigit(*p)) {
+            return false;
+        }
+        n = n * 10 + (*p - '0');
+    }
+    *value = negative ? -n : n;
+    return true;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Decodes the canonical real number in [\a begin, \a end) into \a value.
+ * The number of digits after the decimal point is stored in \a precision.
+ * Returns \a false if the text isn't a canonical real number.
+ *
+ * The result is correctly rounded. When the mantissa and the power of ten
+ * are both exact doubles, the value is computed with a single multiplication
+ * or division. Otherwise, the value is computed by strtod() from a text
+ * without decimal point, so it doesn't depend on the locale.
+ */
+bool NumberParser::parseReal(const char *begin, const char *end, double *value, int *precision)
+{
+    const char *p = begin;
+    const bool negative = (p != end && *p == '-');
+    if (negative) {
+        ++p;
+    }
+
+    /* Mantissa */
+    if (end - p < 7 || !isDigit(p[0]) || p[1] != '.') {
+        return false;
+    }
+    long long mantissa = p[0] - '0';
+    const char leadingDigit = p[0];
+    p += 2;
+    const char *fraction = p;
+    while (p != end && isDigit(*p)) {
+        mantissa = mantissa * 10 + (*p - '0');
+        ++p;
+    }
+    const int digits = static_cast<int>(p - fraction);
+    if (digits < 1 || digits > C_MAX_PRECISION) {
+        return false;
+    }
+
+    /* Exponent */
+    if (end - p < 4 || p[0] != 'E' || (p[1] != '+' && p[1] != '-')) {
+        return false;
+    }
+    const bool negativeExponent = (p[1] == '-');
+    p += 2;
+    const int exponentDigits = static_cast<int>(end - p);
+    if (exponentDigits != 2 && exponentDigits != 3) {
+        return false;
+    }
+    if (exponentDigits == 3 && p[0] == '0') {
+        return false;
+    }
+    int exponent = 0;
+    for (; p != end; ++p) {
+        if (!isDigit(*p)) {
+            return false;
+        }
+        exponent = exponent * 10 + (*p - '0');
+    }
+    if (exponentDigits == 2 && exponent == 0 && negativeExponent) {
+        return false;
+    }
+    if (negativeExponent) {
+        exponent = -exponent;
+    }
+
+    /* Normalized: 1.xxx to 9.xxx, or 0.000 with a null exponent */
+    if (leadingDigit == '0' && (mantissa != 0 || exponent != 0)) {
+        return false;
+    }
+
+    double result;
+    const int power = exponent - digits;
+    if (power >= 0 && power <= 22) {
+        result = static_cast<double>(mantissa) * s_powersOf10[power];
+    } else if (power < 0 && power >= -22) {
+        result = static_cast<double>(mantissa) / s_powersOf10[-power];
+    } else {
+        char buffer[48];
+        std::snprintf(buffer, sizeof(buffer), "%llde%d", mantissa, power);
+        result = std::strtod(buffer, 0);
+    }
+
+    /* Out of the range of the normal doubles: the field stays a text,
+     * since it wouldn't be formatted back to the same digits */
+    if (!std::isfinite(result) || (result != 0 && !std::isnormal(result))) {
+        return false;
+    }
+
+    *value = negative ? -result : result;
+    *precision = digits;
+    return true;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+std::string NumberParser::formatInteger(const long long value)
+{
+    char buffer[C_NUMBER_BUFFER_SIZE];
+    return std::string(buffer, formatInteger(value, buffer));
+}
+
+/*! \brief Returns the E-format text of the given \a value,
+ * with \a precision digits after the decimal point.
+ *
+ * The decimal point is always a dot '.', whatever the locale.
+ */
+std::string NumberParser::formatReal(const double value, const int precision)
+{
+    char buffer[C_NUMBER_BUFFER_SIZE];
+    return std::string(buffer, formatReal(value, precision, buffer));
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Writes the text of the given integer \a value in \a buffer,
+ * and returns its length.
+ *
+ * The \a buffer must hold at least C_NUMBER_BUFFER_SIZE characters.
+ * This function doesn't allocate memory.
+ */
+int NumberParser::formatInteger(const long long value, char *buffer)
+{
+    char digits[C_NUMBER_BUFFER_SIZE];
+    unsigned long long u = value < 0
+            ? 0ULL - static_cast<unsigned long long>(value)
+            : static_cast<unsigned long long>(value);
+    int count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + (u % 10));
+        u /= 10;
+    } while (u != 0);
+
+    int length = 0;
+    if (value < 0) {
+        buffer[length++] = '-';
+    }
+    while (count > 0) {
+        buffer[length++] = digits[--count];
+    }
+    return length;
+}
+
+/*! \brief Writes the E-format text of the given \a value in \a buffer,
+ * with \a precision digits after the decimal point, and returns its length.
+ *
+ * The \a buffer must hold at least C_NUMBER_BUFFER_SIZE characters.
+ * This function doesn't allocate memory.
+ */
+int NumberParser::formatReal(const double value, const int precision, char *buffer)
+{
+    int length = std::snprintf(buffer, C_NUMBER_BUFFER_SIZE, "%.*E", precision, value);
+    if (length < 0 || length >= C_NUMBER_BUFFER_SIZE) {
+        return 0;
+    }
+    for (int i = 0; i + 1 < length; ++i) {
+        if (isDigit(buffer[i])) {
+            buffer[i + 1] = '.';
+            break;
+        }
+    }
+    return length;
+}
@@ -0,0 +1,38 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NUMBER_PARSER_H
+#define NUMBER_PARSER_H
+
+#include <string>
+
+/* Size of the buffer given to the non-allocating formatters */
+#define C_NUMBER_BUFFER_SIZE 48
+
+class NumberParser
+{
+public:
+    /* Parse */
+    static bool parseInteger(const char *begin, const char *end, long long *value);
+    static bool parseReal(const char *begin, const char *end, double *value, int *precision);
+
+    /* Format */
+    static std::string formatInteger(const long long value);
+    static std::string formatReal(const double value, const int precision);
+    static int formatInteger(const long long value, char *buffer);
+    static int formatReal(const double value, const int precision, char *buffer);
+};
+
+#endif // NUMBER_PARSER_H
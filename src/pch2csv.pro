@@ -18,6 +18,7 @@ CONFIG -= incremental_off
 CONFIG -= depend_includepath
 CONFIG -= windows # BUG: 'windows' prevents std::cout to write in the console.
 CONFIG += c++11
+CONFIG += thread
 
 #message($${CONFIG})
 
@@ -32,21 +33,65 @@ lessThan(QT_VERSION, 5.0) {
 #-------------------------------------------------
 include($$PWD/../version.pri)
 
+#-------------------------------------------------
+# LIBRARIES
+#-------------------------------------------------
+# Compressed input files: gzip with zlib,
+# and zstd with 'CONFIG+=zstd'
+!win32 {
+    DEFINES += PCH2CSV_HAS_ZLIB
+    LIBS += -lz
+}
+zstd {
+    DEFINES += PCH2CSV_HAS_ZSTD
+    LIBS += -lzstd
+}
+
 #-------------------------------------------------
 # SOURCES
 #-------------------------------------------------
 HEADERS  += \
+    $$PWD/arena.h \
+    $$PWD/blockfilter.h \
+    $$PWD/blockspiller.h \
+    $$PWD/complexconverter.h \
+    $$PWD/decompressor.h \
+    $$PWD/diagnostics.h \
+    $$PWD/filefollower.h \
     $$PWD/filemanager.h \
+    $$PWD/idset.h \
+    $$PWD/inputpipeline.h \
+    $$PWD/mappedfile.h \
+    $$PWD/numberparser.h \
     $$PWD/punchfile.h \
+    $$PWD/punchindex.h \
+    $$PWD/punchschema.h \
     $$PWD/reader.h \
+    $$PWD/recordscanner.h \
+    $$PWD/symboltable.h \
     $$PWD/qsystemdetection.h \
     $$PWD/writer.h \
     $$PWD/version.h
 
 SOURCES += \
+    $$PWD/arena.cpp \
+    $$PWD/blockfilter.cpp \
+    $$PWD/blockspiller.cpp \
+    $$PWD/complexconverter.cpp \
+    $$PWD/decompressor.cpp \
+    $$PWD/diagnostics.cpp \
+    $$PWD/filefollower.cpp \
     $$PWD/filemanager.cpp \
+    $$PWD/idset.cpp \
+    $$PWD/inputpipeline.cpp \
+    $$PWD/mappedfile.cpp \
+    $$PWD/numberparser.cpp \
     $$PWD/punchfile.cpp \
+    $$PWD/punchindex.cpp \
+    $$PWD/punchschema.cpp \
     $$PWD/reader.cpp \
+    $$PWD/recordscanner.cpp \
+    $$PWD/symboltable.cpp \
     $$PWD/writer.cpp \
     $$PWD/main.cpp
 
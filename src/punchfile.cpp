@@ -16,8 +16,22 @@
 
 #include "punchfile.h"
 
+#include "numberparser.h"
+#include "symboltable.h"
+
+#include <algorithm>
+#include <utility>
+
 using namespace std;
 
+/* FNV-1a, 64-bit */
+static const std::uint64_t s_fingerprintBasis = 14695981039346656037ull;
+
+static inline std::uint64_t fingerprint(std::uint64_t hash, const int value)
+{
+    hash ^= static_cast<std::uint32_t>(value);
+    return hash * 1099511628211ull;
+}
 
 /*! \class PunchBlock
  *  \brief Contains a block of data represented in the Punch file by a header
@@ -45,18 +59,126 @@ using namespace std;
  *  \li prefixRow    : a (n,r) table that contains the block data as row (repeated r times)
  *  \li rows         : a (m,r) table that contains the rows data
  *
+ * \subsection sec-cells Cells
+ *
+ * The rows are stored in one flat array of 16-byte cells
+ * (\a PunchValue) with the offset of each row in this array. The characters
+ * of the Text cells are stored contiguously in a single character buffer,
+ * and the cells only keep their offset and size in this buffer.
+ * So appending a row doesn't allocate memory per field, and the accessors
+ * \a value() and \a field() don't allocate memory at all.
+ *
+ * The rows can be appended as strings (\a PunchRow), or as decoded values.
+ * In the latter case, the block is \e typed: integers and real numbers are
+ * stored in the cells, and only the fields that can't be decoded keep their
+ * text.
+ *
+ * The strings of a typed block are formatted back on demand by \a rows(),
+ * \a field() and \a text(), and are identical to the original fields.
+ *
+ * \subsection sec-arena Arena
+ *
+ * A block can allocate its memory in an \a Arena, typically the one of the
+ * PunchFile that stores it. By default, the block uses the heap.
+ *
+ * \subsection sec-symbols Headers
+ *
+ * The keys and the values of the headers are interned in the \a SymbolTable.
+ * The block only stores their ids, sorted by key.
+ *
+ * \subsection sec-lazy Lazy Blocks
+ *
+ * A block can be \e lazy: it has its header, its numbers of rows and columns,
+ * but its rows are parsed only when they are accessed for the first time
+ * (by \a rows(), \a value(), \a field()...), by the loader given to
+ * \a setLoader(). See \a Reader::scanPUNCH().
+ *
+ * Loading a block modifies it, even through the const accessors, so a lazy
+ * block must be loaded (see \a load()) before being shared between threads.
+ *
+ * If the result type of the block is known, \a schema() gives the names and
+ * the types of its columns (see \a PunchSchema). Otherwise it returns 0.
+ *
  */
 /*! \brief Constructor.
  */
 PunchBlock::PunchBlock()
+    : m_typed(false)
+    , m_schema(0)
+    , m_sourceOffset(0)
+    , m_sourceLine(0)
+    , m_lazyRowCount(0)
+    , m_lazyColumnCount(0)
+    , m_formatFingerprint(0)
+    , m_hasFormatFingerprint(false)
+{
+}
+
+/*! \brief Constructor. The memory is allocated in the given \a arena.
+ */
+PunchBlock::PunchBlock(const std::shared_ptr<Arena> &arena)
+    : m_prefixRowAndHeader(ArenaAllocator<PunchPrefix>(arena))
+    , m_values(ArenaAllocator<PunchValue>(arena))
+    , m_rowOffsets(ArenaAllocator<std::size_t>(arena))
+    , m_chars(ArenaAllocator<char>(arena))
+    , m_typed(false)
+    , m_schema(0)
+    , m_sourceOffset(0)
+    , m_sourceLine(0)
+    , m_lazyRowCount(0)
+    , m_lazyColumnCount(0)
+    , m_formatFingerprint(0)
+    , m_hasFormatFingerprint(false)
+{
+}
+
+/*! \brief Copy constructor. The copy is allocated in the given \a arena.
+ */
+PunchBlock::PunchBlock(const PunchBlock &other, const std::shared_ptr<Arena> &arena)
+    : m_prefixRowAndHeader(other.m_prefixRowAndHeader, ArenaAllocator<PunchPrefix>(arena))
+    , m_values(other.m_values, ArenaAllocator<PunchValue>(arena))
+    , m_rowOffsets(other.m_rowOffsets, ArenaAllocator<std::size_t>(arena))
+    , m_chars(other.m_chars, ArenaAllocator<char>(arena))
+    , m_typed(other.m_typed)
+    , m_schema(other.m_schema)
+    , m_sourceOffset(other.m_sourceOffset)
+    , m_sourceLine(other.m_sourceLine)
+    , m_loader(other.m_loader)
+    , m_lazyRowCount(other.m_lazyRowCount)
+    , m_lazyColumnCount(other.m_lazyColumnCount)
+    , m_formatFingerprint(other.m_formatFingerprint)
+    , m_hasFormatFingerprint(other.m_hasFormatFingerprint)
+{
+}
+
+/*! \brief Returns the arena of the block, or null if the block uses the heap.
+ */
+std::shared_ptr<Arena> PunchBlock::arena() const
 {
+    return m_values.get_allocator().arena();
 }
 
 /******************************************************************************
  ******************************************************************************/
 void PunchBlock::insertPrefix(const std::string & key, const std::string & value)
 {
-    m_prefixRowAndHeader[key] = value;
+    SymbolTable &table = SymbolTable::instance();
+    const int keyId = table.intern(key);
+    const int valueId = table.intern(value);
+
+    /* The headers are sorted by key */
+    auto it = m_prefixRowAndHeader.begin();
+    for ( ; it != m_prefixRowAndHeader.end(); ++it) {
+        if (it->first == keyId) {
+            it->second = valueId;
+            return;
+        }
+        if (key < table.symbol(it->first)) {
+            break;
+        }
+    }
+    m_prefixRowAndHeader.insert( it, PunchPrefix(keyId, valueId) );
+    m_hasFormatFingerprint = false;
 }
 
 /******************************************************************************
@@ -65,7 +187,94 @@ void PunchBlock::append(const PunchRow &row)
 {
     if (row.empty())
         return;
-    m_rows.push_back( row );
+    load();
+    if (m_rowOffsets.empty()) {
+        m_hasFormatFingerprint = false;     /* The first row gives the columns */
+    }
+    m_rowOffsets.push_back( m_values.size() );
+    for (const std::string &field : row) {
+        PunchValue value;
+        value.precision = 0;
+        value.size = 0;
+        value.text = 0;
+        if (field.empty()) {
+            value.type = PunchValue::Empty;
+        } else {
+            value.type = PunchValue::Text;
+            value.size = field.size();
+            value.text = m_chars.size();
+            m_chars.insert( m_chars.end(), field.begin(), field.end() );
+        }
+        m_values.push_back( value );
+    }
+}
+
+/*! \brief Appends a row of \a count \a values.
+ * The Text values are offsets in the given \a chars.
+ */
+void PunchBlock::append(const PunchValue *values, const int count, const char *chars)
+{
+    if (count <= 0)
+        return;
+    load();
+    if (m_rowOffsets.empty()) {
+        m_hasFormatFingerprint = false;     /* The first row gives the columns */
+    }
+    m_rowOffsets.push_back( m_values.size() );
+    for (int i = 0; i < count; ++i) {
+        PunchValue value = values[i];
+        if (value.type == PunchValue::Text) {
+            const char *text = chars + value.text;
+            value.text = m_chars.size();
+            m_chars.insert( m_chars.end(), text, text + value.size );
+        } else if (value.type != PunchValue::Empty) {
+            m_typed = true;
+        }
+        m_values.push_back( value );
+    }
+}
+
+/*! \brief Removes the header and the rows.
+ * The memory is kept, so it's reused by the next rows.
+ */
+void PunchBlock::clear()
+{
+    m_prefixRowAndHeader.clear();
+    m_schema = 0;
+    m_sourceOffset = 0;
+    m_sourceLine = 0;
+    removeRows();
+}
+
+/*! \brief Removes the rows, but keeps the header.
+ */
+void PunchBlock::removeRows()
+{
+    m_loader = PunchBlockLoader();
+    m_lazyRowCount = 0;
+    m_lazyColumnCount = 0;
+    m_values.clear();
+    m_rowOffsets.clear();
+    m_chars.clear();
+    m_typed = false;
+    m_hasFormatFingerprint = false;
+}
+
+/*! \brief Swaps the rows with the ones of the \a other block, without copying them.
+ * The headers are kept.
+ * Both blocks should use the same arena, so the memory stays in it.
+ */
+void PunchBlock::swapRows(PunchBlock &other)
+{
+    m_loader.swap(other.m_loader);
+    std::swap(m_lazyRowCount, other.m_lazyRowCount);
+    std::swap(m_lazyColumnCount, other.m_lazyColumnCount);
+    m_values.swap(other.m_values);
+    m_rowOffsets.swap(other.m_rowOffsets);
+    m_chars.swap(other.m_chars);
+    std::swap(m_typed, other.m_typed);
+    m_hasFormatFingerprint = false;
+    other.m_hasFormatFingerprint = false;
 }
 
 /******************************************************************************
@@ -75,44 +284,288 @@ int PunchBlock::prefixCount() const
     return m_prefixRowAndHeader.size();
 }
 
+/*! \brief Returns the key of the header at the given \a index.
+ */
+const std::string& PunchBlock::prefixKey(const int index) const
+{
+    return SymbolTable::instance().symbol( m_prefixRowAndHeader.at(index).first );
+}
+
+/*! \brief Returns the id of the key of the header at the given \a index,
+ * in the SymbolTable.
+ */
+int PunchBlock::prefixKeyId(const int index) const
+{
+    return m_prefixRowAndHeader.at(index).first;
+}
+
+/*! \brief Returns the value of the header at the given \a index.
+ */
+const std::string& PunchBlock::prefixValue(const int index) const
+{
+    return SymbolTable::instance().symbol( m_prefixRowAndHeader.at(index).second );
+}
+
 int PunchBlock::columnCount() const
 {
-    if (m_rows.empty())
-        return 0;
-    PunchRow row = m_rows.front();
-    return row.size();
+    if (m_loader)
+        return m_lazyColumnCount;
+    return fieldCount(0);
 }
 
 int PunchBlock::rowCount() const
 {
-    return m_rows.size();
+    if (m_loader)
+        return m_lazyRowCount;
+    return m_rowOffsets.size();
 }
 
 /******************************************************************************
  ******************************************************************************/
 std::map<std::string, std::string> PunchBlock::prefixRowAndHeader() const
 {
-    return m_prefixRowAndHeader;
+    SymbolTable &table = SymbolTable::instance();
+    std::map<std::string, std::string> prefix;
+    for (const PunchPrefix &var : m_prefixRowAndHeader) {
+        prefix.emplace_hint( prefix.end(), table.symbol(var.first), table.symbol(var.second) );
+    }
+    return prefix;
 }
 
 std::list<PunchRow> PunchBlock::rows() const
 {
-    return m_rows;
+    load();
+    std::list<PunchRow> rows;
+    for (int row = 0; row < rowCount(); ++row) {
+        PunchRow r;
+        for (int column = 0; column < fieldCount(row); ++column) {
+            r.push_back( text(row, column) );
+        }
+        rows.push_back( r );
+    }
+    return rows;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns \a true if the block contains decoded integers or real numbers.
+ */
+bool PunchBlock::isTyped() const
+{
+    load();
+    return m_typed;
+}
+
+/*! \brief Returns the number of fields of the given \a row.
+ */
+int PunchBlock::fieldCount(const int row) const
+{
+    load();
+    if (row < 0 || row >= static_cast<int>(m_rowOffsets.size()))
+        return 0;
+    std::size_t end = (row + 1 < static_cast<int>(m_rowOffsets.size()))
+            ? m_rowOffsets[row + 1]
+            : m_values.size();
+    return end - m_rowOffsets[row];
+}
+
+/*! \brief Returns the cell at the given \a row and \a column.
+ * Returns an Empty value if the cell doesn't exist.
+ */
+PunchValue PunchBlock::value(const int row, const int column) const
+{
+    if (column < 0 || column >= fieldCount(row)) {
+        PunchValue empty;
+        empty.type = PunchValue::Empty;
+        empty.precision = 0;
+        empty.size = 0;
+        empty.integer = 0;
+        return empty;
+    }
+    return m_values[m_rowOffsets[row] + column];
+}
+
+/*! \brief Returns the text of the cell at the given \a row and \a column.
+ *
+ * The text of a Text cell is a view on the block characters. The integers
+ * and the real numbers are formatted in the given \a buffer, that must hold
+ * at least C_NUMBER_BUFFER_SIZE characters.
+ * This function doesn't allocate memory.
+ */
+PunchField PunchBlock::field(const int row, const int column, char *buffer) const
+{
+    PunchValue v = value(row, column);
+    PunchField field;
+    field.data = buffer;
+    field.size = 0;
+    switch (v.type) {
+    case PunchValue::Integer:
+        field.size = NumberParser::formatInteger(v.integer, buffer);
+        break;
+    case PunchValue::Real:
+        field.size = NumberParser::formatReal(v.real, v.precision, buffer);
+        break;
+    case PunchValue::Text:
+        field.data = m_chars.data() + v.text;
+        field.size = v.size;
+        break;
+    case PunchValue::Empty:
+    default:
+        break;
+    }
+    return field;
+}
+
+/*! \brief Returns the text of the cell at the given \a row and \a column.
+ */
+std::string PunchBlock::text(const int row, const int column) const
+{
+    char buffer[C_NUMBER_BUFFER_SIZE];
+    return field(row, column, buffer).toString();
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns the schema of the result type, or 0 if the type is unknown.
+ */
+const PunchSchema* PunchBlock::schema() const
+{
+    return m_schema;
+}
+
+void PunchBlock::setSchema(const PunchSchema *schema)
+{
+    m_schema = schema;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns the offset (in bytes) of the first line of the block in the input.
+ */
+std::size_t PunchBlock::sourceOffset() const
+{
+    return m_sourceOffset;
+}
+
+/*! \brief Returns the number of the first line of the block in the input.
+ */
+int PunchBlock::sourceLine() const
+{
+    return m_sourceLine;
+}
+
+void PunchBlock::setSource(const std::size_t offset, const int line)
+{
+    m_sourceOffset = offset;
+    m_sourceLine = line;
 }
 
 /******************************************************************************
  ******************************************************************************/
-string PunchBlock::hash() const
+/*! \brief Returns \a false if the rows of the block aren't parsed yet.
+ */
+bool PunchBlock::isLoaded() const
+{
+    return !m_loader;
+}
+
+/*! \brief Makes the block lazy: its rows are removed, and they will be
+ * parsed by the given \a loader when they are accessed.
+ *
+ * Until then, \a rowCount() and \a columnCount() return the given
+ * \a rowCount and \a columnCount.
+ */
+void PunchBlock::setLoader(const PunchBlockLoader &loader, const int rowCount, const int columnCount)
+{
+    removeRows();
+    m_loader = loader;
+    m_lazyRowCount = rowCount;
+    m_lazyColumnCount = columnCount;
+}
+
+/*! \brief Parses the rows of a lazy block. Does nothing if the block is loaded.
+ *
+ * The rows and the schema are taken from the block given by the loader.
+ * The header of the block is kept.
+ */
+void PunchBlock::load() const
+{
+    if (!m_loader)
+        return;
+
+    /* The rows are a cache of the bytes of the block */
+    PunchBlock *self = const_cast<PunchBlock*>(this);
+    PunchBlockLoader loader;
+    loader.swap(self->m_loader);
+    PunchBlock loaded = loader();
+
+    self->m_values.assign( loaded.m_values.begin(), loaded.m_values.end() );
+    self->m_rowOffsets.assign( loaded.m_rowOffsets.begin(), loaded.m_rowOffsets.end() );
+    self->m_chars.assign( loaded.m_chars.begin(), loaded.m_chars.end() );
+    self->m_typed = loaded.m_typed;
+    self->m_schema = loaded.m_schema;
+    self->m_lazyRowCount = 0;
+    self->m_lazyColumnCount = 0;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns the 64-bit fingerprint of the format of the block,
+ * i.e. of the ids of its header keys and its number of columns.
+ *
+ * The blocks of the same format have the same fingerprint, so comparing
+ * the formats of two blocks is an integer comparison. The fingerprint is
+ * computed once, when the Reader closes the block (see \a updateFormat()),
+ * and again only if the header or the rows are modified.
+ */
+std::uint64_t PunchBlock::formatFingerprint() const
+{
+    if (!m_hasFormatFingerprint) {
+        std::uint64_t hash = s_fingerprintBasis;
+        for (const PunchPrefix &var : m_prefixRowAndHeader) {
+            hash = fingerprint(hash, var.first);
+        }
+        m_formatFingerprint = fingerprint(hash, columnCount());
+        m_hasFormatFingerprint = true;
+    }
+    return m_formatFingerprint;
+}
+
+/*! \brief Returns the canonical text of the format of the block:
+ * the keys of its header, then its number of columns, separated by commas.
+ * This is the key of its group in the PunchFile.
+ *
+ * The commas and the backslashes of the keys are escaped with a backslash,
+ * so two different formats never have the same text.
+ */
+std::string PunchBlock::formatKey() const
 {
+    SymbolTable &table = SymbolTable::instance();
     string key;
-    for (const std::pair<const string, string> &var : m_prefixRowAndHeader) {
-        key += var.first;
+    for (const PunchPrefix &var : m_prefixRowAndHeader) {
+        for (const char c : table.symbol(var.first)) {
+            if (c == ',' || c == '\\') {
+                key += '\\';
+            }
+            key += c;
+        }
         key += ",";
     }
     key += std::to_string( columnCount() );
     return key;
 }
 
+/*! \brief Computes the fingerprint of the format of the complete block.
+ *
+ * Like \a load(), it must be called before sharing the block between
+ * threads, since \a formatFingerprint() caches the fingerprint.
+ */
+void PunchBlock::updateFormat()
+{
+    m_hasFormatFingerprint = false;
+    formatFingerprint();
+}
+
 
 /******************************************************************************
  ******************************************************************************
@@ -122,7 +575,8 @@ string PunchBlock::hash() const
 /*! \class PunchFile
  *  \brief Contains the data of a PUNCH format stream or file.
  *
- * The PunchFile is a dictionary (multi-map) that stores one or several PunchBlock.
+ * The PunchFile is a dictionary that stores one or several PunchBlock,
+ * grouped by format.
  *
  * A PunchBlock represents a continuous block of data in the PUNCH format stream.
  * These blocks are actually delimited by lines commented out with dollar symbol '$'.
@@ -132,44 +586,258 @@ string PunchBlock::hash() const
  * To access the blocks, you need to get the hash key among those returned with \a blockKeys().
  * Then use \a blockRange() to get all the blocks using this key.
  *
+ * Each key has a dense id, from 0 to \a keyCount() - 1, given in the order
+ * of appearance. The blocks of a key are stored contiguously, in the order
+ * of the file, so \a block() returns the n-th block of a key in constant
+ * time. \a keyIds() gives the ids in the order of the keys.
+ *
+ * The blocks are grouped by the ids of their header keys (see \a SymbolTable),
+ * in a hash table indexed by the fingerprint of their format (computed by the
+ * Reader, see \a PunchBlock::formatFingerprint()). So the hash key is computed
+ * once per distinct format, and grouping the blocks takes a linear time.
+ *
+ * The rows of the blocks are copied into the \a Arena of the PunchFile,
+ * so all their memory is released at once with the PunchFile. The counters
+ * of the arena show the number of allocations actually made to the system.
+ *
+ * The blocks moved into the PunchFile (rvalue \a append() and '+=') aren't
+ * copied: they keep their memory. Merging the PunchFile of several input
+ * files this way doesn't copy any row.
+ *
  */
 /*! \brief Constructor.
  */
 PunchFile::PunchFile()
+    : m_arena(std::make_shared<Arena>())
+    , m_lastFormatId(-1)
 {
 }
 
+/*! \brief Returns the arena that stores the blocks.
+ */
+std::shared_ptr<Arena> PunchFile::arena() const
+{
+    return m_arena;
+}
+
 /******************************************************************************
  ******************************************************************************/
+/*! \brief Copies the given \a block into the arena of the file.
+ * The copy takes the exact size of the rows.
+ */
 void PunchFile::append(const PunchBlock &block)
 {
-    auto key = block.hash();
-    this->m_keys.emplace(key);
-    this->m_blockMap.emplace(key, block);
+    const int id = addKey(block);
+    m_groups[id].emplace_back(block, m_arena);
+}
+
+/*! \brief Moves the given \a block into the file.
+ * The rows aren't copied: the block keeps its memory, i.e. the heap,
+ * or the arena of the PunchFile it comes from (which is kept alive
+ * as long as the block uses it).
+ */
+void PunchFile::append(PunchBlock &&block)
+{
+    const int id = addKey(block);
+    m_groups[id].push_back(std::move(block));
+}
+
+/*! \brief Returns the id of the key of the given \a block, i.e. of its
+ * format (header keys and number of columns). The key is added if it's new,
+ * without block.
+ */
+int PunchFile::addKey(const PunchBlock &block)
+{
+    /* The format is identified by its fingerprint, then by the ids of the header keys */
+    const std::uint64_t fingerprint = block.formatFingerprint();
+    if (m_lastFormatId >= 0
+            && m_fingerprints[m_lastFormatId] == fingerprint
+            && isFormat(m_lastFormatId, block)) {
+        return m_lastFormatId;
+    }
+
+    auto range = m_formatIds.equal_range(fingerprint);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (isFormat(it->second, block)) {
+            m_lastFormatId = it->second;
+            return m_lastFormatId;
+        }
+    }
+
+    /* New format: the hash key is computed only once */
+    std::vector<int> format;
+    format.reserve(block.m_prefixRowAndHeader.size() + 1);
+    for (const PunchPrefix &var : block.m_prefixRowAndHeader) {
+        format.push_back( var.first );
+    }
+    format.push_back( block.columnCount() );
+    m_lastFormatId = insertFormat(format, fingerprint, block.formatKey());
+    return m_lastFormatId;
+}
+
+/*! \internal
+ * Returns true if the given \a block has the format of the key \a keyId.
+ */
+bool PunchFile::isFormat(const int keyId, const PunchBlock &block) const
+{
+    const std::vector<int> &format = m_formats[keyId];
+    const std::size_t size = block.m_prefixRowAndHeader.size();
+    if (format.size() != size + 1 || format[size] != block.columnCount()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < size; ++i) {
+        if (format[i] != block.m_prefixRowAndHeader[i].first) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*! \internal
+ * Returns the id of the given \a format, with the given \a fingerprint
+ * and hash \a key. The format is added if it's new.
+ */
+int PunchFile::insertFormat(const std::vector<int> &format, const std::uint64_t fingerprint,
+                            const std::string &key)
+{
+    auto range = m_formatIds.equal_range(fingerprint);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (m_formats[it->second] == format) {
+            return it->second;
+        }
+    }
+    const int id = static_cast<int>(m_keys.size());
+    m_keys.push_back(key);
+    m_formats.push_back(format);
+    m_fingerprints.push_back(fingerprint);
+    m_groups.push_back(PunchBlockVector());
+    m_formatIds.emplace(fingerprint, id);
+    m_keyIds.emplace(key, id);
+    return id;
+}
+
+void PunchFile::clearGroups()
+{
+    m_keys.clear();
+    m_formats.clear();
+    m_fingerprints.clear();
+    m_groups.clear();
+    m_formatIds.clear();
+    m_keyIds.clear();
+    m_lastFormatId = -1;
 }
 
 /******************************************************************************
  ******************************************************************************/
+/*! \brief Returns the number of keys, i.e. of formats.
+ */
+int PunchFile::keyCount() const
+{
+    return static_cast<int>(m_keys.size());
+}
+
+/*! \brief Returns the id of the given \a key, or -1 if the key is unknown.
+ */
+int PunchFile::keyId(const std::string &key) const
+{
+    auto it = m_keyIds.find(key);
+    return (it == m_keyIds.end()) ? -1 : it->second;
+}
+
+const std::string& PunchFile::key(const int keyId) const
+{
+    return m_keys.at(keyId);
+}
+
+/*! \brief Returns the ids of the keys, in the order of the keys
+ * (i.e. the order of \a blockKeys()).
+ */
+std::vector<int> PunchFile::keyIds() const
+{
+    std::vector<int> ids(m_keys.size());
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+        ids[i] = static_cast<int>(i);
+    }
+    std::sort(ids.begin(), ids.end(), [this](const int a, const int b) {
+        return m_keys[a] < m_keys[b];
+    });
+    return ids;
+}
+
+int PunchFile::blockCount(const int keyId) const
+{
+    return static_cast<int>(m_groups.at(keyId).size());
+}
+
+/*! \brief Returns the block at the given \a index (in the order of the file)
+ * of the key \a keyId.
+ */
+const PunchBlock& PunchFile::block(const int keyId, const int index) const
+{
+    return m_groups.at(keyId).at(index);
+}
+
+PunchBlockRange PunchFile::blockRange(const int keyId) const
+{
+    const PunchBlockVector &group = m_groups.at(keyId);
+    return PunchBlockRange(group.begin(), group.end());
+}
+
+/*! \brief Returns the keys, sorted.
+ */
 std::set<std::string> PunchFile::blockKeys() const
 {
-    return m_keys;
+    return std::set<std::string>(m_keys.begin(), m_keys.end());
 }
 
 PunchBlockRange PunchFile::blockRange(const std::string & key) const
 {
-    return m_blockMap.equal_range(key);
+    const int id = keyId(key);
+    if (id < 0) {
+        static const PunchBlockVector empty;
+        return PunchBlockRange(empty.end(), empty.end());
+    }
+    return blockRange(id);
 }
 
 /******************************************************************************
  ******************************************************************************/
 PunchFile& PunchFile::operator+=(const PunchFile& other)
 {
-    for (auto & key : other.blockKeys()) {
-        auto pp = other.blockRange(key);
-        for (auto p = pp.first; p != pp.second; ++p) {
-            PunchBlock block = p->second;
-            append(block);
+    for (std::size_t k = 0; k < other.m_groups.size(); ++k) {
+        const int id = insertFormat(other.m_formats[k], other.m_fingerprints[k], other.m_keys[k]);
+        PunchBlockVector &group = m_groups[id];
+        group.reserve(group.size() + other.m_groups[k].size());
+        for (const PunchBlock &block : other.m_groups[k]) {
+            group.emplace_back(block, m_arena);
+        }
+    }
+    return *this;
+}
+
+/*! \brief Moves the blocks of \a other into the file, without copying
+ * their rows, and leaves \a other empty.
+ *
+ * The groups of blocks whose key is new are spliced.
+ */
+PunchFile& PunchFile::operator+=(PunchFile&& other)
+{
+    if (&other == this) {
+        return *this;
+    }
+    for (std::size_t k = 0; k < other.m_groups.size(); ++k) {
+        const int id = insertFormat(other.m_formats[k], other.m_fingerprints[k], other.m_keys[k]);
+        PunchBlockVector &group = m_groups[id];
+        PunchBlockVector &blocks = other.m_groups[k];
+        if (group.empty()) {
+            group.swap(blocks);
+        } else {
+            group.reserve(group.size() + blocks.size());
+            for (PunchBlock &block : blocks) {
+                group.push_back(std::move(block));
+            }
         }
     }
+    other.clearGroups();
     return *this;
 }
@@ -16,62 +16,207 @@
 #ifndef PUNCH_FILE_H
 #define PUNCH_FILE_H
 
+#include "arena.h"
+
+#include <cstddef>
+#include <cstdint>
 #include <deque>
+#include <functional>
 #include <list>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <vector>
+
+struct PunchSchema;
+class PunchBlock;
 
 typedef std::deque<std::string> PunchRow;
 
+/*!
+ * PunchBlockLoader
+ *
+ * Function that parses the rows of a lazy block (see \a PunchBlock::setLoader()).
+ */
+typedef std::function<PunchBlock()> PunchBlockLoader;
+
+/*!
+ * PunchPrefix
+ *
+ * A header of a block: the ids of its key and its value in the SymbolTable.
+ */
+typedef std::pair<int, int> PunchPrefix;
+
+/*!
+ * PunchField
+ *
+ * A non-owning view on the characters of a field (like a string_view).
+ * The characters are not copied until \a toString() is called.
+ */
+struct PunchField
+{
+    const char *data;
+    std::size_t size;
+
+    bool empty() const { return size == 0; }
+    std::string toString() const { return std::string(data, size); }
+};
+
+/*!
+ * PunchValue
+ *
+ * A cell of a PunchBlock: a field decoded as an integer or a real number,
+ * or the text of the field if it isn't decoded.
+ */
+struct PunchValue
+{
+    enum Type : unsigned char {
+        Empty,
+        Text,
+        Integer,
+        Real
+    };
+
+    Type type;
+    unsigned char precision;    /* Real: number of digits after the decimal point */
+    unsigned int size;          /* Text: number of characters */
+    union {
+        long long integer;
+        double real;
+        std::size_t text;       /* Text: offset of the characters in the PunchBlock */
+    };
+};
+
 class PunchBlock
 {
     friend class PunchFile;
 
 public:
     explicit PunchBlock();
+    explicit PunchBlock(const std::shared_ptr<Arena> &arena);
+    PunchBlock(const PunchBlock &other, const std::shared_ptr<Arena> &arena);
+
+    std::shared_ptr<Arena> arena() const;
 
     /* Setters */
     void insertPrefix(const std::string & key, const std::string & value);
     void append(const PunchRow &row);
+    void append(const PunchValue *values, const int count, const char *chars);
+    void clear();
+    void removeRows();
+    void swapRows(PunchBlock &other);
 
     /* Getters */
     int prefixCount() const;
+    const std::string& prefixKey(const int index) const;
+    int prefixKeyId(const int index) const;
+    const std::string& prefixValue(const int index) const;
     int columnCount() const;
     int rowCount() const;
     std::map<std::string, std::string> prefixRowAndHeader() const;
     std::list<PunchRow> rows() const;
 
-protected:
-    std::string hash() const;
+    /* Cell getters */
+    bool isTyped() const;
+    int fieldCount(const int row) const;
+    PunchValue value(const int row, const int column) const;
+    PunchField field(const int row, const int column, char *buffer) const;
+    std::string text(const int row, const int column) const;
 
-private:
-    std::list<PunchRow> m_rows;
-    std::map<std::string, std::string> m_prefixRowAndHeader;
+    /* Result type */
+    const PunchSchema* schema() const;
+    void setSchema(const PunchSchema *schema);
 
+    /* Position of the first line in the input */
+    std::size_t sourceOffset() const;
+    int sourceLine() const;
+    void setSource(const std::size_t offset, const int line);
+
+    /* Lazy block */
+    bool isLoaded() const;
+    void setLoader(const PunchBlockLoader &loader, const int rowCount, const int columnCount);
+    void load() const;
+
+    /* Format (header keys and number of columns) */
+    std::uint64_t formatFingerprint() const;
+    std::string formatKey() const;
+    void updateFormat();
+
+private:
+    std::vector<PunchPrefix, ArenaAllocator<PunchPrefix> > m_prefixRowAndHeader;
+
+    /* Cells */
+    std::vector<PunchValue, ArenaAllocator<PunchValue> > m_values;
+    std::vector<std::size_t, ArenaAllocator<std::size_t> > m_rowOffsets;
+    std::vector<char, ArenaAllocator<char> > m_chars;
+    bool m_typed;
+    const PunchSchema *m_schema;
+    std::size_t m_sourceOffset;
+    int m_sourceLine;
+
+    /* Rows not parsed yet */
+    PunchBlockLoader m_loader;
+    int m_lazyRowCount;
+    int m_lazyColumnCount;
+
+    /* Cache of the fingerprint of the format */
+    mutable std::uint64_t m_formatFingerprint;
+    mutable bool m_hasFormatFingerprint;
 };
 
-typedef std::multimap<std::string, PunchBlock> PunchBlockMMap;
-typedef std::pair<PunchBlockMMap::const_iterator, PunchBlockMMap::const_iterator> PunchBlockRange;
+/* The blocks of a key, in the order of the file */
+typedef std::vector<PunchBlock> PunchBlockVector;
+typedef std::pair<PunchBlockVector::const_iterator, PunchBlockVector::const_iterator> PunchBlockRange;
 
 class PunchFile
 {
 public:
     explicit PunchFile();
 
+    std::shared_ptr<Arena> arena() const;
+
     /* Setters */
     void append(const PunchBlock &block);
+    void append(PunchBlock &&block);
+    int addKey(const PunchBlock &block);
 
     /* Getters */
+    int keyCount() const;
+    int keyId(const std::string &key) const;
+    const std::string& key(const int keyId) const;
+    std::vector<int> keyIds() const;
+
+    int blockCount(const int keyId) const;
+    const PunchBlock& block(const int keyId, const int index) const;
+    PunchBlockRange blockRange(const int keyId) const;
+
     std::set<std::string> blockKeys() const;
     PunchBlockRange blockRange(const std::string & key) const;
 
     /* Operators */
     PunchFile& operator+=(const PunchFile& other);
+    PunchFile& operator+=(PunchFile&& other);
 
 private:
-    std::set<std::string> m_keys;
-    PunchBlockMMap m_blockMap;
+    bool isFormat(const int keyId, const PunchBlock &block) const;
+    int insertFormat(const std::vector<int> &format, const std::uint64_t fingerprint,
+                     const std::string &key);
+    void clearGroups();
+
+    std::shared_ptr<Arena> m_arena;
+
+    /* Groups of blocks, by dense key id */
+    std::vector<std::string> m_keys;
+    std::vector<std::vector<int> > m_formats;
+    std::vector<std::uint64_t> m_fingerprints;
+    std::vector<PunchBlockVector> m_groups;
+    std::unordered_multimap<std::uint64_t, int> m_formatIds;
+    std::unordered_map<std::string, int> m_keyIds;
+
+    /* The consecutive blocks usually share the same format */
+    int m_lastFormatId;
 };
 
 
@@ -0,0 +1,322 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "punchindex.h"
+
+#include "punchfile.h"
+
+#include <cstring>  // memchr()
+#include <fstream>
+#include <sys/stat.h>
+
+using namespace std;
+
+/*! \class PunchIndex
+ *  \brief The class PunchIndex is the index of the blocks of a punch file.
+ *
+ * For each block, the index records the position of its first line
+ * (offset in bytes and line number), its header and its numbers of rows
+ * and columns (see \a PunchIndexEntry).
+ *
+ * The index is saved next to the punch file, in a '.pchidx' file
+ * (see \a indexFilename()). When the file is opened again, the index
+ * gives the blocks without scanning the file, and the ranges of bytes
+ * of the blocks, that can be parsed independently.
+ *
+ * The index is stamped with the size and the modification time of the file.
+ * Moreover, the sequence numbers (columns 73-80) of the first lines
+ * of the blocks are checked by \a isConsistent(), so an index that doesn't
+ * match the file is detected, even if the stamp is the same.
+ *
+ * \example
+ *
+ * \code
+ * long long size, time;
+ * PunchIndex index;
+ * if (PunchIndex::fileStamp(filename, &size, &time)
+ *         && index.load(PunchIndex::indexFilename(filename))
+ *         && index.fileSize() == size && index.modificationTime() == time
+ *         && index.isConsistent(file.data(), file.data() + file.size())) {
+ *     // The index is up to date
+ * }
+ * \endcode
+ */
+/*! \brief Constructor.
+ */
+PunchIndex::PunchIndex()
+    : m_fileSize(0)
+    , m_modificationTime(0)
+{
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns the name of the index of the given punch \a filename,
+ * i.e. the \a filename with the '.pchidx' extension.
+ */
+string PunchIndex::indexFilename(const string &filename)
+{
+    const string::size_type dot = filename.find_last_of('.');
+    const string::size_type separator = filename.find_last_of("/\\");
+    if (dot == string::npos || (separator != string::npos && dot < separator)) {
+        return filename + ".pchidx";
+    }
+    return filename.substr(0, dot) + ".pchidx";
+}
+
+/*! \brief Gets the \a size and the \a modificationTime (in seconds)
+ * of the given \a filename. Returns \a false if the file doesn't exist.
+ */
+bool PunchIndex::fileStamp(const string &filename, long long *size, long long *modificationTime)
+{
+    struct stat status;
+    if (::stat(filename.c_str(), &status) != 0) {
+        return false;
+    }
+    if (size) {
+        *size = static_cast<long long>(status.st_size);
+    }
+    if (modificationTime) {
+        *modificationTime = static_cast<long long>(status.st_mtime);
+    }
+    return true;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+long long PunchIndex::fileSize() const
+{
+    return m_fileSize;
+}
+
+long long PunchIndex::modificationTime() const
+{
+    return m_modificationTime;
+}
+
+void PunchIndex::setStamp(const long long size, const long long modificationTime)
+{
+    m_fileSize = size;
+    m_modificationTime = modificationTime;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns the sequence number (columns 73-80) of the line
+ * at the given \a offset, or an empty string if the line isn't a record.
+ */
+static string sequenceAt(const char *begin, const char *end, const std::size_t offset)
+{
+    if (!begin || offset >= static_cast<std::size_t>(end - begin)) {
+        return string();
+    }
+    const char *line = begin + offset;
+    const char *eol = static_cast<const char*>(std::memchr(line, '\n', end - line));
+    std::size_t length = (eol ? eol : end) - line;
+    while (length > 0 && line[length - 1] == '\r') {
+        --length;
+    }
+    if (length != 80) {
+        return string();
+    }
+    const char *first = line + 80 - 8;
+    const char *last = line + 80;
+    while (first != last && (*first == ' ' || *first == '\t')) {
+        ++first;
+    }
+    while (last != first && (*(last - 1) == ' ' || *(last - 1) == '\t')) {
+        --last;
+    }
+    return string(first, last);
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void PunchIndex::clear()
+{
+    m_fileSize = 0;
+    m_modificationTime = 0;
+    m_entries.clear();
+}
+
+/*! \brief Appends the given \a block, parsed from the bytes in the range
+ * [\a begin, \a end). The bytes give the sequence number of its first line.
+ */
+void PunchIndex::append(const PunchBlock &block, const char *begin, const char *end)
+{
+    PunchIndexEntry entry;
+    entry.offset = block.sourceOffset();
+    entry.line = block.sourceLine();
+    entry.sequence = sequenceAt(begin, end, entry.offset);
+    entry.rowCount = block.rowCount();
+    entry.columnCount = block.columnCount();
+    entry.headers.reserve( block.prefixCount() );
+    for (int i = 0; i < block.prefixCount(); ++i) {
+        entry.headers.push_back( std::make_pair(block.prefixKey(i), block.prefixValue(i)) );
+    }
+    m_entries.push_back( entry );
+}
+
+int PunchIndex::count() const
+{
+    return m_entries.size();
+}
+
+const PunchIndexEntry& PunchIndex::at(const int index) const
+{
+    return m_entries.at(index);
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns the offset of the range of bytes of the block at \a index.
+ *
+ * The ranges of the blocks are contiguous, and they cover the whole file:
+ * the first range begins at the start of the file (with the lines before
+ * the first block, if any), and each range ends at the start of the next one.
+ */
+std::size_t PunchIndex::rangeBegin(const int index) const
+{
+    return index == 0 ? 0 : m_entries.at(index).offset;
+}
+
+std::size_t PunchIndex::rangeEnd(const int index) const
+{
+    return index + 1 < count()
+            ? m_entries.at(index + 1).offset
+            : static_cast<std::size_t>(m_fileSize);
+}
+
+/*! \brief Returns the number of lines before the range of the block at \a index.
+ */
+int PunchIndex::rangeLine(const int index) const
+{
+    return index == 0 ? 0 : m_entries.at(index).line - 1;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns \a true if the index matches the bytes in the range
+ * [\a begin, \a end), i.e. the size is the same, and each block starts
+ * on a line with the recorded sequence number.
+ */
+bool PunchIndex::isConsistent(const char *begin, const char *end) const
+{
+    const std::size_t size = end - begin;
+    if (static_cast<long long>(size) != m_fileSize) {
+        return false;
+    }
+    std::size_t previous = 0;
+    for (int i = 0; i < count(); ++i) {
+        const PunchIndexEntry &entry = m_entries[i];
+        if (entry.offset >= size || (i > 0 && entry.offset <= previous)) {
+            return false;
+        }
+        if (entry.offset > 0 && begin[entry.offset - 1] != '\n') {
+            return false;
+        }
+        if (i > 0 && begin[entry.offset] != '$') {
+            return false;
+        }
+        if (sequenceAt(begin, end, entry.offset) != entry.sequence) {
+            return false;
+        }
+        previous = entry.offset;
+    }
+    return true;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Loads the index from the given \a filename.
+ * Returns \a false if the file can't be read, or isn't a valid index.
+ */
+bool PunchIndex::load(const string &filename)
+{
+    clear();
+
+    ifstream ifs(filename.c_str());
+    if (!ifs.is_open()) {
+        return false;
+    }
+
+    string line;
+    if (!std::getline(ifs, line) || line != "PCHIDX " + to_string(C_INDEX_VERSION)) {
+        return false;
+    }
+
+    int entryCount = 0;
+    if (!(ifs >> m_fileSize >> m_modificationTime >> entryCount) || entryCount < 0) {
+        clear();
+        return false;
+    }
+    m_entries.reserve(entryCount);
+
+    for (int i = 0; i < entryCount; ++i) {
+        PunchIndexEntry entry;
+        int headerCount = 0;
+        if (!(ifs >> entry.offset >> entry.line >> entry.rowCount
+              >> entry.columnCount >> headerCount) || headerCount < 0) {
+            clear();
+            return false;
+        }
+        ifs.ignore(1); /* end of line */
+        if (!std::getline(ifs, entry.sequence)) {
+            clear();
+            return false;
+        }
+        entry.headers.resize(headerCount);
+        for (auto &header : entry.headers) {
+            if (!std::getline(ifs, header.first) || !std::getline(ifs, header.second)) {
+                clear();
+                return false;
+            }
+        }
+        m_entries.push_back( entry );
+    }
+    return true;
+}
+
+/*! \brief Saves the index to the given \a filename.
+ *
+ * The index is a text file:
+ * \code
+ * PCHIDX 1
+ * <file size> <modification time> <block count>
+ * <offset> <line> <row count> <column count> <header count>   (for each block)
+ * <sequence number>
+ * <key>                                                         (for each header)
+ * <value>
+ * \endcode
+ */
+bool PunchIndex::save(const string &filename) const
+{
+    ofstream ofs(filename.c_str());
+    if (!ofs.is_open()) {
+        return false;
+    }
+    ofs << "PCHIDX " << C_INDEX_VERSION << '\n';
+    ofs << m_fileSize << ' ' << m_modificationTime << ' ' << m_entries.size() << '\n';
+    for (const PunchIndexEntry &entry : m_entries) {
+        ofs << entry.offset << ' ' << entry.line << ' ' << entry.rowCount << ' '
+            << entry.columnCount << ' ' << entry.headers.size() << '\n';
+        ofs << entry.sequence << '\n';
+        for (const auto &header : entry.headers) {
+            ofs << header.first << '\n' << header.second << '\n';
+        }
+    }
+    ofs.close();
+    return !ofs.fail();
+}
@@ -0,0 +1,85 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PUNCH_INDEX_H
+#define PUNCH_INDEX_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+class PunchBlock;
+
+/*!
+ * C_INDEX_VERSION
+ *
+ * Version of the format of the '.pchidx' files.
+ * An index of another version is ignored.
+ */
+#define C_INDEX_VERSION 1
+
+/*!
+ * PunchIndexEntry
+ *
+ * Position and summary of a block of the punch file.
+ */
+struct PunchIndexEntry
+{
+    std::size_t offset;     /* Offset (in bytes) of the first line */
+    int line;               /* Number of the first line */
+    std::string sequence;   /* Sequence number of the first line (columns 73-80) */
+    int rowCount;
+    int columnCount;
+    std::vector<std::pair<std::string, std::string> > headers;
+};
+
+class PunchIndex
+{
+public:
+    explicit PunchIndex();
+
+    static std::string indexFilename(const std::string &filename);
+    static bool fileStamp(const std::string &filename, long long *size, long long *modificationTime);
+
+    /* Stamp of the indexed file */
+    long long fileSize() const;
+    long long modificationTime() const;
+    void setStamp(const long long size, const long long modificationTime);
+
+    /* Entries */
+    void clear();
+    void append(const PunchBlock &block, const char *begin, const char *end);
+    int count() const;
+    const PunchIndexEntry& at(const int index) const;
+
+    /* Range of bytes to parse a block */
+    std::size_t rangeBegin(const int index) const;
+    std::size_t rangeEnd(const int index) const;
+    int rangeLine(const int index) const;
+
+    bool isConsistent(const char *begin, const char *end) const;
+
+    /* Storage */
+    bool load(const std::string &filename);
+    bool save(const std::string &filename) const;
+
+private:
+    long long m_fileSize;
+    long long m_modificationTime;
+    std::vector<PunchIndexEntry> m_entries;
+};
+
+#endif // PUNCH_INDEX_H
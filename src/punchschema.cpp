@@ -0,0 +1,301 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "punchschema.h"
+
+#include <cstddef>
+#include <cstring>
+
+/*! \class PunchSchema
+ *  \brief The registry of the known result types of the Punch file.
+ *
+ * The result type of a block is given by its '$' title lines, that don't
+ * contain '=': the result title (like \a $DISPLACEMENTS or
+ * \a $ELEMENT \a FORCES), the output format (\a $REAL \a OUTPUT,
+ * \a $REAL-IMAGINARY \a OUTPUT or \a $MAGNITUDE-PHASE \a OUTPUT),
+ * and for the element results, the header \a $ELEMENT \a TYPE.
+ *
+ * The registry is a constant table built at compile time. The consistency of
+ * each schema (number of columns versus number of lines) is checked by the
+ * compiler.
+ *
+ * A schema gives the names of the columns, that can replace the 'unknown'
+ * column headers, and their types, so the typed mode decodes each field
+ * directly with the right parser. The blocks of unknown result types are
+ * parsed by the generic path.
+ *
+ * \subsection sec-complex Complex Results
+ *
+ * The complex results are written with the real parts (or the magnitudes)
+ * first, then the imaginary parts (or the phases), each on its own lines.
+ *
+ * Each complex schema has an \e interleaved variant, where the two parts of
+ * each value are adjacent columns (see \a ComplexConverter).
+ */
+
+/* Column types */
+static constexpr PunchValue::Type s_gridTypes[] = {
+    PunchValue::Text,
+    PunchValue::Real, PunchValue::Real, PunchValue::Real,
+    PunchValue::Real, PunchValue::Real, PunchValue::Real,
+    PunchValue::Real, PunchValue::Real, PunchValue::Real,
+    PunchValue::Real, PunchValue::Real, PunchValue::Real
+};
+
+static constexpr PunchValue::Type s_elementTypes[] = {
+    PunchValue::Integer,
+    PunchValue::Real, PunchValue::Real, PunchValue::Real,
+    PunchValue::Real, PunchValue::Real, PunchValue::Real,
+    PunchValue::Real, PunchValue::Real, PunchValue::Real,
+    PunchValue::Real, PunchValue::Real, PunchValue::Real
+};
+
+/* Column names */
+static constexpr const char* s_gridReal[] = {
+    "POINT ID", "T1", "T2", "T3", "R1", "R2", "R3"
+};
+
+static constexpr const char* s_gridRealImaginary[] = {
+    "POINT ID",
+    "T1 REAL", "T2 REAL", "T3 REAL", "R1 REAL", "R2 REAL", "R3 REAL",
+    "T1 IMAG", "T2 IMAG", "T3 IMAG", "R1 IMAG", "R2 IMAG", "R3 IMAG"
+};
+
+static constexpr const char* s_gridMagnitudePhase[] = {
+    "POINT ID",
+    "T1 MAG", "T2 MAG", "T3 MAG", "R1 MAG", "R2 MAG", "R3 MAG",
+    "T1 PHASE", "T2 PHASE", "T3 PHASE", "R1 PHASE", "R2 PHASE", "R3 PHASE"
+};
+
+static constexpr const char* s_gridRealImaginaryPairs[] = {
+    "POINT ID",
+    "T1 REAL", "T1 IMAG", "T2 REAL", "T2 IMAG", "T3 REAL", "T3 IMAG",
+    "R1 REAL", "R1 IMAG", "R2 REAL", "R2 IMAG", "R3 REAL", "R3 IMAG"
+};
+
+static constexpr const char* s_gridMagnitudePhasePairs[] = {
+    "POINT ID",
+    "T1 MAG", "T1 PHASE", "T2 MAG", "T2 PHASE", "T3 MAG", "T3 PHASE",
+    "R1 MAG", "R1 PHASE", "R2 MAG", "R2 PHASE", "R3 MAG", "R3 PHASE"
+};
+
+static constexpr const char* s_bushForces[] = {
+    "ELEMENT ID", "FX", "FY", "FZ", "MX", "MY", "MZ"
+};
+
+static constexpr const char* s_bushForcesRealImaginary[] = {
+    "ELEMENT ID",
+    "FX REAL", "FY REAL", "FZ REAL", "MX REAL", "MY REAL", "MZ REAL",
+    "FX IMAG", "FY IMAG", "FZ IMAG", "MX IMAG", "MY IMAG", "MZ IMAG"
+};
+
+static constexpr const char* s_bushForcesRealImaginaryPairs[] = {
+    "ELEMENT ID",
+    "FX REAL", "FX IMAG", "FY REAL", "FY IMAG", "FZ REAL", "FZ IMAG",
+    "MX REAL", "MX IMAG", "MY REAL", "MY IMAG", "MZ REAL", "MZ IMAG"
+};
+
+static constexpr const char* s_bushForcesMagnitudePhase[] = {
+    "ELEMENT ID",
+    "FX MAG", "FY MAG", "FZ MAG", "MX MAG", "MY MAG", "MZ MAG",
+    "FX PHASE", "FY PHASE", "FZ PHASE", "MX PHASE", "MY PHASE", "MZ PHASE"
+};
+
+static constexpr const char* s_bushForcesMagnitudePhasePairs[] = {
+    "ELEMENT ID",
+    "FX MAG", "FX PHASE", "FY MAG", "FY PHASE", "FZ MAG", "FZ PHASE",
+    "MX MAG", "MX PHASE", "MY MAG", "MY PHASE", "MZ MAG", "MZ PHASE"
+};
+
+static constexpr const char* s_bushStresses[] = {
+    "ELEMENT ID", "TX", "TY", "TZ", "RX", "RY", "RZ"
+};
+
+static constexpr const char* s_barForces[] = {
+    "ELEMENT ID", "BM1A", "BM2A", "BM1B", "BM2B", "TS1", "TS2", "AF", "TRQ"
+};
+
+static constexpr const char* s_rodForces[] = {
+    "ELEMENT ID", "AXIAL FORCE", "TORQUE"
+};
+
+static constexpr const char* s_springForces[] = {
+    "ELEMENT ID", "FORCE"
+};
+
+static constexpr const char* s_springForcesRealImaginary[] = {
+    "ELEMENT ID", "FORCE REAL", "FORCE IMAG"
+};
+
+static constexpr const char* s_springForcesMagnitudePhase[] = {
+    "ELEMENT ID", "FORCE MAG", "FORCE PHASE"
+};
+
+static constexpr const char* s_springStresses[] = {
+    "ELEMENT ID", "STRESS"
+};
+
+static constexpr const char* s_springStrains[] = {
+    "ELEMENT ID", "STRAIN"
+};
+
+/* Number of columns of the given names */
+template <std::size_t N>
+static constexpr int columnCountOf(const char* const (&)[N])
+{
+    return static_cast<int>(N);
+}
+
+/* Number of lines of a row of the given number of columns */
+static constexpr int lineCountOf(const int columnCount)
+{
+    return columnCount <= 4 ? 1 : 1 + (columnCount - 4 + 2) / 3;
+}
+
+#define C_SCHEMA(RESULT, ELEMENT_TYPE, FORMAT, INTERLEAVED, COLUMNS, TYPES)          \
+    { RESULT, ELEMENT_TYPE, PunchSchema::FORMAT, INTERLEAVED,                       \
+      lineCountOf(columnCountOf(COLUMNS)), columnCountOf(COLUMNS), COLUMNS, TYPES }
+
+#define C_COMPLEX_SCHEMAS(RESULT, ELEMENT_TYPE, RI, RI_PAIRS, MP, MP_PAIRS, TYPES)    \
+    C_SCHEMA(RESULT, ELEMENT_TYPE, RealImaginary, false, RI, TYPES),                  \
+    C_SCHEMA(RESULT, ELEMENT_TYPE, RealImaginary, true, RI_PAIRS, TYPES),             \
+    C_SCHEMA(RESULT, ELEMENT_TYPE, MagnitudePhase, false, MP, TYPES),                 \
+    C_SCHEMA(RESULT, ELEMENT_TYPE, MagnitudePhase, true, MP_PAIRS, TYPES)
+
+#define C_GRID_SCHEMAS(RESULT)                                                      \
+    C_SCHEMA(RESULT, 0, Real, false, s_gridReal, s_gridTypes),                      \
+    C_COMPLEX_SCHEMAS(RESULT, 0, s_gridRealImaginary, s_gridRealImaginaryPairs,     \
+                      s_gridMagnitudePhase, s_gridMagnitudePhasePairs, s_gridTypes)
+
+#define C_SPRING_FORCES_SCHEMAS(ELEMENT_TYPE)                                       \
+    C_SCHEMA("ELEMENT FORCES", ELEMENT_TYPE, Real, false, s_springForces, s_elementTypes), \
+    C_COMPLEX_SCHEMAS("ELEMENT FORCES", ELEMENT_TYPE,                               \
+                      s_springForcesRealImaginary, s_springForcesRealImaginary,     \
+                      s_springForcesMagnitudePhase, s_springForcesMagnitudePhase,   \
+                      s_elementTypes)
+
+static constexpr PunchSchema s_schemas[] = {
+    C_GRID_SCHEMAS("DISPLACEMENTS"),
+    C_GRID_SCHEMAS("VELOCITY"),
+    C_GRID_SCHEMAS("ACCELERATION"),
+    C_GRID_SCHEMAS("SPCF"),
+    C_GRID_SCHEMAS("MPCF"),
+    C_GRID_SCHEMAS("OLOADS"),
+    C_GRID_SCHEMAS("EIGENVECTOR"),
+
+    C_SCHEMA("ELEMENT FORCES",   1, Real, false, s_rodForces, s_elementTypes),  /* ROD */
+    C_SCHEMA("ELEMENT FORCES",   3, Real, false, s_rodForces, s_elementTypes),  /* TUBE */
+    C_SCHEMA("ELEMENT FORCES",  10, Real, false, s_rodForces, s_elementTypes),  /* CONROD */
+    C_SPRING_FORCES_SCHEMAS(11),                                                /* ELAS1 */
+    C_SPRING_FORCES_SCHEMAS(12),                                                /* ELAS2 */
+    C_SPRING_FORCES_SCHEMAS(13),                                                /* ELAS3 */
+    C_SPRING_FORCES_SCHEMAS(14),                                                /* ELAS4 */
+    C_SCHEMA("ELEMENT FORCES",  34, Real, false, s_barForces, s_elementTypes),  /* BAR */
+    C_SCHEMA("ELEMENT FORCES", 102, Real, false, s_bushForces, s_elementTypes), /* BUSH */
+    C_COMPLEX_SCHEMAS("ELEMENT FORCES", 102,
+                      s_bushForcesRealImaginary, s_bushForcesRealImaginaryPairs,
+                      s_bushForcesMagnitudePhase, s_bushForcesMagnitudePhasePairs,
+                      s_elementTypes),
+
+    C_SCHEMA("ELEMENT STRESSES", 11, Real, false, s_springStresses, s_elementTypes),
+    C_SCHEMA("ELEMENT STRESSES", 12, Real, false, s_springStresses, s_elementTypes),
+    C_SCHEMA("ELEMENT STRESSES", 13, Real, false, s_springStresses, s_elementTypes),
+    C_SCHEMA("ELEMENT STRESSES", 102, Real, false, s_bushStresses, s_elementTypes),
+
+    C_SCHEMA("ELEMENT STRAINS",  11, Real, false, s_springStrains, s_elementTypes),
+    C_SCHEMA("ELEMENT STRAINS",  12, Real, false, s_springStrains, s_elementTypes),
+    C_SCHEMA("ELEMENT STRAINS",  13, Real, false, s_springStrains, s_elementTypes),
+    C_SCHEMA("ELEMENT STRAINS", 102, Real, false, s_bushStresses, s_elementTypes)
+};
+
+#undef C_SPRING_FORCES_SCHEMAS
+#undef C_GRID_SCHEMAS
+#undef C_COMPLEX_SCHEMAS
+#undef C_SCHEMA
+
+static constexpr int s_schemaCount = sizeof(s_schemas) / sizeof(s_schemas[0]);
+
+/* Checks that the columns fill the lines of a row, and have a type */
+static constexpr bool isConsistent(const PunchSchema *schema, const int count)
+{
+    return count == 0
+            || (schema->columnCount <= 4 + 3 * (schema->lineCount - 1)
+                && schema->columnCount > 4 + 3 * (schema->lineCount - 2)
+                && schema->columnCount <= columnCountOf(s_gridRealImaginary)
+                && isConsistent(schema + 1, count - 1));
+}
+
+static_assert(isConsistent(s_schemas, s_schemaCount),
+              "The columns of a schema don't match its number of lines.");
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns the schema of the given \a result title, \a format
+ * and \a elementType (0 for the grid point results), or 0 if unknown.
+ * For the complex formats, \a interleaved selects the interleaved variant.
+ */
+const PunchSchema* PunchSchema::find(const std::string &result,
+                                     const Format format,
+                                     const int elementType,
+                                     const bool interleaved)
+{
+    for (int i = 0; i < s_schemaCount; ++i) {
+        const PunchSchema &schema = s_schemas[i];
+        if (schema.format == format
+                && schema.interleaved == interleaved
+                && schema.elementType == elementType
+                && std::strcmp(schema.result, result.c_str()) == 0) {
+            return &schema;
+        }
+    }
+    return 0;
+}
+
+/*! \brief Decodes the output format from the given '$' \a title line
+ * (without the dollar), like \a REAL-IMAGINARY \a OUTPUT.
+ * Returns \a false if the title isn't an output format.
+ */
+bool PunchSchema::parseFormat(const std::string &title, Format *format)
+{
+    if (title == "REAL OUTPUT") {
+        *format = Real;
+    } else if (title == "REAL-IMAGINARY OUTPUT") {
+        *format = RealImaginary;
+    } else if (title == "MAGNITUDE-PHASE OUTPUT") {
+        *format = MagnitudePhase;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns the number of schemas in the registry.
+ */
+int PunchSchema::count()
+{
+    return s_schemaCount;
+}
+
+/*! \brief Returns the schema at the given \a index of the registry.
+ */
+const PunchSchema* PunchSchema::at(const int index)
+{
+    if (index < 0 || index >= s_schemaCount) {
+        return 0;
+    }
+    return &s_schemas[index];
+}
@@ -0,0 +1,56 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PUNCH_SCHEMA_H
+#define PUNCH_SCHEMA_H
+
+#include "punchfile.h"
+
+#include <string>
+
+/*!
+ * PunchSchema
+ *
+ * The layout of a known result type of the Punch file:
+ * the names and the types of its columns, and the number of lines of a row
+ * (the first line and its -CONT- continuations).
+ */
+struct PunchSchema
+{
+    enum Format {
+        Real,
+        RealImaginary,
+        MagnitudePhase
+    };
+
+    const char *result;             /* Result title, like "DISPLACEMENTS" */
+    int elementType;                /* Nastran element type, or 0 for the grid point results */
+    Format format;
+    bool interleaved;               /* Complex: the parts of each value are adjacent columns */
+    int lineCount;
+    int columnCount;
+    const char *const *columns;
+    const PunchValue::Type *types;
+
+    static const PunchSchema* find(const std::string &result,
+                                   const Format format,
+                                   const int elementType,
+                                   const bool interleaved = false);
+    static bool parseFormat(const std::string &title, Format *format);
+    static int count();
+    static const PunchSchema* at(const int index);
+};
+
+#endif // PUNCH_SCHEMA_H
@@ -15,7 +15,17 @@
  */
 #include "reader.h"
 
+#include "inputpipeline.h"
+#include "numberparser.h"
+#include "recordscanner.h"
+
+#include <algorithm>
 #include <assert.h>
+#include <condition_variable>
+#include <cstdlib>  // atoi()
+#include <cstring>  // memchr(), strchr()
+#include <mutex>
+#include <thread>
 
 using namespace std;
 
@@ -23,223 +33,1008 @@ using namespace std;
  *  \brief The class Reader is a parser for PUNCH format streams.
  *
  * The Reader stores the data into a \a PunchFile.
- * Use \a parsePUNCH() to parse a stream.
+ * Use \a parsePUNCH() to parse a stream, or a range of bytes in memory
+ * (typically a \a MappedFile).
+ *
+ * Alternatively, the Reader can push each \a PunchBlock to a handler,
+ * as soon as the last row of the block is read. Only the current block
+ * is kept in memory, so the memory doesn't grow with the input size.
+ *
+ * \code
+ * // std::ifstream ifs;
+ * // std::ofstream ofs;
+ * Reader reader;
+ * Writer writer;
+ * reader.parsePUNCH(&ifs, std::bind(&Writer::writeCSV, &writer, std::placeholders::_1, &ofs));
+ * \endcode
+ *
+ * The lines are tokenized in place: the fields are only views
+ * (\a PunchField) on the input bytes, and they are copied only
+ * when stored in the \a PunchBlock.
+ *
+ * The lines are classified by the \a RecordScanner. When parsing
+ * bytes in memory, the lines are scanned by batches.
  *
- * To check the errors after the parsing, use \a getWarnings().
+ * In typed mode (see \a setTyped()), the fields are decoded by the
+ * \a NumberParser into integers and real numbers.
+ *
+ * To check the errors after the parsing, use \a getWarnings(),
+ * or \a diagnostics() for the counters of each category.
  *
  */
 /*! \brief Constructor.
  */
 Reader::Reader()
+    : m_threadCount(1)
+    , m_typed(false)
+    , m_complexMode(ComplexConverter::Mode::None)
+    , m_originOffset(0)
+    , m_originLine(0)
+    , m_hasCurrentBlock(false)
+    , m_rejected(false)
+    , m_rowRejected(false)
+    , m_isHeaderSection(false)
+    , m_lazy(false)
+    , m_rowFieldCount(0)
+    , m_rowColumnCount(0)
+    , m_blockRowCount(0)
+    , m_blockColumnCount(0)
+    , m_base(0)
+    , m_baseOffset(0)
+    , m_lineOffset(0)
+    , m_resultFormat(PunchSchema::Real)
+    , m_elementType(0)
+    , m_schema(0)
+    , m_decode(false)
 {
-    m_warningMessages.reserve(C_ERROR_MESSAGES_SIZE);
 }
 
 /******************************************************************************
  ******************************************************************************/
-std::vector<string> Reader::getWarnings() const
+int Reader::threadCount() const
 {
-    return m_warningMessages;
+    return m_threadCount;
 }
 
+/*! \brief Sets the number of threads used to parse bytes in memory.
+ *
+ * If \a count is greater than 1, large inputs are cut into ranges of bytes
+ * that start on a '$' header section. The ranges are parsed in parallel,
+ * and the blocks are pushed to the handler in the file order.
+ *
+ * The result, including the warnings, is the same as a serial parse.
+ *
+ * By default, the parsing is serial (1 thread).
+ */
+void Reader::setThreadCount(const int count)
+{
+    m_threadCount = count > 1 ? count : 1;
+}
 
 /******************************************************************************
  ******************************************************************************/
-void Reader::warn(const int lineCounter, const std::string &message)
+bool Reader::isTyped() const
 {
-    if (m_warningMessages.size() == C_ERROR_MESSAGES_SIZE) {
-        std::string limitMsg("[Warning] Too many errors...");
-        m_warningMessages.push_back( limitMsg );
-    }
-    if (m_warningMessages.size() >= C_ERROR_MESSAGES_SIZE) {
-        return;
-    }
+    return m_typed;
+}
 
-    std::string msg("[Warning] line "
-                    + std::to_string(lineCounter)
-                    + ": "
-                    + message);
-    m_warningMessages.push_back(msg);
+/*! \brief Enables the typed mode.
+ *
+ * In typed mode, the fields are decoded into integers and real numbers
+ * (\a PunchValue) while parsing. The fields that can't be decoded
+ * are kept as text.
+ *
+ * By default, the fields are stored as strings.
+ */
+void Reader::setTyped(const bool typed)
+{
+    m_typed = typed;
 }
 
 /******************************************************************************
  ******************************************************************************/
+ComplexConverter::Mode Reader::complexMode() const
+{
+    return m_complexMode;
+}
 
-static inline std::string trim_right(const std::string &str, const std::string &delimiters)
+/*! \brief Sets the conversion of the complex results.
+ *
+ * If the \a mode isn't None, the blocks of the known complex result types
+ * (see \a PunchSchema) are decoded, and their values are interleaved into
+ * pairs, and possibly converted, by the \a ComplexConverter.
+ *
+ * By default, the blocks are kept as read.
+ */
+void Reader::setComplexMode(const ComplexConverter::Mode mode)
 {
-    auto strEnd = str.find_last_not_of(delimiters);
-    auto strRange = strEnd + 1;
-    return str.substr(0, strRange);
+    m_complexMode = mode;
 }
 
-static inline std::string trim_left(const std::string &str, const std::string &delimiters)
+/******************************************************************************
+ ******************************************************************************/
+const BlockFilter& Reader::filter() const
 {
-    auto strBegin = str.find_first_not_of(delimiters);
-    if (strBegin == std::string::npos) {
-        return string();  /* no content */
-    }
-    auto strEnd = str.length();
-    auto strRange = strEnd - strBegin + 1;
-    return str.substr(strBegin, strRange);
+    return m_filter;
 }
 
-static inline std::string trim(const std::string &str, const std::string &delimiters)
+/*! \brief Sets the \a filter of the blocks.
+ *
+ * The filter is evaluated as soon as the header section of a block ends.
+ * The rows of the rejected blocks are skipped without being tokenized,
+ * and the rejected blocks aren't pushed to the handler.
+ *
+ * By default, the filter is empty: all the blocks are accepted.
+ */
+void Reader::setFilter(const BlockFilter &filter)
 {
-    return trim_left( trim_right( str, delimiters ), delimiters );
+    m_filter = filter;
 }
 
 /******************************************************************************
  ******************************************************************************/
-static inline bool startsWith(const std::string &text, const std::string &start)
+std::size_t Reader::originOffset() const
+{
+    return m_originOffset;
+}
+
+int Reader::originLine() const
 {
-    if (text.length() == 0 || start.length() == 0 || start.length() > text.length() )
-        return false;
-    auto p = text.begin();
-    auto q = start.begin();
-    while ( q != start.end() ) {
-        if ((*p) != (*q))
-            return false;
-        p++;
-        q++;
+    return m_originLine;
+}
+
+/*! \brief Sets the position of the input in its file: the \a offset
+ * (in bytes) of its first byte, and the number of lines before it.
+ *
+ * The source positions of the blocks and the diagnostics are shifted
+ * accordingly. It's used to parse the end of a file, that grows
+ * while it's read (see \a lastBlockStart()).
+ *
+ * By default, the input is the whole file (0, 0).
+ */
+void Reader::setOrigin(const std::size_t offset, const int line)
+{
+    m_originOffset = offset;
+    m_originLine = line;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns the messages of the first C_ERROR_MESSAGES_SIZE warnings.
+ * If there are more warnings, the last message gives their total.
+ */
+std::vector<string> Reader::getWarnings() const
+{
+    const int count = std::min(m_diagnostics.recordCount(), C_ERROR_MESSAGES_SIZE);
+    std::vector<string> messages;
+    messages.reserve(count + 1);
+    for (int i = 0; i < count; ++i) {
+        messages.push_back( Diagnostics::format(m_diagnostics.at(i)) );
     }
-    return true;
+    if (m_diagnostics.count() > C_ERROR_MESSAGES_SIZE) {
+        std::string limitMsg("[Warning] Too many errors... ("
+                             + std::to_string(m_diagnostics.count())
+                             + " warnings in total)");
+        messages.push_back( limitMsg );
+    }
+    return messages;
+}
+
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns all the diagnostics of the parsing, with their counters.
+ */
+const Diagnostics& Reader::diagnostics() const
+{
+    return m_diagnostics;
+}
+
+/*! \internal
+ * Reports a diagnostic at the current line. The message isn't formatted here.
+ */
+void Reader::warn(const int lineCounter, const Diagnostic::Category category)
+{
+    m_diagnostics.report(category, lineCounter, m_lineOffset);
 }
 
 /******************************************************************************
  ******************************************************************************/
-static void trimRightRow(PunchRow * const row)
+
+static inline bool isDelimiter(const char c, const char *delimiters)
 {
-    if (!row) return;
-    int i = row->size();
-    while (i>0) {
-        i--;
-        if ( row->at(i) != "" ) return;
-        row->pop_back();
+    return c != '\0' && std::strchr(delimiters, c) != 0;
+}
+
+/*! \brief Returns the given \a field without the leading and trailing \a delimiters.
+ */
+static inline PunchField trim(const PunchField &field, const char *delimiters)
+{
+    const char *begin = field.data;
+    const char *end = field.data + field.size;
+    while (begin != end && isDelimiter(*begin, delimiters)) {
+        ++begin;
     }
+    while (end != begin && isDelimiter(*(end - 1), delimiters)) {
+        --end;
+    }
+    PunchField ret = { begin, static_cast<std::size_t>(end - begin) };
+    return ret;
 }
 
 /******************************************************************************
  ******************************************************************************/
-/*! \brief Remove all the ending CR, LF or CR+LF in the given \a line.
+/*! \brief Returns the length of the given \a line without the ending CR, LF or CR+LF.
  */
-static inline void removeLineCarriage(std::string *line)
+static inline std::size_t removeLineCarriage(const char *line, std::size_t length)
 {
-    auto p = line->end() - 1;
-    while ( (*p) == '\r' || (*p) == '\n' ) {
-        line->pop_back();
-        p = line->end() - 1;
+    while ( length > 0 && (line[length - 1] == '\r' || line[length - 1] == '\n') ) {
+        --length;
     }
+    return length;
 }
 
 /******************************************************************************
  ******************************************************************************/
 PunchFile Reader::parsePUNCH(std::istream * const idevice)
 {
-    assert(idevice);
+    PunchFile pch;
+    parsePUNCH(idevice, [&pch](PunchBlock &block) { pch.append( block ); });
+    return pch;
+}
 
+/*! \brief Parses the bytes in the range [\a begin, \a end).
+ *
+ * The bytes are typically the content of a \a MappedFile.
+ * The result is the same as parsing a stream with the same content.
+ */
+PunchFile Reader::parsePUNCH(const char *begin, const char *end)
+{
     PunchFile pch;
+    parsePUNCH(begin, end, [&pch](PunchBlock &block) { pch.append( block ); });
+    return pch;
+}
 
-    std::list<PunchBlock> blocks;
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Parses the stream \a idevice, and calls \a handler for each block.
+ *
+ * The stream is read by an \a InputPipeline: a dedicated I/O thread fills
+ * large buffers, while the previous buffer is parsed.
+ */
+void Reader::parsePUNCH(std::istream * const idevice, const PunchBlockHandler &handler)
+{
+    assert(idevice);
 
-    PunchRow currentRow;
+    beginParse(handler);
 
-    PunchBlock *currentblock = 0;
-    bool isHeaderSection = false;
+    InputPipeline pipeline(idevice);
+    const char *data;
+    std::size_t size;
+    std::size_t position = m_originOffset;  /* Offset of the buffer in the stream */
+    std::string pending;                    /* Line that straddles two buffers */
+    std::size_t pendingOffset = 0;
+    int lineCounter = m_originLine;
 
-    int lineCounter = 0;
-    string line;
-    while( std::getline((*idevice), line) ) {
+    while (pipeline.next(&data, &size)) {
+        const char *p = data;
+        const char *end = data + size;
 
-        ++lineCounter;
-        removeLineCarriage( &line );
+        /* End the pending line */
+        if (!pending.empty()) {
+            const char *eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            if (!eol) {
+                pending.append(p, end);
+                position += size;
+                continue;
+            }
+            pending.append(p, eol + 1);
+            m_base = pending.data();
+            m_baseOffset = pendingOffset;
+            lineCounter = parseRange(pending.data(), pending.data() + pending.size(), lineCounter);
+            pending.clear();
+            p = eol + 1;
+        }
 
-        if ( line.length() != 80 ) {
-            this->warn(lineCounter, "The line must be 80 characters long.");
-            continue;
+        /* The last line may continue in the next buffer */
+        const char *stop = end;
+        while (stop != p && stop[-1] != '\n') {
+            --stop;
         }
+        m_base = p;
+        m_baseOffset = position + (p - data);
+        lineCounter = parseRange(p, stop, lineCounter);
+        if (stop != end) {
+            pending.assign(stop, end);
+            pendingOffset = position + (stop - data);
+        }
+        position += size;
+    }
+    if (!pending.empty()) {
+        m_base = pending.data();
+        m_baseOffset = pendingOffset;
+        lineCounter = parseRange(pending.data(), pending.data() + pending.size(), lineCounter);
+    }
+    m_base = 0;
+    m_baseOffset = 0;
 
-        /* ********************* */
-        /* Dollarized Section    */
-        /* ********************* */
-        if( line.front() == '$' ){
+    endParse();
+}
 
-            /* Flush */
-            trimRightRow( &currentRow );
-            currentblock->append( currentRow );
-            currentRow = PunchRow();
+/*! \brief Parses the bytes in the range [\a begin, \a end),
+ * and calls \a handler for each block.
+ */
+void Reader::parsePUNCH(const char *begin, const char *end, const PunchBlockHandler &handler)
+{
+    assert(begin <= end);
 
-            if (!isHeaderSection) {
+    m_base = begin;
+    m_baseOffset = m_originOffset;
 
-                blocks.push_back( PunchBlock() );
-                currentblock = &(blocks.back());
+    if (m_threadCount > 1 && end - begin >= 2 * C_CHUNK_SIZE) {
+        parseParallel(begin, end, handler);
+        return;
+    }
 
-                isHeaderSection = true;
+    beginParse(handler);
+    parseRange(begin, end, m_originLine);
+    endParse();
+}
+
+/*! \brief Parses the bytes in the range [\a begin, \a end), using the
+ * given \a index of the blocks, and calls \a handler for each block.
+ *
+ * The \a index must be consistent with the bytes (see \a PunchIndex::isConsistent()).
+ * When parsing in parallel, the input is cut at the ranges of the blocks
+ * recorded in the index, rather than scanned for the start of the chunks.
+ */
+void Reader::parsePUNCH(const char *begin, const char *end, const PunchIndex &index,
+                        const PunchBlockHandler &handler)
+{
+    assert(begin <= end);
+    assert(index.isConsistent(begin, end));
+
+    m_base = begin;
+    m_baseOffset = m_originOffset;
+
+    if (m_threadCount > 1 && end - begin >= 2 * C_CHUNK_SIZE) {
+        const std::size_t chunkSize = std::max<std::size_t>(C_CHUNK_SIZE, (end - begin) / (8 * m_threadCount));
+        std::vector<const char*> bounds;
+        bounds.push_back(begin);
+        for (int i = 0; i < index.count(); ++i) {
+            if (index.rangeEnd(i) - (bounds.back() - begin) >= chunkSize) {
+                bounds.push_back(begin + index.rangeEnd(i));
             }
+        }
+        if (bounds.back() != end) {
+            bounds.push_back(end);
+        }
+        parseChunks(bounds, handler);
+        return;
+    }
 
-            auto p_equal = line.find( '=' );
-            if (p_equal != string::npos ){
+    beginParse(handler);
+    parseRange(begin, end, m_originLine);
+    endParse();
+}
 
-                string key   = line.substr( 1, p_equal - 1);
-                string value = line.substr(p_equal + 1, 80 - 9 - (p_equal + 1));
+/******************************************************************************
+ ******************************************************************************/
+PunchFile Reader::scanPUNCH(const char *begin, const char *end)
+{
+    PunchFile pch;
+    scanPUNCH(begin, end, [&pch](PunchBlock &block) { pch.append( block ); });
+    return pch;
+}
+
+/*! \brief Scans the bytes in the range [\a begin, \a end), and calls
+ * \a handler for each block.
+ *
+ * The blocks are lazy: they have their header, their numbers of rows and
+ * columns, but the fields aren't tokenized nor copied. The rows of a block
+ * are parsed from its range of bytes when they are accessed, with the
+ * options of the Reader. Hence the bytes must remain valid while the rows
+ * can be accessed.
+ *
+ * The warnings are the same as \a parsePUNCH().
+ */
+void Reader::scanPUNCH(const char *begin, const char *end, const PunchBlockHandler &handler)
+{
+    m_lazy = true;
+    parsePUNCH(begin, end, handler);
+    m_lazy = false;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \internal
+ * Parses the lines in the range [\a begin, \a end).
+ * The first line is numbered \a lineCounter + 1.
+ * Returns the number of the last line.
+ *
+ * The offset of a line in the input is its distance to \a m_base,
+ * plus \a m_baseOffset.
+ */
+int Reader::parseRange(const char *begin, const char *end, int lineCounter)
+{
+    /* The lines are scanned by batches of C_SCAN_BATCH_SIZE records */
+    const char *lines[C_SCAN_BATCH_SIZE];
+    std::size_t lengths[C_SCAN_BATCH_SIZE];
+    const char *records[C_SCAN_BATCH_SIZE];
+    PunchRecord scanned[C_SCAN_BATCH_SIZE];
 
-                string key_trimmed   = trim(key, " \t");
-                string value_trimmed = trim(value, " \t" );
+    const char *p = begin;
+    while (p < end) {
 
-                currentblock->insertPrefix(key_trimmed, value_trimmed);
+        int count = 0;
+        int recordCount = 0;
+        while (p < end && count < C_SCAN_BATCH_SIZE) {
+            const char *eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            const char *next = eol ? eol + 1 : end;
+            if (!eol) {
+                eol = end;
             }
-            continue;
+            lines[count] = p;
+            lengths[count] = removeLineCarriage(p, eol - p);
+            if (lengths[count] == C_RECORD_LENGTH) {
+                records[recordCount++] = p;
+            }
+            ++count;
+            p = next;
         }
-        isHeaderSection = false;
 
-        /* ********************* */
-        /* Data Block Section    */
-        /* ********************* */
-        if (!currentblock) {
-            this->warn(lineCounter, "A header ('$' section) should prepend the data.");
+        RecordScanner::scan(records, recordCount, scanned);
 
-            blocks.push_back( PunchBlock() );
-            currentblock = &(blocks.back());
+        const PunchRecord *record = scanned;
+        for (int i = 0; i < count; ++i) {
+            ++lineCounter;
+            m_lineOffset = m_baseOffset + (lines[i] - m_base);
+            if (lengths[i] != C_RECORD_LENGTH) {
+                this->warn(lineCounter, Diagnostic::LineLength);
+                continue;
+            }
+            parseRecord(lineCounter, lines[i], *record);
+            ++record;
         }
+    }
+    m_lineOffset = m_baseOffset + (end - m_base);
+    return lineCounter;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+static inline const char* nextLine(const char *p, const char *end)
+{
+    const char *eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return eol ? eol + 1 : end;
+}
 
-        /* Fields are 18 char-long */
-        std::vector<std::string> fields;
-        for(int i = 0; i < 4; ++i) {
-            auto f= line.substr(i*18, 18);
-            f = trim( f, " \t\r\n" );
-            fields.push_back( f );
+static inline bool isRecord(const char *line, const char *end)
+{
+    const char *eol = static_cast<const char*>(std::memchr(line, '\n', end - line));
+    return removeLineCarriage(line, (eol ? eol : end) - line) == C_RECORD_LENGTH;
+}
+
+/*! \internal
+ * Returns the start of the first line after \a p, that can start a range
+ * parsed independently: a valid '$' header record, that follows a valid
+ * record that isn't a header. Returns \a end if no such line exists.
+ *
+ * At such line, the serial parser has no pending header section,
+ * and it flushes the current row and the current block. Hence the range
+ * can be parsed by a new Reader, and gives the same blocks.
+ */
+static const char* findChunkStart(const char *p, const char *begin, const char *end)
+{
+    const char *previous = p;
+    while (previous > begin && previous[-1] != '\n') {
+        --previous;
+    }
+    const char *line = nextLine(previous, end);
+    while (line < end) {
+        if (line[0] == '$' && previous[0] != '$'
+                && isRecord(previous, end) && isRecord(line, end)) {
+            return line;
         }
+        previous = line;
+        line = nextLine(line, end);
+    }
+    return end;
+}
+
+/*! \brief Returns the start of the last line in [\a from, \a end) that
+ * starts a new block, and that follows complete blocks: [\a begin, line)
+ * can be parsed and gives the same blocks as the whole input.
+ * Returns \a begin if no such line exists.
+ *
+ * It's used to parse a file while it's written: the blocks before the
+ * returned line are complete. Only the lines from the line of \a from
+ * are searched, hence a growing input is searched once.
+ */
+const char* Reader::lastBlockStart(const char *from, const char *begin, const char *end)
+{
+    assert(begin <= from && from <= end);
+    const char *last = begin;
+    const char *p = from;
+    while ((p = findChunkStart(p, begin, end)) < end) {
+        last = p;
+    }
+    return last;
+}
+
+/*! \internal
+ * Parses the range [\a begin, \a end) on m_threadCount threads.
+ */
+void Reader::parseParallel(const char *begin, const char *end, const PunchBlockHandler &handler)
+{
+    /* Cut the input into chunks */
+    std::vector<const char*> bounds;
+    const std::size_t chunkSize = std::max<std::size_t>(C_CHUNK_SIZE, (end - begin) / (8 * m_threadCount));
+    const char *p = begin;
+    bounds.push_back(p);
+    while (p < end) {
+        p = (end - p > static_cast<std::ptrdiff_t>(2 * chunkSize))
+                ? findChunkStart(p + chunkSize, begin, end)
+                : end;
+        bounds.push_back(p);
+    }
+    parseChunks(bounds, handler);
+}
 
+namespace {
+struct Chunk
+{
+    const char *begin;
+    const char *end;
+    std::vector<PunchBlock> blocks;
+    Diagnostics diagnostics;
+    int lineCount;
+    bool done;
+};
+}
 
-        if( startsWith(fields[0], string("-CONT-")) ) {
-            if (currentRow.size() == 0) {
-                this->warn(lineCounter, "A continued -CONT- field shouldn't starts a new block.");
+/*! \internal
+ * Parses the contiguous chunks [\a bounds[i], \a bounds[i+1]) on m_threadCount threads.
+ *
+ * The chunks are parsed by a pool of threads, while the calling thread
+ * pushes the blocks of each chunk to the \a handler, in the file order.
+ * The line numbers of the diagnostics are shifted by the number of lines
+ * of the preceding chunks.
+ *
+ * At most 2 chunks per thread are kept in memory.
+ */
+void Reader::parseChunks(const std::vector<const char*> &bounds, const PunchBlockHandler &handler)
+{
+    std::vector<Chunk> chunks;
+    for (std::size_t i = 0; i + 1 < bounds.size(); ++i) {
+        Chunk chunk;
+        chunk.begin = bounds[i];
+        chunk.end = bounds[i + 1];
+        chunk.lineCount = 0;
+        chunk.done = false;
+        chunks.push_back(chunk);
+    }
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::size_t next = 0;
+    std::size_t emitted = 0;
+    const std::size_t maxInFlight = 2 * m_threadCount;
+
+    auto worker = [&]() {
+        while (true) {
+            std::size_t i;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [&]() {
+                    return next >= chunks.size() || next < emitted + maxInFlight;
+                });
+                if (next >= chunks.size()) {
+                    return;
+                }
+                i = next++;
             }
-            /* fields[0] isn't used. */
-            currentRow.push_back( fields[1] );
-            currentRow.push_back( fields[2] );
-            currentRow.push_back( fields[3] );
+            Chunk &chunk = chunks[i];
+            Reader reader;
+            reader.m_typed = m_typed;
+            reader.m_complexMode = m_complexMode;
+            reader.m_lazy = m_lazy;
+            reader.m_base = m_base;
+            reader.m_baseOffset = m_baseOffset;
+            reader.m_filter = m_filter;
+            reader.beginParse([&chunk](PunchBlock &block) {
+                chunk.blocks.push_back( std::move(block) );
+            });
+            chunk.lineCount = reader.parseRange(chunk.begin, chunk.end, 0);
+            reader.endParse();
+            chunk.diagnostics = std::move(reader.m_diagnostics);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                chunk.done = true;
+            }
+            condition.notify_all();
+        }
+    };
 
-        } else {
-            /* Flush */
-            trimRightRow( &currentRow );
-            currentblock->append( currentRow );
-            currentRow = PunchRow();
+    std::vector<std::thread> threads;
+    const std::size_t threadCount = std::min<std::size_t>(m_threadCount, chunks.size());
+    for (std::size_t t = 0; t < threadCount; ++t) {
+        threads.push_back( std::thread(worker) );
+    }
 
-            currentRow.push_back( fields[0] );
-            currentRow.push_back( fields[1] );
-            currentRow.push_back( fields[2] );
-            currentRow.push_back( fields[3] );
+    /* Stitch the chunks in the file order */
+    int lineOffset = m_originLine;
+    for (std::size_t i = 0; i < chunks.size(); ++i) {
+        Chunk &chunk = chunks[i];
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&chunk]() { return chunk.done; });
+        }
+        for (PunchBlock & block : chunk.blocks) {
+            block.setSource(block.sourceOffset(), block.sourceLine() + lineOffset);
+            if (handler) {
+                handler( block );
+            }
         }
+        m_diagnostics.merge(chunk.diagnostics, lineOffset);
+        lineOffset += chunk.lineCount;
+
+        std::vector<PunchBlock>().swap(chunk.blocks);
+        chunk.diagnostics = Diagnostics();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++emitted;
+        }
+        condition.notify_all();
+    }
+
+    for (std::thread & thread : threads) {
+        thread.join();
     }
+}
 
+/******************************************************************************
+ ******************************************************************************/
+void Reader::beginParse(const PunchBlockHandler &handler)
+{
+    m_handler = handler;
+    m_currentBlock = PunchBlock();
+    m_hasCurrentBlock = false;
+    m_rejected = false;
+    m_rowRejected = false;
+    m_currentValues.clear();
+    m_currentChars.clear();
+    m_isHeaderSection = false;
+    m_rowFieldCount = 0;
+    m_rowColumnCount = 0;
+    m_blockRowCount = 0;
+    m_blockColumnCount = 0;
+    m_lineOffset = 0;
+}
+
+void Reader::endParse()
+{
     /* Flush */
-    trimRightRow( &currentRow );
-    currentblock->append( currentRow );
+    flushRow();
+    flushBlock();
+    m_handler = PunchBlockHandler();
+}
 
-    for (PunchBlock & block : blocks) {
-        pch.append( block );
+void Reader::flushRow()
+{
+    if (m_lazy) {
+        /* The empty fields on the right are trimmed, and the empty rows skipped */
+        if (m_hasCurrentBlock && m_rowColumnCount > 0) {
+            if (m_blockRowCount == 0) {
+                m_blockColumnCount = m_rowColumnCount;
+            }
+            ++m_blockRowCount;
+        }
+        m_rowFieldCount = 0;
+        m_rowColumnCount = 0;
+        return;
     }
 
-    return pch;
+    /* Trim the empty fields on the right */
+    while (!m_currentValues.empty() && m_currentValues.back().type == PunchValue::Empty) {
+        m_currentValues.pop_back();
+    }
+    if (m_hasCurrentBlock) {
+        m_currentBlock.append( m_currentValues.data(), m_currentValues.size(), m_currentChars.data() );
+    }
+    m_currentValues.clear();
+    m_currentChars.clear();
+}
+
+/*! \internal
+ * Appends the given \a field to the current row.
+ * In typed mode, the field is decoded, using the schema if the result type
+ * is known, otherwise by trying the parsers in turn (generic path).
+ */
+void Reader::appendField(const PunchField &field)
+{
+    PunchValue value;
+    value.precision = 0;
+    value.size = 0;
+    value.integer = 0;
+    const char *begin = field.data;
+    const char *end = field.data + field.size;
+    int precision = 0;
+
+    /* The schema of a known result type gives the type of the column,
+     * so the field is decoded directly by the right parser. */
+    PunchValue::Type expected = PunchValue::Empty;
+    if (m_schema && static_cast<int>(m_currentValues.size()) < m_schema->columnCount) {
+        expected = m_schema->types[m_currentValues.size()];
+    }
+    const bool decode = m_decode && expected != PunchValue::Text;
+
+    if (field.empty()) {
+        value.type = PunchValue::Empty;
+    } else if (decode && expected == PunchValue::Real
+               && NumberParser::parseReal(begin, end, &value.real, &precision)) {
+        value.type = PunchValue::Real;
+        value.precision = static_cast<unsigned char>(precision);
+    } else if (decode && NumberParser::parseInteger(begin, end, &value.integer)) {
+        value.type = PunchValue::Integer;
+    } else if (decode && expected != PunchValue::Real
+               && NumberParser::parseReal(begin, end, &value.real, &precision)) {
+        value.type = PunchValue::Real;
+        value.precision = static_cast<unsigned char>(precision);
+    } else {
+        value.type = PunchValue::Text;
+        value.size = field.size;
+        value.text = m_currentChars.size();
+        m_currentChars.insert( m_currentChars.end(), begin, end );
+    }
+    m_currentValues.push_back( value );
 }
 
+/*! \internal
+ * Counts the fields of the given \a record, from the field \a first,
+ * as if they were appended to the current row.
+ */
+void Reader::countFields(const PunchRecord &record, const int first)
+{
+    for (int i = first; i < C_FIELD_COUNT; ++i) {
+        ++m_rowFieldCount;
+        if (record.fieldEnd[i] != record.fieldBegin[i]) {
+            m_rowColumnCount = m_rowFieldCount;
+        }
+    }
+}
+
+/*! \internal
+ * Pushes the current block (if any) to the handler.
+ *
+ * When scanning, the block is lazy: its rows will be parsed
+ * from its range of bytes, i.e. until the current line.
+ */
+void Reader::flushBlock()
+{
+    if (!m_hasCurrentBlock) {
+        return;
+    }
+
+    /* The blocks without accepted row are dropped too */
+    const bool emptied = m_filter.hasIds()
+            && (m_lazy ? m_blockRowCount == 0 : m_currentBlock.rowCount() == 0);
+    if (m_rejected || emptied) {
+        m_currentBlock.clear();
+        m_blockRowCount = 0;
+        m_blockColumnCount = 0;
+        m_hasCurrentBlock = false;
+        m_rejected = false;
+        return;
+    }
+
+    if (m_lazy) {
+        const char *base = m_base;
+        const std::size_t baseOffset = m_baseOffset;
+        const std::size_t offset = m_currentBlock.sourceOffset();
+        const char *blockBegin = m_base + (offset - m_baseOffset);
+        const char *blockEnd = m_base + (m_lineOffset - m_baseOffset);
+        const bool typed = m_typed;
+        const ComplexConverter::Mode complexMode = m_complexMode;
+        const BlockFilter rowFilter = m_filter.rowFilter();
+
+        m_currentBlock.setLoader([=]() {
+            PunchBlock loaded;
+            Reader reader;
+            reader.m_typed = typed;
+            reader.m_complexMode = complexMode;
+            reader.m_filter = rowFilter;
+            reader.m_base = base;
+            reader.m_baseOffset = baseOffset;
+            reader.beginParse([&loaded, offset](PunchBlock &block) {
+                if (block.sourceOffset() == offset) {
+                    loaded = std::move(block);
+                }
+            });
+            reader.parseRange(blockBegin, blockEnd, 0);
+            reader.endParse();
+            return loaded;
+        }, m_blockRowCount, m_blockColumnCount);
+        m_blockRowCount = 0;
+        m_blockColumnCount = 0;
+    } else {
+        ComplexConverter::convert( &m_currentBlock, m_complexMode );
+    }
+    /* The block is complete: its format doesn't change anymore */
+    m_currentBlock.updateFormat();
+
+    if (m_handler) {
+        m_handler( m_currentBlock );
+    }
+    m_currentBlock.clear();
+    m_hasCurrentBlock = false;
+}
+
+void Reader::newBlock(const int lineCounter)
+{
+    flushBlock();
+    m_hasCurrentBlock = true;
+    m_currentBlock.setSource(m_lineOffset, lineCounter);
+    m_resultTitle.clear();
+    m_resultFormat = PunchSchema::Real;
+    m_elementType = 0;
+    m_schema = 0;
+    m_decode = m_typed;
+    m_rowRejected = false;
+    /* A block without header section is filtered now */
+    m_rejected = !m_filter.isEmpty() && !m_filter.accepts(m_currentBlock, m_resultTitle);
+}
+
+/*! \internal
+ * Filters the current block, and selects its schema,
+ * at the end of its header section.
+ */
+void Reader::selectSchema()
+{
+    m_rejected = !m_filter.isEmpty() && !m_filter.accepts(m_currentBlock, m_resultTitle);
+    if (m_rejected) {
+        return;
+    }
+
+    m_schema = PunchSchema::find(m_resultTitle, m_resultFormat, m_elementType);
+    m_currentBlock.setSchema( m_schema );
+    if (m_lazy) {
+        /* The schema of the block, once loaded and converted */
+        const PunchSchema *target = ComplexConverter::targetSchema(m_schema, m_complexMode);
+        if (target) {
+            m_currentBlock.setSchema( target );
+        }
+        return;
+    }
+    if (m_schema) {
+        m_currentValues.reserve( m_schema->columnCount );
+    }
+
+    /* The complex results are decoded to be converted */
+    m_decode = m_typed
+            || (m_complexMode != ComplexConverter::Mode::None
+                && m_schema && m_schema->format != PunchSchema::Real);
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void Reader::parseRecord(const int lineCounter, const char *line, const PunchRecord &record)
+{
+    /* ********************* */
+    /* Dollarized Section    */
+    /* ********************* */
+    if( record.type == PunchRecord::Header ){
+
+        /* Flush */
+        flushRow();
+
+        if (!m_isHeaderSection) {
+
+            newBlock(lineCounter);
+
+            m_isHeaderSection = true;
+        }
+
+        if (record.equal >= 0) {
+            const char *p_equal = line + record.equal;
+
+            /* The value stops before the line number (columns 73-80) */
+            const char *valueBegin = p_equal + 1;
+            const char *valueEnd = (valueBegin <= line + 80 - 9) ? line + 80 - 9 : line + 80;
+
+            PunchField key   = { line + 1, static_cast<std::size_t>(p_equal - line - 1) };
+            PunchField value = { valueBegin, static_cast<std::size_t>(valueEnd - valueBegin) };
+
+            PunchField key_trimmed   = trim(key, " \t");
+            PunchField value_trimmed = trim(value, " \t");
+
+            m_currentBlock.insertPrefix(key_trimmed.toString(), value_trimmed.toString());
+
+            if (key_trimmed.toString() == "ELEMENT TYPE") {
+                m_elementType = std::atoi( value_trimmed.toString().c_str() );
+            }
+
+        } else {
+            /* Title of the result, or output format */
+            PunchField title = { line + 1, 80 - 9 };
+            std::string title_trimmed = trim(title, " \t").toString();
+
+            PunchSchema::Format format;
+            if (PunchSchema::parseFormat(title_trimmed, &format)) {
+                m_resultFormat = format;
+            } else {
+                m_resultTitle = title_trimmed;
+            }
+        }
+        return;
+    }
+    if (m_isHeaderSection) {
+        m_isHeaderSection = false;
+        selectSchema();
+    }
+
+    /* ********************* */
+    /* Data Block Section    */
+    /* ********************* */
+    if (!m_hasCurrentBlock) {
+        this->warn(lineCounter, Diagnostic::MissingHeader);
+
+        newBlock(lineCounter);
+    }
+
+    /* The rows of a rejected block are skipped */
+    if (m_rejected) {
+        return;
+    }
+
+    /* The rows of the rejected ids are skipped, with their continuations,
+     * without being tokenized */
+    if (m_filter.hasIds()) {
+        if (record.type != PunchRecord::Continuation) {
+            m_rowRejected = !m_filter.acceptsId(line + record.fieldBegin[0], line + record.fieldEnd[0]);
+        }
+        if (m_rowRejected) {
+            return;
+        }
+    }
+
+    /* Structural scan: the fields are only counted */
+    if (m_lazy) {
+        if (record.type == PunchRecord::Continuation) {
+            if (m_rowFieldCount == 0) {
+                this->warn(lineCounter, Diagnostic::OrphanContinuation);
+            }
+            countFields(record, 1);
+        } else {
+            flushRow();
+            countFields(record, 0);
+        }
+        return;
+    }
+
+    /* Fields are 18 char-long */
+    PunchField fields[C_FIELD_COUNT];
+    for(int i = 0; i < C_FIELD_COUNT; ++i) {
+        fields[i].data = line + record.fieldBegin[i];
+        fields[i].size = record.fieldEnd[i] - record.fieldBegin[i];
+    }
+
+    if( record.type == PunchRecord::Continuation ) {
+        if (m_currentValues.empty()) {
+            this->warn(lineCounter, Diagnostic::OrphanContinuation);
+        }
+        /* fields[0] isn't used. */
+        appendField( fields[1] );
+        appendField( fields[2] );
+        appendField( fields[3] );
+
+    } else {
+        /* Flush */
+        flushRow();
+
+        appendField( fields[0] );
+        appendField( fields[1] );
+        appendField( fields[2] );
+        appendField( fields[3] );
+    }
+}
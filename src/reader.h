@@ -16,10 +16,18 @@
 #ifndef READER_H
 #define READER_H
 
+#include "blockfilter.h"
+#include "complexconverter.h"
+#include "diagnostics.h"
 #include "punchfile.h"
+#include "punchindex.h"
+#include "punchschema.h"
 
+#include <cstddef>
+#include <functional>
 #include <istream>
 #include <string>
+#include <utility>
 #include <vector>
 
 /*!
@@ -27,24 +35,132 @@
  *
  * We define a maximum of messages to be shown,
  * in order to avoid too many messages.
+ * The diagnostics are all counted (see Reader::diagnostics()).
  */
 #define C_ERROR_MESSAGES_SIZE 100
 
+/*!
+ * C_SCAN_BATCH_SIZE
+ *
+ * Number of lines classified at once by the RecordScanner.
+ */
+#define C_SCAN_BATCH_SIZE 64
+
+/*!
+ * C_CHUNK_SIZE
+ *
+ * Minimal size (in bytes) of the ranges parsed in parallel.
+ */
+#define C_CHUNK_SIZE (4 * 1024 * 1024)
+
+struct PunchRecord;
+
+/*!
+ * PunchBlockHandler
+ *
+ * Function called by the Reader for each block, as soon as its last row is read.
+ */
+typedef std::function<void(PunchBlock &block)> PunchBlockHandler;
+
 
 class Reader
 {
 public:
     explicit Reader();
 
+    /* Number of threads used to parse bytes in memory */
+    int threadCount() const;
+    void setThreadCount(const int count);
+
+    /* Decode the fields into integers and real numbers */
+    bool isTyped() const;
+    void setTyped(const bool typed);
+
+    /* Decode the complex results into pairs */
+    ComplexConverter::Mode complexMode() const;
+    void setComplexMode(const ComplexConverter::Mode mode);
+
+    /* Select the blocks from their header */
+    const BlockFilter& filter() const;
+    void setFilter(const BlockFilter &filter);
+
+    /* Position of the input in its file */
+    std::size_t originOffset() const;
+    int originLine() const;
+    void setOrigin(const std::size_t offset, const int line);
+
     /* Read */
     PunchFile parsePUNCH(std::istream * const idevice);
+    PunchFile parsePUNCH(const char *begin, const char *end);
+
+    /* Read and push each block to the handler */
+    void parsePUNCH(std::istream * const idevice, const PunchBlockHandler &handler);
+    void parsePUNCH(const char *begin, const char *end, const PunchBlockHandler &handler);
+    void parsePUNCH(const char *begin, const char *end, const PunchIndex &index,
+                    const PunchBlockHandler &handler);
+
+    /* Scan the blocks, without parsing their rows (lazy blocks) */
+    PunchFile scanPUNCH(const char *begin, const char *end);
+    void scanPUNCH(const char *begin, const char *end, const PunchBlockHandler &handler);
+
+    /* Start of the last complete block of a growing input */
+    static const char* lastBlockStart(const char *from, const char *begin, const char *end);
 
     /* Get detailed warning messages, if any. */
     std::vector<std::string> getWarnings() const;
+    const Diagnostics& diagnostics() const;
 
 private:
-    void warn(const int lineCounter, const std::string &message);
-    std::vector<std::string> m_warningMessages;
+    void warn(const int lineCounter, const Diagnostic::Category category);
+    Diagnostics m_diagnostics;
+    int m_threadCount;
+    bool m_typed;
+    ComplexConverter::Mode m_complexMode;
+    std::size_t m_originOffset;
+    int m_originLine;
+    BlockFilter m_filter;
+
+    void parseParallel(const char *begin, const char *end, const PunchBlockHandler &handler);
+    void parseChunks(const std::vector<const char*> &bounds, const PunchBlockHandler &handler);
+    int parseRange(const char *begin, const char *end, int lineCounter);
+
+    void beginParse(const PunchBlockHandler &handler);
+    void parseRecord(const int lineCounter, const char *line, const PunchRecord &record);
+    void endParse();
+    void flushRow();
+    void appendField(const PunchField &field);
+    void countFields(const PunchRecord &record, const int first);
+    void flushBlock();
+    void newBlock(const int lineCounter);
+    void selectSchema();
+
+    PunchBlockHandler m_handler;
+    PunchBlock m_currentBlock;
+    bool m_hasCurrentBlock;
+    bool m_rejected;
+    bool m_rowRejected;
+    std::vector<PunchValue> m_currentValues;
+    std::vector<char> m_currentChars;
+    bool m_isHeaderSection;
+
+    /* Structural scan: the rows are counted, not stored */
+    bool m_lazy;
+    int m_rowFieldCount;
+    int m_rowColumnCount;
+    int m_blockRowCount;
+    int m_blockColumnCount;
+
+    /* Position of the current line */
+    const char *m_base;
+    std::size_t m_baseOffset;
+    std::size_t m_lineOffset;
+
+    /* Result type of the current block */
+    std::string m_resultTitle;
+    PunchSchema::Format m_resultFormat;
+    int m_elementType;
+    const PunchSchema *m_schema;
+    bool m_decode;
 
 };
 
@@ -0,0 +1,321 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "recordscanner.h"
+
+#include <cstdint>
+#include <cstring>  // memcmp()
+
+#if !defined(PCH2CSV_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  define PCH2CSV_HAS_SSE2
+#  include <emmintrin.h>
+#  if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#    define PCH2CSV_HAS_AVX2
+#    include <immintrin.h>
+#  endif
+#endif
+
+/*! \class RecordScanner
+ *  \brief The class RecordScanner classifies the 80-character punch records
+ *  and finds the boundaries of their fields.
+ *
+ * For each record, the scanner finds:
+ * \li the type of the record (header '$', continued '-CONT-' or data),
+ * \li the column of the first equal '=' symbol,
+ * \li the first and the last non-blank columns of the four 18-character fields.
+ *
+ * The vectorized implementations (SSE2, AVX2) compute a bitmask of the
+ * blank characters of the whole record in a few instructions, and the field
+ * boundaries are then found with bit operations, without any loop over
+ * the characters. The scalar implementation gives identical results, and is
+ * used when the CPU (or the compiler) doesn't support SSE2.
+ *
+ * The SIMD paths can be disabled at compile time with \a PCH2CSV_NO_SIMD.
+ */
+
+/* Blank characters for the data fields */
+static inline bool isBlank(const char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/******************************************************************************
+ ******************************************************************************/
+static void classify(const char *line, PunchRecord *record)
+{
+    if (line[0] == '$') {
+        record->type = PunchRecord::Header;
+        return;
+    }
+    const int begin = record->fieldBegin[0];
+    const int end = record->fieldEnd[0];
+    if (end - begin >= 6 && std::memcmp(line + begin, "-CONT-", 6) == 0) {
+        record->type = PunchRecord::Continuation;
+    } else {
+        record->type = PunchRecord::Data;
+    }
+}
+
+/******************************************************************************
+ ******************************************************************************/
+static void scanScalar(const char * const *lines, const std::size_t count, PunchRecord *records)
+{
+    for (std::size_t n = 0; n < count; ++n) {
+        const char *line = lines[n];
+        PunchRecord *record = &records[n];
+
+        for (int i = 0; i < C_FIELD_COUNT; ++i) {
+            int begin = i * C_FIELD_LENGTH;
+            int end = begin + C_FIELD_LENGTH;
+            while (begin != end && isBlank(line[begin])) {
+                ++begin;
+            }
+            while (end != begin && isBlank(line[end - 1])) {
+                --end;
+            }
+            if (begin == end) {
+                begin = end = i * C_FIELD_LENGTH;
+            }
+            record->fieldBegin[i] = static_cast<unsigned char>(begin);
+            record->fieldEnd[i] = static_cast<unsigned char>(end);
+        }
+
+        record->equal = -1;
+        for (int i = 0; i < C_RECORD_LENGTH; ++i) {
+            if (line[i] == '=') {
+                record->equal = i;
+                break;
+            }
+        }
+        classify(line, record);
+    }
+}
+
+/******************************************************************************
+ ******************************************************************************/
+#if defined(PCH2CSV_HAS_SSE2)
+
+static inline int countTrailingZeros(std::uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(x);
+#else
+    int n = 0;
+    while (!(x & 1)) { x >>= 1; ++n; }
+    return n;
+#endif
+}
+
+static inline int countLeadingZeros(std::uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(x);
+#else
+    int n = 0;
+    while (!(x & (std::uint64_t(1) << 63))) { x <<= 1; ++n; }
+    return n;
+#endif
+}
+
+/*! \internal
+ * Fills the \a record from the 80-bit masks of the non-blank characters
+ * and of the '=' characters (bits 0-63 in \a lo, bits 64-79 in \a hi).
+ */
+static inline void recordFromMasks(const char *line,
+                                   const std::uint64_t nonBlankLo, const std::uint64_t nonBlankHi,
+                                   const std::uint64_t equalLo, const std::uint64_t equalHi,
+                                   PunchRecord *record)
+{
+    const std::uint64_t fieldMask = (std::uint64_t(1) << C_FIELD_LENGTH) - 1;
+    for (int i = 0; i < C_FIELD_COUNT; ++i) {
+        const int start = i * C_FIELD_LENGTH;
+        std::uint64_t bits;
+        if (start + C_FIELD_LENGTH <= 64) {
+            bits = (nonBlankLo >> start) & fieldMask;
+        } else {
+            bits = ((nonBlankLo >> start) | (nonBlankHi << (64 - start))) & fieldMask;
+        }
+        if (bits) {
+            record->fieldBegin[i] = static_cast<unsigned char>(start + countTrailingZeros(bits));
+            record->fieldEnd[i] = static_cast<unsigned char>(start + 64 - countLeadingZeros(bits));
+        } else {
+            record->fieldBegin[i] = record->fieldEnd[i] = static_cast<unsigned char>(start);
+        }
+    }
+
+    if (equalLo) {
+        record->equal = countTrailingZeros(equalLo);
+    } else if (equalHi) {
+        record->equal = 64 + countTrailingZeros(equalHi);
+    } else {
+        record->equal = -1;
+    }
+    classify(line, record);
+}
+
+static inline std::uint32_t blankMaskSSE2(const __m128i v, std::uint32_t *equal)
+{
+    const __m128i b = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                             _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')),
+                             _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+    *equal = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('='))));
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(b));
+}
+
+static void scanSSE2(const char * const *lines, const std::size_t count, PunchRecord *records)
+{
+    for (std::size_t n = 0; n < count; ++n) {
+        const char *line = lines[n];
+
+        std::uint64_t blankLo = 0;
+        std::uint64_t equalLo = 0;
+        std::uint32_t eq;
+        for (int k = 0; k < 4; ++k) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line + 16 * k));
+            blankLo |= std::uint64_t(blankMaskSSE2(v, &eq)) << (16 * k);
+            equalLo |= std::uint64_t(eq) << (16 * k);
+        }
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line + 64));
+        const std::uint64_t blankHi = blankMaskSSE2(v, &eq);
+        const std::uint64_t equalHi = eq;
+
+        recordFromMasks(line, ~blankLo, ~blankHi & 0xFFFF, equalLo, equalHi, &records[n]);
+    }
+}
+
+#endif // PCH2CSV_HAS_SSE2
+
+/******************************************************************************
+ ******************************************************************************/
+#if defined(PCH2CSV_HAS_AVX2)
+
+__attribute__((target("avx2")))
+static inline std::uint32_t blankMaskAVX2(const __m256i v, std::uint32_t *equal)
+{
+    const __m256i b = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')),
+                                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))));
+    *equal = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('='))));
+    return static_cast<std::uint32_t>(_mm256_movemask_epi8(b));
+}
+
+__attribute__((target("avx2")))
+static void scanAVX2(const char * const *lines, const std::size_t count, PunchRecord *records)
+{
+    for (std::size_t n = 0; n < count; ++n) {
+        const char *line = lines[n];
+
+        std::uint32_t eq0, eq1, eq2;
+        const __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(line));
+        const __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(line + 32));
+        const __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line + 64));
+
+        const std::uint64_t blankLo = std::uint64_t(blankMaskAVX2(v0, &eq0))
+                | (std::uint64_t(blankMaskAVX2(v1, &eq1)) << 32);
+        const std::uint64_t blankHi = blankMaskSSE2(v2, &eq2);
+        const std::uint64_t equalLo = std::uint64_t(eq0) | (std::uint64_t(eq1) << 32);
+        const std::uint64_t equalHi = eq2;
+
+        recordFromMasks(line, ~blankLo, ~blankHi & 0xFFFF, equalLo, equalHi, &records[n]);
+    }
+}
+
+#endif // PCH2CSV_HAS_AVX2
+
+/******************************************************************************
+ ******************************************************************************/
+static RecordScanner::Implementation bestImplementation()
+{
+#if defined(PCH2CSV_HAS_AVX2)
+    if (__builtin_cpu_supports("avx2")) {
+        return RecordScanner::Implementation::AVX2;
+    }
+#endif
+#if defined(PCH2CSV_HAS_SSE2)
+    return RecordScanner::Implementation::SSE2;
+#else
+    return RecordScanner::Implementation::Scalar;
+#endif
+}
+
+static RecordScanner::Implementation s_implementation = bestImplementation();
+
+/*! \brief Returns the implementation used by \a scan().
+ *
+ * By default, the fastest implementation supported by the CPU.
+ */
+RecordScanner::Implementation RecordScanner::implementation()
+{
+    return s_implementation;
+}
+
+/*! \brief Forces the implementation used by \a scan(), if supported.
+ */
+void RecordScanner::setImplementation(const Implementation impl)
+{
+    if (isSupported(impl)) {
+        s_implementation = impl;
+    }
+}
+
+/*! \brief Returns \a true if the given \a impl is supported by the compiler and the CPU.
+ */
+bool RecordScanner::isSupported(const Implementation impl)
+{
+    switch (impl) {
+    case Implementation::Scalar:
+        return true;
+#if defined(PCH2CSV_HAS_SSE2)
+    case Implementation::SSE2:
+        return true;
+#endif
+#if defined(PCH2CSV_HAS_AVX2)
+    case Implementation::AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Scans the given \a count \a lines, and stores the result in \a records.
+ *
+ * Each line must have (at least) 80 readable characters.
+ */
+void RecordScanner::scan(const char * const *lines, const std::size_t count, PunchRecord *records)
+{
+    switch (s_implementation) {
+#if defined(PCH2CSV_HAS_AVX2)
+    case Implementation::AVX2:
+        scanAVX2(lines, count, records);
+        break;
+#endif
+#if defined(PCH2CSV_HAS_SSE2)
+    case Implementation::SSE2:
+        scanSSE2(lines, count, records);
+        break;
+#endif
+    case Implementation::Scalar:
+    default:
+        scanScalar(lines, count, records);
+        break;
+    }
+}
@@ -0,0 +1,69 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RECORD_SCANNER_H
+#define RECORD_SCANNER_H
+
+#include <cstddef>
+
+/*!
+ * C_RECORD_LENGTH
+ *
+ * A punch record is exactly 80 characters long:
+ * four 18-character fields, followed by the line number (columns 73-80).
+ */
+#define C_RECORD_LENGTH 80
+#define C_FIELD_LENGTH 18
+#define C_FIELD_COUNT 4
+
+/*!
+ * PunchRecord
+ *
+ * The classification of a 80-character punch record,
+ * and the boundaries of its fields without the blanks.
+ */
+struct PunchRecord
+{
+    enum Type {
+        Data,
+        Continuation,   /* First field starts with "-CONT-" */
+        Header          /* First column is '$' */
+    };
+
+    Type type;
+    int equal;                                  /* Column of the first '=', or -1 */
+    unsigned char fieldBegin[C_FIELD_COUNT];    /* First non-blank column of the field */
+    unsigned char fieldEnd[C_FIELD_COUNT];      /* Last non-blank column of the field, plus one */
+};
+
+
+class RecordScanner
+{
+public:
+    enum class Implementation {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    static Implementation implementation();
+    static void setImplementation(const Implementation impl);
+    static bool isSupported(const Implementation impl);
+
+    /* Scan \a count records of 80 characters */
+    static void scan(const char * const *lines, const std::size_t count, PunchRecord *records);
+};
+
+#endif // RECORD_SCANNER_H
@@ -0,0 +1,85 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "symboltable.h"
+
+/*! \class SymbolTable
+ *  \brief The class SymbolTable interns the texts of the block headers.
+ *
+ * Each distinct text (a key like \a SUBCASE \a ID, or a value) is stored
+ * once, and identified by a small integer. Two texts are equal if and only
+ * if their ids are equal, so the blocks can be compared and grouped without
+ * comparing strings.
+ *
+ * The table is shared by the whole process, so the ids of the blocks of
+ * different files and readers can be compared. It's thread-safe, and the
+ * texts are never removed: the references returned by \a symbol() remain
+ * valid.
+ *
+ * \example
+ *
+ * \code
+ * SymbolTable &table = SymbolTable::instance();
+ * int id = table.intern("SUBCASE ID");
+ * assert(table.symbol(id) == "SUBCASE ID");
+ * \endcode
+ */
+/*! \brief Returns the table of the process.
+ */
+SymbolTable& SymbolTable::instance()
+{
+    static SymbolTable table;
+    return table;
+}
+
+/*! \brief Constructor.
+ */
+SymbolTable::SymbolTable()
+{
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/*! \brief Returns the id of the given \a text.
+ * The text is added to the table if it's not already interned.
+ */
+int SymbolTable::intern(const std::string &text)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_ids.find(text);
+    if (it != m_ids.end()) {
+        return it->second;
+    }
+    const int id = static_cast<int>(m_symbols.size());
+    it = m_ids.emplace(text, id).first;
+    m_symbols.push_back( &it->first );
+    return id;
+}
+
+/*! \brief Returns the text of the given \a id.
+ */
+const std::string& SymbolTable::symbol(const int id) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return *m_symbols.at(id);
+}
+
+/*! \brief Returns the number of interned texts.
+ */
+std::size_t SymbolTable::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_symbols.size();
+}
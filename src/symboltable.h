@@ -0,0 +1,44 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class SymbolTable
+{
+public:
+    static SymbolTable& instance();
+
+    int intern(const std::string &text);
+    const std::string& symbol(const int id) const;
+    std::size_t size() const;
+
+private:
+    explicit SymbolTable();
+    SymbolTable(const SymbolTable &);           /* Not copyable */
+    SymbolTable& operator=(const SymbolTable &);
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, int> m_ids;
+    std::vector<const std::string*> m_symbols;
+};
+
+#endif // SYMBOL_TABLE_H
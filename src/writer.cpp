@@ -15,7 +15,9 @@
  */
 #include "writer.h"
 
+#include "numberparser.h"
 #include "punchfile.h"
+#include "punchschema.h"
 
 #include <assert.h>
 #include <ostream>
@@ -25,6 +27,9 @@ static const char str_separator[] = ";";
 static const char str_quote[]     = "\"";
 static const char str_unknown[]   = "unknown";
 
+/* The rows are written to the stream by chunks of this size */
+static const std::size_t C_WRITE_BUFFER_SIZE = 256 * 1024;
+
 using namespace std;
 
 /*! \class Writer
@@ -42,11 +47,22 @@ using namespace std;
  * for (auto & key : pch.blockKeys()) {
  *      auto br = pch.blockRange(key);
  *      for (auto b = br.first; b != br.second; ++b) {
- *          PunchBlock block = b->second;
- *          writer.writeCSV(block, &ofs);
+ *          writer.writeCSV(*b, &ofs);
  *      }
  *  }
  * \endcode
+ *
+ * The function \a writeCSV() can also be used directly as the block handler
+ * of the \a Reader, to write each block as soon as it's read:
+ *
+ * \code
+ * reader.parsePUNCH(&ifs, std::bind(&Writer::writeCSV, &writer, std::placeholders::_1, &ofs));
+ * \endcode
+ *
+ * The rows are formatted in a buffer of the Writer, reused by the blocks,
+ * and written to the stream by large chunks. The whole block is written
+ * when \a writeCSV() returns, but the stream isn't flushed: call
+ * \a std::ostream::flush() if the output must be visible immediately.
  */
 /*! \brief Constructor.
  */
@@ -54,13 +70,27 @@ Writer::Writer()
     : m_headerEnable(HeaderType::Default)
     , m_userDefinedHeader(string())
     , m_previousLeftHeaders(string())
+    , m_hasPreviousFormat(false)
+    , m_previousFingerprint(0)
+    , m_previousSchema(0)
+    , m_previousColumnCount(0)
+    , m_headerSize(0)
 {
 }
 
 /*! \brief Constructor.
+ *
+ * If \a namedColumns is true, the columns of the known result types are named
+ * after their schema (see \a PunchSchema), instead of 'unknown'.
  */
 Writer::Writer(const std::string &columnHeaderLine,
-               const bool skipColumnHeaders)
+               const bool skipColumnHeaders,
+               const bool namedColumns)
+    : m_hasPreviousFormat(false)
+    , m_previousFingerprint(0)
+    , m_previousSchema(0)
+    , m_previousColumnCount(0)
+    , m_headerSize(0)
 {
     if (skipColumnHeaders) {
         m_headerEnable = Writer::HeaderType::NoHeader;
@@ -69,6 +99,9 @@ Writer::Writer(const std::string &columnHeaderLine,
             m_headerEnable = Writer::HeaderType::UserDefined;
             m_userDefinedHeader = columnHeaderLine;
 
+        } else if (namedColumns) {
+            m_headerEnable = Writer::HeaderType::Named;
+
         } else {
             m_headerEnable = Writer::HeaderType::Default;
         }
@@ -80,6 +113,7 @@ Writer::Writer(const std::string &columnHeaderLine,
 void Writer::enableHeader(const HeaderType enable)
 {
     m_headerEnable = enable;
+    m_hasPreviousFormat = false;
 }
 
 void Writer::setHeader(const std::string &header)
@@ -87,6 +121,55 @@ void Writer::setHeader(const std::string &header)
     m_userDefinedHeader = header;
 }
 
+/******************************************************************************
+ ******************************************************************************/
+const std::string& Writer::previousLeftHeaders() const
+{
+    return m_previousLeftHeaders;
+}
+
+/*! \brief Sets the header of the last block written.
+ *
+ * The column header is written only if the next block has another header.
+ * It's used to append blocks to a csv written by another Writer.
+ */
+void Writer::setPreviousLeftHeaders(const std::string &headers)
+{
+    m_previousLeftHeaders = headers;
+    m_hasPreviousFormat = false;
+}
+
+/*! \brief Returns the size, in bytes, of the header line written by the
+ * last call of \a writeCSV(), i.e. the size of the beginning of its output.
+ * Returns 0 if no header was written.
+ */
+std::size_t Writer::headerSize() const
+{
+    return m_headerSize;
+}
+
+/*! \internal
+ * Returns true if the given \a block has the format and the schema of the
+ * last block written, i.e. the same header. The fingerprint rejects most of
+ * the other formats; the ids of the header keys confirm the match.
+ */
+bool Writer::isPreviousFormat(const PunchBlock &block) const
+{
+    if (!m_hasPreviousFormat
+            || block.formatFingerprint() != m_previousFingerprint
+            || block.schema() != m_previousSchema
+            || block.columnCount() != m_previousColumnCount
+            || block.prefixCount() != static_cast<int>(m_previousKeyIds.size())) {
+        return false;
+    }
+    for (int i = 0; i < block.prefixCount(); ++i) {
+        if (block.prefixKeyId(i) != m_previousKeyIds[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
 /******************************************************************************
  ******************************************************************************/
 inline const char* Writer::separator()
@@ -106,74 +189,119 @@ inline const char* Writer::unknown()
 
 /******************************************************************************
  ******************************************************************************/
-bool Writer::writeCSV(PunchBlock &block, std::ostream * const odevice)
+bool Writer::writeCSV(const PunchBlock &block, std::ostream * const odevice)
 {
     assert(odevice);
 
+    /* The header and the rows are formatted in the buffer, and written to
+     * the stream by large chunks. The stream isn't flushed. */
+    string &out = m_buffer;
+    out.clear();
+    m_headerSize = 0;
+
     /* **************************************** */
-    /* Prepare the header and the common rows   */
+    /* Prepare the common rows                  */
     /* **************************************** */
-    string defaultBlockHeader;
-    string prefixHeader;
     string prefixRow;
-
-    for (std::pair<const string, string> &var : block.prefixRowAndHeader()) {
-        prefixHeader += quote();
-        prefixHeader += var.first;
-        prefixHeader += quote();
-        prefixHeader += separator();
+    for (int i = 0; i < block.prefixCount(); ++i) {
         prefixRow += quote();
-        prefixRow += var.second;
+        prefixRow += block.prefixValue(i);
         prefixRow += quote();
         prefixRow += separator();
     }
 
-    for( int i = block.columnCount(); i>0; --i) {
-        defaultBlockHeader += quote();
-        defaultBlockHeader += unknown();
-        defaultBlockHeader += quote();
-        defaultBlockHeader += separator();
-    }
-
     /* **************************************** */
     /* Write the header                         */
     /* **************************************** */
-    string defaultHeader = prefixHeader + defaultBlockHeader;
-    if (defaultHeader != m_previousLeftHeaders) {
-
-        switch(m_headerEnable) {
-        case HeaderType::NoHeader:
-            break;
-        case HeaderType::UserDefined:
-            (*odevice) << prefixHeader;
-            (*odevice) << m_userDefinedHeader;
-            (*odevice) << std::endl;
-            break;
-        case HeaderType::Default:
-        default:
-            (*odevice) << defaultHeader;
-            (*odevice) << std::endl;
-            break;
+    /* Same format as the previous block: same header */
+    const PunchSchema *schema = block.schema();
+    if (!isPreviousFormat(block)) {
+
+        string defaultBlockHeader;
+        string prefixHeader;
+
+        for (int i = 0; i < block.prefixCount(); ++i) {
+            prefixHeader += quote();
+            prefixHeader += block.prefixKey(i);
+            prefixHeader += quote();
+            prefixHeader += separator();
+        }
+
+        if (m_headerEnable == HeaderType::Named
+                && schema && schema->columnCount == block.columnCount()) {
+            for (int i = 0; i < schema->columnCount; ++i) {
+                defaultBlockHeader += quote();
+                defaultBlockHeader += schema->columns[i];
+                defaultBlockHeader += quote();
+                defaultBlockHeader += separator();
+            }
+        } else {
+            for( int i = block.columnCount(); i>0; --i) {
+                defaultBlockHeader += quote();
+                defaultBlockHeader += unknown();
+                defaultBlockHeader += quote();
+                defaultBlockHeader += separator();
+            }
+        }
+
+        string defaultHeader = prefixHeader + defaultBlockHeader;
+        if (defaultHeader != m_previousLeftHeaders) {
+
+            switch(m_headerEnable) {
+            case HeaderType::NoHeader:
+                break;
+            case HeaderType::UserDefined:
+                out += prefixHeader;
+                out += m_userDefinedHeader;
+                out += '\n';
+                break;
+            case HeaderType::Named:
+            case HeaderType::Default:
+            default:
+                out += defaultHeader;
+                out += '\n';
+                break;
+            }
+
+            m_previousLeftHeaders = defaultHeader;
+            m_headerSize = out.size();
         }
 
-        m_previousLeftHeaders = defaultHeader;
+        m_hasPreviousFormat = true;
+        m_previousFingerprint = block.formatFingerprint();
+        m_previousSchema = schema;
+        m_previousColumnCount = block.columnCount();
+        m_previousKeyIds.clear();
+        for (int i = 0; i < block.prefixCount(); ++i) {
+            m_previousKeyIds.push_back( block.prefixKeyId(i) );
+        }
     }
 
     /* **************************************** */
     /* Write the rows                           */
     /* **************************************** */
-    if (!block.rows().empty()) {
-        for (PunchRow &row : block.rows()) {
-            (*odevice) << prefixRow;
-
-            for (const auto& field : row) {
-                (*odevice) << quote();
-                (*odevice) << field;
-                (*odevice) << quote();
-                (*odevice) << separator();
-            }
-            (*odevice) << std::endl;
+    const char quoteChar = *quote();
+    const char separatorChar = *separator();
+    char buffer[C_NUMBER_BUFFER_SIZE];
+    for (int row = 0; row < block.rowCount(); ++row) {
+        out += prefixRow;
+
+        for (int column = 0; column < block.fieldCount(row); ++column) {
+            PunchField field = block.field(row, column, buffer);
+            out += quoteChar;
+            out.append(field.data, field.size);
+            out += quoteChar;
+            out += separatorChar;
         }
+        out += '\n';
+
+        if (out.size() >= C_WRITE_BUFFER_SIZE) {
+            odevice->write(out.data(), out.size());
+            out.clear();
+        }
+    }
+    if (!out.empty()) {
+        odevice->write(out.data(), out.size());
     }
 
     return true;
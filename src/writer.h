@@ -16,36 +16,62 @@
 #ifndef WRITER_H
 #define WRITER_H
 
+#include <cstddef>
+#include <cstdint>
 #include <ostream>
 #include <string>
+#include <vector>
 
 class PunchBlock;
+struct PunchSchema;
 
 class Writer
 {
     enum class HeaderType {
         Default,
         UserDefined,
-        NoHeader
+        NoHeader,
+        Named
     };
 
 public:
     explicit Writer();
-    explicit Writer(const std::string &columnHeaderLine, const bool skipColumnHeaders);
+    explicit Writer(const std::string &columnHeaderLine, const bool skipColumnHeaders,
+                    const bool namedColumns = false);
 
     void enableHeader(const HeaderType enable);
     void setHeader(const std::string &header);
 
-    bool writeCSV(PunchBlock &block, std::ostream * const odevice);
+    /* Header of the last block written */
+    const std::string& previousLeftHeaders() const;
+    void setPreviousLeftHeaders(const std::string &headers);
+
+    /* Size of the header line written by the last writeCSV() */
+    std::size_t headerSize() const;
+
+    bool writeCSV(const PunchBlock &block, std::ostream * const odevice);
 
     static inline const char* separator();
     static inline const char* quote();
     static inline const char* unknown();
 
 private:
+    bool isPreviousFormat(const PunchBlock &block) const;
+
     HeaderType m_headerEnable;
     std::string m_userDefinedHeader;
     std::string m_previousLeftHeaders;
+
+    /* Format of the last block written */
+    bool m_hasPreviousFormat;
+    std::uint64_t m_previousFingerprint;
+    const PunchSchema *m_previousSchema;
+    int m_previousColumnCount;
+    std::vector<int> m_previousKeyIds;
+
+    /* Output buffer, reused by the blocks */
+    std::string m_buffer;
+    std::size_t m_headerSize;
 };
 
 
@@ -0,0 +1,276 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arena.h>
+#include <PunchFile.h>
+#include <Reader.h>
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class tst_Arena : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void test_allocate();
+    void test_large_allocation();
+    void test_containers();
+
+    void test_punch_file();
+    void test_append_move();
+    void test_merge_copy();
+    void test_merge_move();
+
+private:
+    static std::string content(const int subcaseCount);
+};
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_Arena::test_allocate()
+{
+    Arena arena;
+    QCOMPARE(int(arena.allocationCount()), 0);
+    QCOMPARE(int(arena.systemAllocationCount()), 0);
+
+    for (int i = 1; i <= 1000; ++i) {
+        const std::size_t alignment = (i % 2) ? 1 : 8;
+        void *p = arena.allocate(i % 50 + 1, alignment);
+        QVERIFY(p != 0);
+        QCOMPARE(int(reinterpret_cast<std::uintptr_t>(p) % alignment), 0);
+    }
+    QCOMPARE(int(arena.allocationCount()), 1000);
+    QCOMPARE(int(arena.systemAllocationCount()), 1);
+    QCOMPARE(int(arena.reservedBytes()), C_ARENA_CHUNK_SIZE);
+
+    /* The last allocation is reused */
+    char *p = static_cast<char*>(arena.allocate(100, 1));
+    arena.deallocate(p, 100);
+    QVERIFY(arena.allocate(100, 1) == p);
+}
+
+void tst_Arena::test_large_allocation()
+{
+    Arena arena;
+    void *p = arena.allocate(C_ARENA_LARGE_SIZE, 8);
+    QVERIFY(p != 0);
+    QCOMPARE(int(arena.reservedBytes()), C_ARENA_LARGE_SIZE);
+
+    arena.deallocate(p, C_ARENA_LARGE_SIZE);
+    QCOMPARE(int(arena.reservedBytes()), 0);
+    QCOMPARE(int(arena.systemAllocationCount()), 1);
+
+    /* Released in any order */
+    std::vector<void*> blocks;
+    for (int i = 0; i < 100; ++i) {
+        blocks.push_back( arena.allocate(C_ARENA_LARGE_SIZE, 8) );
+    }
+    for (std::size_t i = 0; i < blocks.size(); i += 2) {
+        arena.deallocate(blocks[i], C_ARENA_LARGE_SIZE);
+    }
+    QCOMPARE(int(arena.reservedBytes()), 50 * C_ARENA_LARGE_SIZE);
+    for (std::size_t i = 1; i < blocks.size(); i += 2) {
+        arena.deallocate(blocks[i], C_ARENA_LARGE_SIZE);
+    }
+    QCOMPARE(int(arena.reservedBytes()), 0);
+}
+
+void tst_Arena::test_containers()
+{
+    std::shared_ptr<Arena> arena = std::make_shared<Arena>();
+    {
+        std::vector<int, ArenaAllocator<int> > v( (ArenaAllocator<int>(arena)) );
+        std::map<int, int, std::less<int>, ArenaAllocator<std::pair<const int, int> > > m(
+                    (ArenaAllocator<std::pair<const int, int> >(arena)) );
+        for (int i = 0; i < 1000; ++i) {
+            v.push_back(i);
+            m[i] = 2 * i;
+        }
+        QCOMPARE(v[999], 999);
+        QCOMPARE(m[999], 1998);
+        QVERIFY(arena.use_count() > 1);
+    }
+    QCOMPARE(arena.use_count(), long(1));
+    QVERIFY(arena->allocationCount() > 1000);
+    QCOMPARE(int(arena->systemAllocationCount()), 1);
+
+    /* Without arena, the allocator uses the heap */
+    std::vector<int, ArenaAllocator<int> > heap;
+    heap.push_back(1);
+    QVERIFY(!heap.get_allocator().arena());
+}
+
+/******************************************************************************
+ ******************************************************************************/
+/* Returns the given number of subcases of 10 rows. */
+std::string tst_Arena::content(const int subcaseCount)
+{
+    std::stringstream buffer;
+    for (int subcase = 1; subcase <= subcaseCount; ++subcase) {
+        buffer << "$TITLE   = MSC.NASTRAN JOB                                              " << "       1\n";
+        buffer << "$SUBCASE ID =" << std::setw(12) << subcase
+               << "                                               " << "       2\n";
+        for (int i = 0; i < 10; ++i) {
+            buffer << std::setw(10) << (i + 1) << "        "
+                   << "G                 "
+                   << "  1.000000E+00    "
+                   << "  2.000000E+00    "
+                   << "       3\n";
+        }
+    }
+    return buffer.str();
+}
+
+void tst_Arena::test_punch_file()
+{
+    // Given
+    std::stringstream buffer(content(1000));
+
+    // When
+    Reader reader;
+    PunchFile pch = reader.parsePUNCH(&buffer);
+    std::shared_ptr<Arena> arena = pch.arena();
+
+    // Then
+    QVERIFY(reader.getWarnings().empty());
+    QCOMPARE(int(pch.blockKeys().size()), 1);
+    /* The header, the values, the row offsets and the characters of each block */
+    QVERIFY(arena->allocationCount() >= 4000);
+    QVERIFY(arena->systemAllocationCount() * 100 < arena->allocationCount());
+
+    auto range = pch.blockRange(*pch.blockKeys().begin());
+    int count = 0;
+    for (auto it = range.first; it != range.second; ++it) {
+        QVERIFY(it->arena() == arena);
+        QCOMPARE(it->rowCount(), 10);
+        QCOMPARE(QString::fromStdString(it->text(9, 1)), QString("G"));
+        ++count;
+    }
+    QCOMPARE(count, 1000);
+}
+
+void tst_Arena::test_append_move()
+{
+    /* A moved block keeps its memory */
+    // Given
+    std::shared_ptr<Arena> source = std::make_shared<Arena>();
+    PunchBlock block(source);
+    block.insertPrefix("SUBCASE ID", "1");
+    block.append(PunchRow({"1", "G", "1.0"}));
+    block.append(PunchRow({"2", "G", "2.0"}));
+    const std::size_t allocationCount = source->allocationCount();
+
+    // When
+    PunchFile pch;
+    pch.append( std::move(block) );
+
+    // Then
+    QCOMPARE(source->allocationCount(), allocationCount);
+    QCOMPARE(int(pch.blockKeys().size()), 1);
+    auto range = pch.blockRange(*pch.blockKeys().begin());
+    QVERIFY(range.first != range.second);
+    QVERIFY(range.first->arena() == source);
+    QCOMPARE(range.first->rowCount(), 2);
+    QCOMPARE(QString::fromStdString(range.first->text(1, 2)), QString("2.0"));
+    QVERIFY(++range.first == range.second);
+}
+
+void tst_Arena::test_merge_copy()
+{
+    // Given
+    std::stringstream buffer(content(100));
+    Reader reader;
+    PunchFile other = reader.parsePUNCH(&buffer);
+
+    // When
+    PunchFile pch;
+    pch += other;
+
+    // Then
+    /* The blocks are copied into the arena of the file */
+    std::shared_ptr<Arena> arena = pch.arena();
+    QVERIFY(arena->allocationCount() >= 400);
+    QCOMPARE(int(other.blockKeys().size()), 1);
+    QCOMPARE(int(pch.blockKeys().size()), 1);
+    auto range = pch.blockRange(*pch.blockKeys().begin());
+    int count = 0;
+    for (auto it = range.first; it != range.second; ++it) {
+        QVERIFY(it->arena() == arena);
+        QCOMPARE(it->rowCount(), 10);
+        ++count;
+    }
+    QCOMPARE(count, 100);
+}
+
+void tst_Arena::test_merge_move()
+{
+    // Given
+    std::stringstream buffer1(content(100));
+    std::stringstream buffer2(content(50));
+    Reader reader;
+    PunchFile other1 = reader.parsePUNCH(&buffer1);
+    PunchFile other2 = reader.parsePUNCH(&buffer2);
+    std::shared_ptr<Arena> arena1 = other1.arena();
+    std::shared_ptr<Arena> arena2 = other2.arena();
+    const std::size_t allocationCount1 = arena1->allocationCount();
+    const std::size_t allocationCount2 = arena2->allocationCount();
+
+    // When
+    PunchFile pch;
+    pch += std::move(other1);
+    pch += std::move(other2);
+
+    // Then
+    /* The rows aren't copied */
+    QCOMPARE(int(pch.arena()->allocationCount()), 0);
+    QCOMPARE(arena1->allocationCount(), allocationCount1);
+    QCOMPARE(arena2->allocationCount(), allocationCount2);
+    QVERIFY(other1.blockKeys().empty());
+    QVERIFY(other2.blockKeys().empty());
+
+    QCOMPARE(int(pch.blockKeys().size()), 1);
+    auto range = pch.blockRange(*pch.blockKeys().begin());
+    int count = 0;
+    for (auto it = range.first; it != range.second; ++it) {
+        /* The blocks keep the order of the files */
+        QVERIFY(it->arena() == (count < 100 ? arena1 : arena2));
+        QCOMPARE(it->rowCount(), 10);
+        QCOMPARE(QString::fromStdString(it->text(9, 1)), QString("G"));
+        ++count;
+    }
+    QCOMPARE(count, 150);
+
+    /* The arenas live as long as the blocks */
+    arena1.reset();
+    arena2.reset();
+    QCOMPARE(QString::fromStdString(pch.blockRange(*pch.blockKeys().begin()).first->text(0, 0)),
+             QString("1"));
+}
+
+QTEST_APPLESS_MAIN(tst_Arena)
+
+#include "tst_arena.moc"
@@ -0,0 +1,270 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <MappedFile.h>
+#include <NumberParser.h>
+#include <Reader.h>
+#include <Writer.h>
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+static const char C_BENCHMARK_FILE[] = "tst_benchmark.pch";
+static const char C_BENCHMARK_CSV[] = "tst_benchmark.csv";
+static const int  C_BENCHMARK_SUBCASES = 50;
+static const int  C_BENCHMARK_ELEMENTS = 1000;
+static const int  C_BENCHMARK_ITERATIONS = 5;
+
+/*! \internal
+ * Writes a synthetic punch file, made of \a subcases blocks of \a elements
+ * element stresses (1 line + 2 continued lines per element).
+ */
+static std::size_t generatePunchFile(const char *filename, int subcases, int elements)
+{
+    std::ofstream ofs(filename, std::ios::out | std::ios::binary);
+    char line[96];
+    int lineNumber = 0;
+    for (int s = 0; s < subcases; ++s) {
+        std::snprintf(line, sizeof(line), "%-72s%8d\n", "$TITLE   = BENCHMARK", ++lineNumber);
+        ofs << line;
+        std::snprintf(line, sizeof(line), "%-72s%8d\n", "$ELEMENT STRESSES", ++lineNumber);
+        ofs << line;
+        std::snprintf(line, sizeof(line), "$SUBCASE ID = %10d%48s%8d\n", s + 1, "", ++lineNumber);
+        ofs << line;
+        for (int e = 0; e < elements; ++e) {
+            std::snprintf(line, sizeof(line), "%10d%8s%18s%18s%18s%8d\n",
+                          80000000 + e, "", "BAR", "", "", ++lineNumber);
+            ofs << line;
+            std::snprintf(line, sizeof(line), "-CONT-%12s%18.6E%18.6E%18.6E%8d\n",
+                          "", 2.288704E+04 + e, -3.404367E+03, 1.639255E+03, ++lineNumber);
+            ofs << line;
+            std::snprintf(line, sizeof(line), "-CONT-%12s%18.6E%18.6E%18.6E%8d\n",
+                          "", -7.163730E+04, 9.975631E+05 - e, 3.060709E+06, ++lineNumber);
+            ofs << line;
+        }
+    }
+    std::size_t size = static_cast<std::size_t>(ofs.tellp());
+    ofs.close();
+    return size;
+}
+
+/*! \internal
+ * Returns the throughput, in bytes per second.
+ */
+static double throughput(std::size_t bytes, std::chrono::steady_clock::duration elapsed)
+{
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    return seconds > 0 ? (bytes / seconds) : 0;
+}
+
+static int blockCount(const PunchFile &pch)
+{
+    int count = 0;
+    for (auto & key : pch.blockKeys()) {
+        auto br = pch.blockRange(key);
+        for (auto b = br.first; b != br.second; ++b) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+/*! \internal
+ * Writes the given \a block like the previous Writer, i.e. with an
+ * operator<< per quote, field and separator, and a std::endl per row.
+ * It's the reference of the throughput of the Writer.
+ */
+static void writeCSVByRow(const PunchBlock &block, std::ostream *odevice,
+                          std::string *previousHeader)
+{
+    std::string prefixHeader;
+    std::string prefixRow;
+    for (int i = 0; i < block.prefixCount(); ++i) {
+        prefixHeader += "\"" + block.prefixKey(i) + "\";";
+        prefixRow += "\"" + block.prefixValue(i) + "\";";
+    }
+    std::string header = prefixHeader;
+    for (int i = 0; i < block.columnCount(); ++i) {
+        header += "\"unknown\";";
+    }
+    if (header != *previousHeader) {
+        (*odevice) << header;
+        (*odevice) << std::endl;
+        *previousHeader = header;
+    }
+
+    char buffer[C_NUMBER_BUFFER_SIZE];
+    for (int row = 0; row < block.rowCount(); ++row) {
+        (*odevice) << prefixRow;
+        for (int column = 0; column < block.fieldCount(row); ++column) {
+            PunchField field = block.field(row, column, buffer);
+            (*odevice) << "\"";
+            odevice->write(field.data, field.size);
+            (*odevice) << "\"";
+            (*odevice) << ";";
+        }
+        (*odevice) << std::endl;
+    }
+}
+
+static std::string readAll(const char *filename)
+{
+    std::ifstream ifs(filename, std::ios::in | std::ios::binary);
+    std::stringstream buffer;
+    buffer << ifs.rdbuf();
+    return buffer.str();
+}
+
+
+class tst_Benchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void benchmark_parse_stream();
+    void benchmark_parse_mapped();
+    void benchmark_write_csv();
+
+private:
+    std::size_t m_fileSize;
+};
+
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_Benchmark::initTestCase()
+{
+    m_fileSize = generatePunchFile(C_BENCHMARK_FILE,
+                                   C_BENCHMARK_SUBCASES, C_BENCHMARK_ELEMENTS);
+    QVERIFY(m_fileSize > 0);
+}
+
+void tst_Benchmark::cleanupTestCase()
+{
+    std::remove(C_BENCHMARK_FILE);
+    std::remove(C_BENCHMARK_CSV);
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_Benchmark::benchmark_parse_stream()
+{
+    int blocks = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < C_BENCHMARK_ITERATIONS; ++i) {
+        std::ifstream ifs(C_BENCHMARK_FILE, std::ios::in | std::ios::binary);
+        QVERIFY(ifs.is_open());
+        Reader reader;
+        PunchFile pch = reader.parsePUNCH(&ifs);
+        blocks = blockCount(pch);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    QCOMPARE(blocks, C_BENCHMARK_SUBCASES);
+
+    double bps = throughput(m_fileSize * C_BENCHMARK_ITERATIONS, elapsed);
+    qDebug() << "istream:" << (bps / 1e6) << "MB/s";
+    QTest::setBenchmarkResult(bps, QTest::BytesPerSecond);
+}
+
+void tst_Benchmark::benchmark_parse_mapped()
+{
+    int blocks = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < C_BENCHMARK_ITERATIONS; ++i) {
+        MappedFile file;
+        QVERIFY(file.open(C_BENCHMARK_FILE));
+        Reader reader;
+        PunchFile pch = reader.parsePUNCH(file.data(), file.data() + file.size());
+        blocks = blockCount(pch);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    QCOMPARE(blocks, C_BENCHMARK_SUBCASES);
+
+    double bps = throughput(m_fileSize * C_BENCHMARK_ITERATIONS, elapsed);
+    qDebug() << "mmap:" << (bps / 1e6) << "MB/s";
+    QTest::setBenchmarkResult(bps, QTest::BytesPerSecond);
+}
+
+void tst_Benchmark::benchmark_write_csv()
+{
+    MappedFile file;
+    QVERIFY(file.open(C_BENCHMARK_FILE));
+    Reader reader;
+    PunchFile pch = reader.parsePUNCH(file.data(), file.data() + file.size());
+    QCOMPARE(blockCount(pch), C_BENCHMARK_SUBCASES);
+
+    /* Reference: a std::endl per row */
+    std::size_t bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < C_BENCHMARK_ITERATIONS; ++i) {
+        std::ofstream ofs(C_BENCHMARK_CSV, std::ios::out | std::ios::binary);
+        std::string previousHeader;
+        for (const int keyId : pch.keyIds()) {
+            auto br = pch.blockRange(keyId);
+            for (auto b = br.first; b != br.second; ++b) {
+                writeCSVByRow(*b, &ofs, &previousHeader);
+            }
+        }
+        bytes = static_cast<std::size_t>(ofs.tellp());
+    }
+    auto elapsedByRow = std::chrono::steady_clock::now() - start;
+    const std::string expected = readAll(C_BENCHMARK_CSV);
+
+    /* Writer: large buffer, no flush */
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < C_BENCHMARK_ITERATIONS; ++i) {
+        std::ofstream ofs(C_BENCHMARK_CSV, std::ios::out | std::ios::binary);
+        Writer writer;
+        for (const int keyId : pch.keyIds()) {
+            auto br = pch.blockRange(keyId);
+            for (auto b = br.first; b != br.second; ++b) {
+                QVERIFY(writer.writeCSV(*b, &ofs));
+            }
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    /* Same bytes */
+    QVERIFY(bytes > 0);
+    QVERIFY(readAll(C_BENCHMARK_CSV) == expected);
+
+    double bpsByRow = throughput(bytes * C_BENCHMARK_ITERATIONS, elapsedByRow);
+    double bps = throughput(bytes * C_BENCHMARK_ITERATIONS, elapsed);
+    qDebug() << "csv (endl per row):" << (bpsByRow / 1e6) << "MB/s";
+    qDebug() << "csv (Writer):" << (bps / 1e6) << "MB/s";
+    QTest::setBenchmarkResult(bps, QTest::BytesPerSecond);
+}
+
+/* *****************************************************************************
+ ***************************************************************************** */
+
+
+QTEST_APPLESS_MAIN(tst_Benchmark)
+
+#include "tst_benchmark.moc"
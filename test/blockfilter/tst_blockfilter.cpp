@@ -0,0 +1,357 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <BlockFilter.h>
+#include <IdSet.h>
+#include <PunchFile.h>
+#include <Reader.h>
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class tst_BlockFilter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void test_empty();
+    void test_subcases();
+    void test_subcases_invalid();
+    void test_subcases_invalid_data();
+    void test_headers();
+    void test_result_types();
+    void test_ids();
+    void test_reader();
+    void test_reader_data();
+    void test_reader_ids();
+    void test_reader_ids_data();
+
+private:
+    static PunchBlock block(const std::string &subcase, const std::string &label);
+    static std::string record(const std::string &fields, const int line);
+    static std::string content(const int subcaseCount);
+};
+
+/******************************************************************************
+ ******************************************************************************/
+PunchBlock tst_BlockFilter::block(const std::string &subcase, const std::string &label)
+{
+    PunchBlock block;
+    block.insertPrefix("LABEL", label);
+    if (!subcase.empty()) {
+        block.insertPrefix("SUBCASE ID", subcase);
+    }
+    return block;
+}
+
+/* Returns a 80-char record made of the given fields and sequence number. */
+std::string tst_BlockFilter::record(const std::string &fields, const int line)
+{
+    char buffer[81];
+    std::snprintf(buffer, sizeof(buffer), "%-72s%8d", fields.c_str(), line);
+    return std::string(buffer) + "\n";
+}
+
+/* Returns the displacements and the forces of the given number of subcases. */
+std::string tst_BlockFilter::content(const int subcaseCount)
+{
+    std::string content;
+    int line = 0;
+    for (int i = 1; i <= subcaseCount; ++i) {
+        const std::string label = "$LABEL   = LOAD " + std::to_string(i % 3);
+        const std::string subcase = "$SUBCASE ID = " + std::to_string(i);
+        content += record("$TITLE   = MY FEA MODEL", ++line);
+        content += record(label, ++line);
+        content += record("$DISPLACEMENTS", ++line);
+        content += record("$REAL OUTPUT", ++line);
+        content += record(subcase, ++line);
+        content += record("         1       G      1.000000E+00      2.000000E+00      3.000000E+00", ++line);
+        content += record("-CONT-                  4.000000E+00      5.000000E+00      6.000000E+00", ++line);
+        content += record("         2       G      1.000000E+00      2.000000E+00      3.000000E+00", ++line);
+        content += record("-CONT-                  4.000000E+00      5.000000E+00      6.000000E+00", ++line);
+        content += record("$TITLE   = MY FEA MODEL", ++line);
+        content += record(label, ++line);
+        content += record("$ELEMENT FORCES", ++line);
+        content += record("$REAL OUTPUT", ++line);
+        content += record(subcase, ++line);
+        content += record("$ELEMENT TYPE =         102  BUSH", ++line);
+        content += record("      1001          1.000000E+00      2.000000E+00      3.000000E+00", ++line);
+        content += record("-CONT-              4.000000E+00      5.000000E+00      6.000000E+00", ++line);
+    }
+    return content;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_BlockFilter::test_empty()
+{
+    BlockFilter filter;
+    QVERIFY(filter.isEmpty());
+    QVERIFY(filter.accepts(PunchBlock(), std::string()));
+    QVERIFY(filter.accepts(block("1", "LOAD"), "DISPLACEMENTS"));
+
+    filter.addResultType("SPCF");
+    QVERIFY(!filter.isEmpty());
+    filter.clear();
+    QVERIFY(filter.isEmpty());
+}
+
+void tst_BlockFilter::test_subcases()
+{
+    BlockFilter filter;
+    QVERIFY(filter.addSubcases("1,3,10-20"));
+    QVERIFY(filter.addSubcases("100"));
+
+    QVERIFY(filter.accepts(block("1", ""), ""));
+    QVERIFY(!filter.accepts(block("2", ""), ""));
+    QVERIFY(filter.accepts(block("3", ""), ""));
+    QVERIFY(filter.accepts(block("10", ""), ""));
+    QVERIFY(filter.accepts(block("15", ""), ""));
+    QVERIFY(filter.accepts(block("20", ""), ""));
+    QVERIFY(!filter.accepts(block("21", ""), ""));
+    QVERIFY(filter.accepts(block("100", ""), ""));
+
+    /* A block without subcase is rejected */
+    QVERIFY(!filter.accepts(block("", ""), ""));
+    QVERIFY(!filter.accepts(block("ABC", ""), ""));
+}
+
+void tst_BlockFilter::test_subcases_invalid_data()
+{
+    QTest::addColumn<QString>("list");
+
+    QTest::newRow("empty") << "";
+    QTest::newRow("not a number") << "A";
+    QTest::newRow("empty item") << "1,,3";
+    QTest::newRow("trailing comma") << "1,";
+    QTest::newRow("reversed range") << "20-10";
+    QTest::newRow("open range") << "10-";
+}
+
+void tst_BlockFilter::test_subcases_invalid()
+{
+    QFETCH(QString, list);
+    BlockFilter filter;
+    QVERIFY(!filter.addSubcases(list.toStdString()));
+    QVERIFY(filter.isEmpty());
+}
+
+void tst_BlockFilter::test_headers()
+{
+    BlockFilter filter;
+    filter.addHeader("LABEL", "LOAD 1");
+    filter.addHeader("LABEL", "LOAD 2");
+
+    QVERIFY(filter.accepts(block("1", "LOAD 1"), ""));
+    QVERIFY(filter.accepts(block("1", "LOAD 2"), ""));
+    QVERIFY(!filter.accepts(block("1", "LOAD 3"), ""));
+    QVERIFY(!filter.accepts(PunchBlock(), ""));
+
+    /* The criteria are combined */
+    QVERIFY(filter.addSubcases("2"));
+    QVERIFY(!filter.accepts(block("1", "LOAD 1"), ""));
+    QVERIFY(filter.accepts(block("2", "LOAD 1"), ""));
+}
+
+void tst_BlockFilter::test_result_types()
+{
+    BlockFilter filter;
+    filter.addResultType("displacements");
+    QVERIFY(filter.accepts(PunchBlock(), "DISPLACEMENTS"));
+    QVERIFY(filter.accepts(PunchBlock(), "Displacements"));
+    QVERIFY(!filter.accepts(PunchBlock(), "ELEMENT FORCES"));
+    QVERIFY(!filter.accepts(PunchBlock(), ""));
+}
+
+void tst_BlockFilter::test_ids()
+{
+    IdSet ids;
+    ids.insert(1001);
+    ids.insert(2000, 2009);
+
+    BlockFilter filter;
+    filter.setIds(ids);
+    QVERIFY(!filter.isEmpty());
+    QVERIFY(filter.hasIds());
+
+    /* The blocks are accepted, the rows are filtered */
+    QVERIFY(filter.accepts(block("1", "LOAD"), "DISPLACEMENTS"));
+
+    const std::string fields[] = { "1001", "2005       G", "1002", "G", "" };
+    QVERIFY(filter.acceptsId(fields[0].data(), fields[0].data() + fields[0].size()));
+    QVERIFY(filter.acceptsId(fields[1].data(), fields[1].data() + fields[1].size()));
+    QVERIFY(!filter.acceptsId(fields[2].data(), fields[2].data() + fields[2].size()));
+    QVERIFY(!filter.acceptsId(fields[3].data(), fields[3].data() + fields[3].size()));
+    QVERIFY(!filter.acceptsId(fields[4].data(), fields[4].data() + fields[4].size()));
+
+    const BlockFilter rows = filter.rowFilter();
+    QVERIFY(rows.hasIds());
+    QVERIFY(!rows.acceptsId(fields[2].data(), fields[2].data() + fields[2].size()));
+
+    filter.clear();
+    QVERIFY(filter.isEmpty());
+    QVERIFY(!filter.hasIds());
+    QVERIFY(filter.acceptsId(fields[2].data(), fields[2].data() + fields[2].size()));
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_BlockFilter::test_reader_data()
+{
+    QTest::addColumn<int>("threadCount");
+    QTest::addColumn<bool>("typed");
+    QTest::addColumn<bool>("stream");
+
+    QTest::newRow("serial") << 1 << false << false;
+    QTest::newRow("typed") << 1 << true << false;
+    QTest::newRow("parallel") << 4 << false << false;
+    QTest::newRow("stream") << 1 << false << true;
+}
+
+void tst_BlockFilter::test_reader()
+{
+    /* The Reader must give the accepted blocks of the whole parse. */
+    // Given
+    QFETCH(int, threadCount);
+    QFETCH(bool, typed);
+    QFETCH(bool, stream);
+
+    std::string input;
+    while (input.size() < 3 * C_CHUNK_SIZE) {
+        input += content(500);
+    }
+    const char *begin = input.data();
+    const char *end = input.data() + input.size();
+
+    BlockFilter filter;
+    QVERIFY(filter.addSubcases("7,300-302"));
+    filter.addHeader("LABEL", "LOAD 1");
+    filter.addResultType("Element Forces");
+
+    std::vector<PunchBlock> expected;
+    Reader wholeReader;
+    wholeReader.setTyped(typed);
+    wholeReader.parsePUNCH(begin, end, [&](PunchBlock &block) {
+        const bool forces = block.prefixRowAndHeader().count("ELEMENT TYPE") > 0;
+        if (filter.accepts(block, forces ? "ELEMENT FORCES" : "DISPLACEMENTS")) {
+            expected.push_back(block);
+        }
+    });
+
+    // When
+    std::vector<PunchBlock> actual;
+    Reader reader;
+    reader.setThreadCount(threadCount);
+    reader.setTyped(typed);
+    reader.setFilter(filter);
+    if (stream) {
+        std::istringstream iss(input);
+        reader.parsePUNCH(&iss, [&actual](PunchBlock &block) { actual.push_back(block); });
+    } else {
+        reader.parsePUNCH(begin, end, [&actual](PunchBlock &block) { actual.push_back(block); });
+    }
+
+    // Then
+    QVERIFY(!expected.empty());
+    QCOMPARE(actual.size(), expected.size());
+    for (std::size_t k = 0; k < actual.size(); ++k) {
+        QCOMPARE(actual[k].sourceOffset(), expected[k].sourceOffset());
+        QCOMPARE(actual[k].sourceLine(), expected[k].sourceLine());
+        QVERIFY(actual[k].prefixRowAndHeader() == expected[k].prefixRowAndHeader());
+        QVERIFY(actual[k].rows() == expected[k].rows());
+    }
+    QVERIFY(reader.getWarnings() == wholeReader.getWarnings());
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_BlockFilter::test_reader_ids_data()
+{
+    QTest::addColumn<int>("threadCount");
+    QTest::addColumn<bool>("typed");
+    QTest::addColumn<bool>("stream");
+    QTest::addColumn<bool>("lazy");
+
+    QTest::newRow("serial") << 1 << false << false << false;
+    QTest::newRow("typed") << 1 << true << false << false;
+    QTest::newRow("parallel") << 4 << false << false << false;
+    QTest::newRow("stream") << 1 << false << true << false;
+    QTest::newRow("scan") << 1 << false << false << true;
+    QTest::newRow("parallel scan") << 4 << true << false << true;
+}
+
+void tst_BlockFilter::test_reader_ids()
+{
+    /* The rows of the rejected ids are skipped with their continuations,
+     * and the blocks left without row are dropped. */
+    // Given
+    QFETCH(int, threadCount);
+    QFETCH(bool, typed);
+    QFETCH(bool, stream);
+    QFETCH(bool, lazy);
+
+    std::string input;
+    while (input.size() < 3 * C_CHUNK_SIZE) {
+        input += content(500);
+    }
+    const char *begin = input.data();
+    const char *end = input.data() + input.size();
+
+    IdSet ids;
+    ids.insert(2);
+
+    BlockFilter filter;
+    filter.setIds(ids);
+
+    // When
+    std::vector<PunchBlock> actual;
+    Reader reader;
+    reader.setThreadCount(threadCount);
+    reader.setTyped(typed);
+    reader.setFilter(filter);
+    if (stream) {
+        std::istringstream iss(input);
+        reader.parsePUNCH(&iss, [&actual](PunchBlock &block) { actual.push_back(block); });
+    } else if (lazy) {
+        reader.scanPUNCH(begin, end, [&actual](PunchBlock &block) { actual.push_back(block); });
+    } else {
+        reader.parsePUNCH(begin, end, [&actual](PunchBlock &block) { actual.push_back(block); });
+    }
+
+    // Then
+    /* Only the grid 2 of the displacements, the forces have no row */
+    QVERIFY(!actual.empty());
+    QCOMPARE(static_cast<int>(actual.size()) % 500, 0);
+    for (const PunchBlock &block : actual) {
+        QCOMPARE(block.prefixRowAndHeader().count("ELEMENT TYPE"), std::size_t(0));
+        QCOMPARE(block.rowCount(), 1);
+        QCOMPARE(block.columnCount(), 7);
+        const std::list<PunchRow> rows = block.rows();
+        QCOMPARE(rows.size(), std::size_t(1));
+        QVERIFY(block.text(0, 0) == "2       G");
+        QVERIFY(block.text(0, 6) == "6.000000E+00");
+    }
+    QVERIFY(reader.getWarnings().empty());
+}
+
+QTEST_APPLESS_MAIN(tst_BlockFilter)
+
+#include "tst_blockfilter.moc"
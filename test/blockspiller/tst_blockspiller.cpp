@@ -0,0 +1,341 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <BlockSpiller.h>
+#include <PunchFile.h>
+#include <Reader.h>
+#include <Writer.h>
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class tst_BlockSpiller : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void test_writeUnique();
+    void test_writeUnique_data();
+    void test_writeUnique_same_headers();
+    void test_writeUnique_same_headers_data();
+    void test_headerSize();
+    void test_writeRun();
+    void test_append_punchfile();
+    void test_clear();
+
+private:
+    std::vector<PunchBlock> parse() const;
+    std::string readAll(const std::string &filename) const;
+    bool exists(const std::string &filename) const;
+};
+
+/******************************************************************************
+ ******************************************************************************/
+static const char s_prefix[] = "tst_blockspiller.csv";
+
+static const char s_punch[] =
+        /*<--- 18 char ---><---- 18 char ---><---- 18 char ---><---- 18 char ---><8char->*/
+        "$TITLE   =                                                                     1\n"
+        "$DISPLACEMENTS                                                                 2\n"
+        "$REAL OUTPUT                                                                   3\n"
+        "$SUBCASE ID =           1                                                      4\n"
+        "         1       G      1.000000E-06      0.000000E+00      0.000000E+00       5\n"
+        "-CONT-                  0.000000E+00      0.000000E+00      0.000000E+00       6\n"
+        "$TITLE   =                                                                     7\n"
+        "$ELEMENT FORCES                                                                8\n"
+        "$REAL OUTPUT                                                                   9\n"
+        "$SUBCASE ID =           1                                                     10\n"
+        "$ELEMENT TYPE =          12  ELAS2                                            11\n"
+        "      4000             -1.445403E+01                                          12\n"
+        "$TITLE   =                                                                    13\n"
+        "$DISPLACEMENTS                                                                14\n"
+        "$REAL OUTPUT                                                                  15\n"
+        "$SUBCASE ID =           2                                                     16\n"
+        "         2       G      1.000000E-06      0.000000E+00      0.000000E+00      17\n"
+        "-CONT-                  0.000000E+00      0.000000E+00      0.000000E+00      18\n"
+        "$TITLE   =                                                                    19\n"
+        "$ELEMENT FORCES                                                               20\n"
+        "$REAL OUTPUT                                                                  21\n"
+        "$SUBCASE ID =           1                                                     22\n"
+        "$ELEMENT TYPE =           2  BEAM                                             23\n"
+        "        10                10              0.000000E+00      5.066750E+03      24\n"
+        "$TITLE   =                                                                    25\n"
+        "$ELEMENT FORCES                                                               26\n"
+        "$REAL OUTPUT                                                                  27\n"
+        "$SUBCASE ID =           2                                                     28\n"
+        "$ELEMENT TYPE =          12  ELAS2                                            29\n"
+        "      4001              2.500000E+00                                          30\n"
+        "$TITLE   =                                                                    31\n"
+        "$DISPLACEMENTS                                                                32\n"
+        "$REAL OUTPUT                                                                  33\n"
+        "$SUBCASE ID =           3                                                     34\n"
+        "         3       G      1.000000E-06      0.000000E+00      0.000000E+00      35\n"
+        "-CONT-                  0.000000E+00      0.000000E+00      0.000000E+00      36\n";
+
+std::vector<PunchBlock> tst_BlockSpiller::parse() const
+{
+    std::stringstream buffer(s_punch);
+    std::vector<PunchBlock> blocks;
+    Reader reader;
+    reader.parsePUNCH(&buffer, [&blocks](PunchBlock &block) { blocks.push_back(block); });
+    return blocks;
+}
+
+std::string tst_BlockSpiller::readAll(const std::string &filename) const
+{
+    std::ifstream ifs(filename.c_str(), std::ios::binary);
+    std::stringstream buffer;
+    buffer << ifs.rdbuf();
+    return buffer.str();
+}
+
+bool tst_BlockSpiller::exists(const std::string &filename) const
+{
+    std::ifstream ifs(filename.c_str());
+    return ifs.is_open();
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_BlockSpiller::test_writeUnique_data()
+{
+    QTest::addColumn<QString>("columnHeaderLine");
+    QTest::addColumn<bool>("skipColumnHeaders");
+    QTest::addColumn<bool>("namedColumns");
+
+    QTest::newRow("default") << QString() << false << false;
+    QTest::newRow("skip header") << QString() << true << false;
+    QTest::newRow("named columns") << QString() << false << true;
+    /* Same header for all the formats: written once */
+    QTest::newRow("user-defined header") << QString("A;B;C") << false << false;
+}
+
+void tst_BlockSpiller::test_writeUnique()
+{
+    QFETCH(QString, columnHeaderLine);
+    QFETCH(bool, skipColumnHeaders);
+    QFETCH(bool, namedColumns);
+
+    const std::string header = columnHeaderLine.toStdString();
+    std::vector<PunchBlock> blocks = parse();
+    QCOMPARE(int(blocks.size()), 6);
+
+    /* Expected: the unique csv of the blocks grouped in memory */
+    PunchFile pch;
+    for (const PunchBlock &block : blocks) {
+        pch.append(block);
+    }
+    std::stringstream expected;
+    Writer writer(header, skipColumnHeaders, namedColumns);
+    for (const int keyId : pch.keyIds()) {
+        auto range = pch.blockRange(keyId);
+        for (auto it = range.first; it != range.second; ++it) {
+            QVERIFY(writer.writeCSV(*it, &expected));
+        }
+    }
+
+    BlockSpiller spiller(s_prefix, header, skipColumnHeaders, namedColumns);
+    QVERIFY(spiller.isEmpty());
+    for (PunchBlock &block : blocks) {
+        QVERIFY(spiller.append(block));
+    }
+    QVERIFY(!spiller.isEmpty());
+    QCOMPARE(spiller.keyIds().size(), pch.keyIds().size());
+
+    QVERIFY(spiller.writeUnique(s_prefix));
+    QCOMPARE(QString::fromStdString(readAll(s_prefix)),
+             QString::fromStdString(expected.str()));
+    std::remove(s_prefix);
+}
+
+void tst_BlockSpiller::test_writeUnique_same_headers_data()
+{
+    QTest::addColumn<bool>("skipColumnHeaders");
+
+    QTest::newRow("default") << false;
+    QTest::newRow("skip header") << true;
+}
+
+void tst_BlockSpiller::test_writeUnique_same_headers()
+{
+    QFETCH(bool, skipColumnHeaders);
+
+    /* Two formats (so two runs) with the same left headers:
+     * "A";"B";"unknown";"unknown"; */
+    std::vector<PunchBlock> blocks(2);
+    blocks[0].insertPrefix("A\";\"B", "1");
+    blocks[0].append(PunchRow{ "10", "11" });
+    blocks[1].insertPrefix("A", "2");
+    blocks[1].insertPrefix("B", "3");
+    blocks[1].append(PunchRow{ "20", "21" });
+
+    std::stringstream expected;
+    Writer writer(std::string(), skipColumnHeaders);
+    for (const PunchBlock &block : blocks) {
+        QVERIFY(writer.writeCSV(block, &expected));
+    }
+
+    BlockSpiller spiller(s_prefix, std::string(), skipColumnHeaders);
+    for (PunchBlock &block : blocks) {
+        QVERIFY(spiller.append(block));
+    }
+    QCOMPARE(int(spiller.keyIds().size()), 2);
+    QVERIFY(spiller.writeUnique(s_prefix));
+
+    /* The header of the second run isn't repeated */
+    const std::string actual = readAll(s_prefix);
+    std::remove(s_prefix);
+    QCOMPARE(QString::fromStdString(actual), QString::fromStdString(expected.str()));
+
+    const std::string header = "\"A\";\"B\";\"unknown\";\"unknown\";\n";
+    const std::size_t first = actual.find(header);
+    if (skipColumnHeaders) {
+        QVERIFY(first == std::string::npos);
+    } else {
+        QCOMPARE(int(first), 0);
+        QVERIFY(actual.find(header, first + 1) == std::string::npos);
+    }
+    QCOMPARE(int(std::count(actual.begin(), actual.end(), '\n')), skipColumnHeaders ? 2 : 3);
+}
+
+void tst_BlockSpiller::test_headerSize()
+{
+    std::vector<PunchBlock> blocks = parse();
+
+    /* Size of the header line, written once */
+    std::stringstream out;
+    Writer writer(std::string(), false);
+    QVERIFY(writer.writeCSV(blocks[0], &out));
+    std::string header;
+    std::getline(out, header);
+    QVERIFY(header.find("SUBCASE ID") != std::string::npos);
+    QCOMPARE(writer.headerSize(), header.size() + 1);
+
+    std::stringstream again;
+    QVERIFY(writer.writeCSV(blocks[0], &again));
+    QCOMPARE(int(writer.headerSize()), 0);
+    QVERIFY(again.str().find("SUBCASE ID") == std::string::npos);
+
+    /* No header */
+    std::stringstream skipped;
+    Writer skipWriter(std::string(), true);
+    QVERIFY(skipWriter.writeCSV(blocks[0], &skipped));
+    QCOMPARE(int(skipWriter.headerSize()), 0);
+    QVERIFY(skipped.str().find("SUBCASE ID") == std::string::npos);
+}
+
+void tst_BlockSpiller::test_writeRun()
+{
+    std::vector<PunchBlock> blocks = parse();
+
+    PunchFile pch;
+    for (const PunchBlock &block : blocks) {
+        pch.append(block);
+    }
+
+    BlockSpiller spiller(s_prefix, std::string(), false);
+    for (PunchBlock &block : blocks) {
+        QVERIFY(spiller.append(block));
+    }
+
+    /* Same key ids, so each run is the csv of a format */
+    for (const int keyId : spiller.keyIds()) {
+        std::stringstream expected;
+        Writer writer(std::string(), false);
+        auto range = pch.blockRange(keyId);
+        for (auto it = range.first; it != range.second; ++it) {
+            QVERIFY(writer.writeCSV(*it, &expected));
+        }
+
+        QVERIFY(spiller.writeRun(keyId, s_prefix));
+        QVERIFY(!exists(spiller.runFilename(keyId)));
+        QCOMPARE(QString::fromStdString(readAll(s_prefix)),
+                 QString::fromStdString(expected.str()));
+    }
+    std::remove(s_prefix);
+}
+
+void tst_BlockSpiller::test_append_punchfile()
+{
+    std::vector<PunchBlock> blocks = parse();
+
+    /* The first blocks are grouped in memory, then spilled */
+    PunchFile pch;
+    for (std::size_t i = 0; i < 3; ++i) {
+        pch.append(blocks[i]);
+    }
+    BlockSpiller spiller(s_prefix, std::string(), false);
+    QVERIFY(spiller.append(pch));
+    for (std::size_t i = 3; i < blocks.size(); ++i) {
+        QVERIFY(spiller.append(blocks[i]));
+    }
+    QVERIFY(spiller.writeUnique(s_prefix));
+
+    BlockSpiller all(std::string(s_prefix) + ".all", std::string(), false);
+    for (PunchBlock &block : blocks) {
+        QVERIFY(all.append(block));
+    }
+    const std::string filename = std::string(s_prefix) + ".all";
+    QVERIFY(all.writeUnique(filename));
+
+    QCOMPARE(QString::fromStdString(readAll(s_prefix)),
+             QString::fromStdString(readAll(filename)));
+    std::remove(s_prefix);
+    std::remove(filename.c_str());
+}
+
+void tst_BlockSpiller::test_clear()
+{
+    std::vector<PunchBlock> blocks = parse();
+    std::vector<std::string> runs;
+    std::string run;
+    {
+        BlockSpiller spiller(s_prefix, std::string(), false);
+        for (PunchBlock &block : blocks) {
+            QVERIFY(spiller.append(block));
+        }
+        QVERIFY(spiller.size() > 0);
+        for (const int keyId : spiller.keyIds()) {
+            runs.push_back(spiller.runFilename(keyId));
+            QVERIFY(exists(runs.back()));
+        }
+        spiller.clear();
+        QVERIFY(spiller.isEmpty());
+        QCOMPARE(int(spiller.size()), 0);
+        for (const std::string &filename : runs) {
+            QVERIFY(!exists(filename));
+        }
+
+        /* Removed by the destructor */
+        QVERIFY(spiller.append(blocks[0]));
+        run = spiller.runFilename(spiller.keyIds().front());
+        QVERIFY(exists(run));
+    }
+    QVERIFY(!exists(run));
+}
+
+QTEST_APPLESS_MAIN(tst_BlockSpiller)
+
+#include "tst_blockspiller.moc"
@@ -0,0 +1,216 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ComplexConverter.h>
+#include <PunchSchema.h>
+#include <Reader.h>
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+
+#include <cmath>
+#include <complex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class tst_ComplexConverter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void test_toPolar();
+    void test_roundTrip();
+
+    void test_pairs();
+    void test_polar();
+    void test_value();
+    void test_real_block_unchanged();
+    void test_lazy_blocks();
+
+private:
+    std::vector<PunchBlock> parse(const ComplexConverter::Mode mode);
+};
+
+/******************************************************************************
+ ******************************************************************************/
+static const char s_punch[] =
+        /*<--- 18 char ---><---- 18 char ---><---- 18 char ---><---- 18 char ---><8char->*/
+        "$TITLE   =                                                                     1\n"
+        "$DISPLACEMENTS                                                                 2\n"
+        "$REAL-IMAGINARY OUTPUT                                                         3\n"
+        "$SUBCASE ID =           1                                                      4\n"
+        "         1       G      1.000000E+00      2.000000E+00      3.000000E+00       5\n"
+        "-CONT-                  4.000000E+00      5.000000E+00      6.000000E+00       6\n"
+        "-CONT-                  0.000000E+00     -2.000000E+00      0                  7\n"
+        "-CONT-                  0.000000E+00      0.000000E+00      0.000000E+00       8\n"
+        "$TITLE   =                                                                     9\n"
+        "$DISPLACEMENTS                                                                10\n"
+        "$REAL OUTPUT                                                                  11\n"
+        "$SUBCASE ID =           1                                                     12\n"
+        "         1       G      1.000000E+00      2.000000E+00      3.000000E+00      13\n"
+        "-CONT-                  4.000000E+00      5.000000E+00      6.000000E+00      14\n";
+
+std::vector<PunchBlock> tst_ComplexConverter::parse(const ComplexConverter::Mode mode)
+{
+    std::stringstream buffer(s_punch);
+    std::vector<PunchBlock> blocks;
+    Reader reader;
+    reader.setComplexMode(mode);
+    reader.parsePUNCH(&buffer, [&blocks](PunchBlock &block) { blocks.push_back(block); });
+    return blocks;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_ComplexConverter::test_toPolar()
+{
+    const double real[]      = { 1.0, 0.0, -1.0,  0.0, 3.0 };
+    const double imaginary[] = { 0.0, 1.0,  0.0, -1.0, 4.0 };
+    double magnitude[5];
+    double phase[5];
+
+    ComplexConverter::toPolar(real, imaginary, magnitude, phase, 5);
+
+    QCOMPARE(magnitude[0], 1.0);
+    QCOMPARE(phase[0], 0.0);
+    QCOMPARE(phase[1], 90.0);
+    QCOMPARE(phase[2], 180.0);
+    QCOMPARE(phase[3], 270.0);
+    QCOMPARE(magnitude[4], 5.0);
+}
+
+void tst_ComplexConverter::test_roundTrip()
+{
+    std::vector<double> real;
+    std::vector<double> imaginary;
+    for (int i = -50; i < 50; ++i) {
+        real.push_back( 0.37 * i );
+        imaginary.push_back( 1.5 - 0.11 * i );
+    }
+    const std::size_t count = real.size();
+    std::vector<double> magnitude(count);
+    std::vector<double> phase(count);
+    std::vector<double> real2(count);
+    std::vector<double> imaginary2(count);
+
+    ComplexConverter::toPolar(real.data(), imaginary.data(), magnitude.data(), phase.data(), count);
+    ComplexConverter::toRectangular(magnitude.data(), phase.data(), real2.data(), imaginary2.data(), count);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        QVERIFY(phase[i] >= 0 && phase[i] < 360);
+        QVERIFY(std::fabs(real2[i] - real[i]) < 1e-12);
+        QVERIFY(std::fabs(imaginary2[i] - imaginary[i]) < 1e-12);
+    }
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_ComplexConverter::test_pairs()
+{
+    std::vector<PunchBlock> blocks = parse(ComplexConverter::Mode::Pairs);
+
+    QCOMPARE(int(blocks.size()), 2);
+    const PunchBlock &block = blocks[0];
+    QVERIFY(block.schema() == PunchSchema::find("DISPLACEMENTS", PunchSchema::RealImaginary, 0, true));
+    QCOMPARE(block.rowCount(), 1);
+    QCOMPARE(block.columnCount(), 13);
+
+    const char *expected[] = {
+        "1       G",
+        "1.000000E+00", "0.000000E+00",
+        "2.000000E+00", "-2.000000E+00",
+        "3.000000E+00", "0",
+        "4.000000E+00", "0.000000E+00",
+        "5.000000E+00", "0.000000E+00",
+        "6.000000E+00", "0.000000E+00"
+    };
+    for (int column = 0; column < 13; ++column) {
+        QCOMPARE(QString::fromStdString(block.text(0, column)), QString(expected[column]));
+    }
+}
+
+void tst_ComplexConverter::test_polar()
+{
+    std::vector<PunchBlock> blocks = parse(ComplexConverter::Mode::Polar);
+
+    const PunchBlock &block = blocks[0];
+    QVERIFY(block.schema() == PunchSchema::find("DISPLACEMENTS", PunchSchema::MagnitudePhase, 0, true));
+    QCOMPARE(block.columnCount(), 13);
+
+    /* T2 = 2 - 2i */
+    QCOMPARE(QString::fromStdString(block.text(0, 3)), QString("2.828427E+00"));
+    QCOMPARE(QString::fromStdString(block.text(0, 4)), QString("3.150000E+02"));
+    /* T3 = 3 + 0i, the integer part is decoded */
+    QCOMPARE(QString::fromStdString(block.text(0, 5)), QString("3.000000E+00"));
+    QCOMPARE(QString::fromStdString(block.text(0, 6)), QString("0.000000E+00"));
+}
+
+void tst_ComplexConverter::test_value()
+{
+    std::vector<PunchBlock> rectangular = parse(ComplexConverter::Mode::None);
+    std::vector<PunchBlock> pairs = parse(ComplexConverter::Mode::Pairs);
+    std::vector<PunchBlock> polar = parse(ComplexConverter::Mode::Polar);
+
+    for (int index = 0; index < 6; ++index) {
+        std::complex<double> a = ComplexConverter::value(pairs[0], 0, index);
+        std::complex<double> b = ComplexConverter::value(polar[0], 0, index);
+        QVERIFY(std::abs(a - b) < 1e-5);
+    }
+    QVERIFY(ComplexConverter::value(pairs[0], 0, 1) == std::complex<double>(2.0, -2.0));
+
+    /* Without conversion, the fields are text */
+    QVERIFY(ComplexConverter::value(rectangular[0], 0, 1) == std::complex<double>());
+}
+
+void tst_ComplexConverter::test_real_block_unchanged()
+{
+    std::vector<PunchBlock> blocks = parse(ComplexConverter::Mode::Polar);
+
+    const PunchBlock &block = blocks[1];
+    QVERIFY(block.schema() == PunchSchema::find("DISPLACEMENTS", PunchSchema::Real, 0));
+    QCOMPARE(block.columnCount(), 7);
+    QCOMPARE(QString::fromStdString(block.text(0, 1)), QString("1.000000E+00"));
+    QCOMPARE(int(block.value(0, 1).type), int(PunchValue::Text));
+}
+
+void tst_ComplexConverter::test_lazy_blocks()
+{
+    /* The schema of a lazy block is the one of the converted block */
+    std::vector<PunchBlock> expected = parse(ComplexConverter::Mode::Polar);
+    std::vector<PunchBlock> blocks;
+    Reader reader;
+    reader.setComplexMode(ComplexConverter::Mode::Polar);
+    reader.scanPUNCH(s_punch, s_punch + sizeof(s_punch) - 1,
+                     [&blocks](PunchBlock &block) { blocks.push_back(block); });
+
+    QCOMPARE(int(blocks.size()), 2);
+    QVERIFY(!blocks[0].isLoaded());
+    QVERIFY(blocks[0].schema() == expected[0].schema());
+    QVERIFY(blocks[1].schema() == expected[1].schema());
+    QCOMPARE(blocks[0].columnCount(), 13);
+
+    QCOMPARE(QString::fromStdString(blocks[0].text(0, 4)), QString("3.150000E+02"));
+    QVERIFY(blocks[0].isLoaded());
+    QVERIFY(blocks[0].schema() == expected[0].schema());
+    QVERIFY(blocks[0].rows() == expected[0].rows());
+}
+
+QTEST_APPLESS_MAIN(tst_ComplexConverter)
+
+#include "tst_complexconverter.moc"
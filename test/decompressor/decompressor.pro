@@ -0,0 +1,16 @@
+#isEmpty(TEMPLATE):TEMPLATE=app
+TARGET       = tst_decompressor
+CONFIG      += testcase
+QT           = core testlib
+SOURCES     += tst_decompressor.cpp
+
+# Include:
+INCLUDEPATH += ../../include
+
+# Libraries:
+DEFINES     += PCH2CSV_HAS_ZLIB
+LIBS        += -lz
+
+# Dependancies:
+HEADERS += ../../src/decompressor.h
+SOURCES += ../../src/decompressor.cpp
@@ -0,0 +1,227 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Decompressor.h>
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <zlib.h>
+
+using namespace std;
+
+class tst_Decompressor : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void test_detect();
+    void test_pass_through();
+    void test_gzip();
+    void test_gzip_data();
+    void test_gzip_lines();
+    void test_gzip_members();
+    void test_gzip_truncated();
+    void test_gzip_corrupted();
+
+private:
+    static std::string text(int size);
+    static std::string gzip(const std::string &input);
+};
+
+/******************************************************************************
+ ******************************************************************************/
+/* Returns punch-like lines of text. */
+std::string tst_Decompressor::text(const int size)
+{
+    std::string output;
+    int line = 0;
+    while (static_cast<int>(output.size()) < size) {
+        output += "      " + std::to_string(1000 + line) + "       G"
+                + "      1.234567E+00     -2.345678E-01      3.456789E-02"
+                + "       " + std::to_string(line) + "\n";
+        ++line;
+    }
+    output.resize(size);
+    return output;
+}
+
+/* Returns the gzip member of the given input. */
+std::string tst_Decompressor::gzip(const std::string &input)
+{
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(z_stream));
+    /* 16: gzip wrapper */
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+
+    std::string output(deflateBound(&stream, input.size()) + 32, '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = input.size();
+    stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+    stream.avail_out = output.size();
+    deflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    return output;
+}
+
+static std::string readAll(std::istream *stream)
+{
+    std::ostringstream output;
+    output << stream->rdbuf();
+    return output.str();
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_Decompressor::test_detect()
+{
+    QCOMPARE(Decompressor::detect("\x1F\x8B\x08", 3), Decompressor::Gzip);
+    QCOMPARE(Decompressor::detect("\x28\xB5\x2F\xFD", 4), Decompressor::Zstd);
+    QCOMPARE(Decompressor::detect("$TITLE", 6), Decompressor::None);
+    QCOMPARE(Decompressor::detect("\x1F", 1), Decompressor::None);
+    QCOMPARE(Decompressor::detect("", 0), Decompressor::None);
+
+    QVERIFY(Decompressor::isSupported(Decompressor::None));
+    QVERIFY(Decompressor::isSupported(Decompressor::Gzip));
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_Decompressor::test_pass_through()
+{
+    /* Data that isn't compressed is read as is. */
+    const std::string input = text(1000000);
+    std::stringstream source(input);
+
+    Decompressor decompressor(&source);
+    std::istream stream(&decompressor);
+
+    QCOMPARE(decompressor.format(), Decompressor::None);
+    QVERIFY(readAll(&stream) == input);
+    QVERIFY(!decompressor.hasError());
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_Decompressor::test_gzip_data()
+{
+    QTest::addColumn<int>("inputSize");
+    QTest::addColumn<int>("readSize");
+
+    QTest::newRow("empty") << 0 << 4096;
+    QTest::newRow("small") << 100 << 4096;
+    QTest::newRow("larger than a buffer") << 1000000 << 4096;
+    QTest::newRow("large reads") << 1000000 << 4*1024*1024;
+    QTest::newRow("tiny reads") << 10000 << 1;
+}
+
+void tst_Decompressor::test_gzip()
+{
+    // Given
+    QFETCH(int, inputSize);
+    QFETCH(int, readSize);
+
+    const std::string input = text(inputSize);
+    std::stringstream source(gzip(input));
+
+    // When
+    Decompressor decompressor(&source);
+    std::istream stream(&decompressor);
+
+    std::string actual;
+    std::string buffer(readSize, '\0');
+    while (stream.read(&buffer[0], readSize) || stream.gcount() > 0) {
+        actual.append(buffer.data(), stream.gcount());
+    }
+
+    // Then
+    QCOMPARE(decompressor.format(), Decompressor::Gzip);
+    QCOMPARE(actual.size(), input.size());
+    QVERIFY(actual == input);
+    QVERIFY(!decompressor.hasError());
+}
+
+void tst_Decompressor::test_gzip_lines()
+{
+    /* The stream can be read by lines too. */
+    const std::string input = text(1000000);
+    std::stringstream source(gzip(input));
+
+    Decompressor decompressor(&source);
+    std::istream stream(&decompressor);
+
+    std::string actual;
+    std::string line;
+    while (std::getline(stream, line)) {
+        actual += line + "\n";
+    }
+    actual.resize(input.size());
+
+    QVERIFY(actual == input);
+    QVERIFY(!decompressor.hasError());
+}
+
+void tst_Decompressor::test_gzip_members()
+{
+    /* Concatenated gzip files are read in turn (like 'cat a.gz b.gz'). */
+    const std::string first = text(300000);
+    const std::string second = text(5000);
+    std::stringstream source(gzip(first) + gzip(second) + gzip(first));
+
+    Decompressor decompressor(&source);
+    std::istream stream(&decompressor);
+
+    QVERIFY(readAll(&stream) == first + second + first);
+    QVERIFY(!decompressor.hasError());
+}
+
+void tst_Decompressor::test_gzip_truncated()
+{
+    const std::string input = text(1000000);
+    const std::string compressed = gzip(input);
+    std::stringstream source(compressed.substr(0, compressed.size() / 2));
+
+    Decompressor decompressor(&source);
+    std::istream stream(&decompressor);
+
+    const std::string actual = readAll(&stream);
+    QVERIFY(actual.size() < input.size());
+    QVERIFY(input.compare(0, actual.size(), actual) == 0);
+    QVERIFY(decompressor.hasError());
+}
+
+void tst_Decompressor::test_gzip_corrupted()
+{
+    std::string compressed = gzip(text(100000));
+    for (std::size_t i = 20; i < 200; ++i) {
+        compressed[i] = static_cast<char>(0xFF);
+    }
+    std::stringstream source(compressed);
+
+    Decompressor decompressor(&source);
+    std::istream stream(&decompressor);
+    readAll(&stream);
+
+    QVERIFY(decompressor.hasError());
+}
+
+QTEST_APPLESS_MAIN(tst_Decompressor)
+
+#include "tst_decompressor.moc"
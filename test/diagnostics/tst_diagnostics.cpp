@@ -0,0 +1,208 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Diagnostics.h>
+#include <Reader.h>
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class tst_Diagnostics : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void test_counters();
+    void test_records_limit();
+    void test_merge();
+    void test_format();
+    void test_json();
+    void test_reader();
+    void test_reader_many_short_lines();
+
+private:
+    static std::string shortLines(const int count);
+};
+
+/******************************************************************************
+ ******************************************************************************/
+/* Returns a header followed by \a count lines too short to be records. */
+std::string tst_Diagnostics::shortLines(const int count)
+{
+    std::string content =
+        "$TITLE   = MY FEA MODEL                                                        1\n";
+    for (int i = 0; i < count; ++i) {
+        content += "1 2 3\n";
+    }
+    return content;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_Diagnostics::test_counters()
+{
+    Diagnostics diagnostics;
+    QCOMPARE(diagnostics.count(), 0LL);
+
+    diagnostics.report(Diagnostic::LineLength, 3, 160);
+    diagnostics.report(Diagnostic::LineLength, 5, 320);
+    diagnostics.report(Diagnostic::OrphanContinuation, 8, 561);
+
+    QCOMPARE(diagnostics.count(), 3LL);
+    QCOMPARE(diagnostics.count(Diagnostic::LineLength), 2LL);
+    QCOMPARE(diagnostics.count(Diagnostic::MissingHeader), 0LL);
+    QCOMPARE(diagnostics.count(Diagnostic::OrphanContinuation), 1LL);
+
+    QCOMPARE(diagnostics.recordCount(), 3);
+    QCOMPARE(diagnostics.at(1).category, Diagnostic::LineLength);
+    QCOMPARE(diagnostics.at(1).line, 5);
+    QCOMPARE(diagnostics.at(1).offset, std::size_t(320));
+
+    diagnostics.clear();
+    QCOMPARE(diagnostics.count(), 0LL);
+    QCOMPARE(diagnostics.recordCount(), 0);
+}
+
+void tst_Diagnostics::test_records_limit()
+{
+    /* The records are limited, but the counters are exact. */
+    Diagnostics diagnostics;
+    const int count = C_DIAGNOSTIC_RECORDS_SIZE + 1000;
+    for (int i = 0; i < count; ++i) {
+        diagnostics.report(Diagnostic::MissingHeader, i + 1, i * 81);
+    }
+    QCOMPARE(diagnostics.count(), static_cast<long long>(count));
+    QCOMPARE(diagnostics.count(Diagnostic::MissingHeader), static_cast<long long>(count));
+    QCOMPARE(diagnostics.recordCount(), C_DIAGNOSTIC_RECORDS_SIZE);
+}
+
+void tst_Diagnostics::test_merge()
+{
+    Diagnostics first;
+    first.report(Diagnostic::LineLength, 2, 81);
+
+    Diagnostics second;
+    second.report(Diagnostic::MissingHeader, 1, 810);
+    second.report(Diagnostic::LineLength, 4, 1053);
+
+    first.merge(second, 10);
+
+    QCOMPARE(first.count(), 3LL);
+    QCOMPARE(first.count(Diagnostic::LineLength), 2LL);
+    QCOMPARE(first.recordCount(), 3);
+    QCOMPARE(first.at(1).line, 11);
+    QCOMPARE(first.at(1).offset, std::size_t(810));
+    QCOMPARE(first.at(2).line, 14);
+}
+
+void tst_Diagnostics::test_format()
+{
+    Diagnostic diagnostic;
+    diagnostic.category = Diagnostic::LineLength;
+    diagnostic.line = 42;
+    diagnostic.offset = 0;
+    QCOMPARE(Diagnostics::format(diagnostic),
+             std::string("[Warning] line 42: The line must be 80 characters long."));
+}
+
+void tst_Diagnostics::test_json()
+{
+    Diagnostics diagnostics;
+    diagnostics.report(Diagnostic::OrphanContinuation, 7, 486);
+
+    std::ostringstream stream;
+    diagnostics.writeJson(stream, "dir\\\"model\".pch");
+
+    const std::string expected =
+            "{\n"
+            "  \"file\": \"dir\\\\\\\"model\\\".pch\",\n"
+            "  \"count\": 1,\n"
+            "  \"categories\": {\"line-length\": 0, \"missing-header\": 0, \"orphan-continuation\": 1},\n"
+            "  \"recorded\": 1,\n"
+            "  \"diagnostics\": [\n"
+            "    {\"category\": \"orphan-continuation\", \"line\": 7, \"offset\": 486, "
+            "\"message\": \"A continued -CONT- field shouldn't starts a new block.\"}\n"
+            "  ]\n"
+            "}";
+    QCOMPARE(stream.str(), expected);
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_Diagnostics::test_reader()
+{
+    /* The diagnostics give the category, the line and the offset. */
+    const std::string content =
+        /*<--- 18 char ---><---- 18 char ---><---- 18 char ---><---- 18 char ---><8char->*/
+        "     12345          80004230        BAR                                        1\n"
+        "$TITLE   = MY FEA MODEL                                                        2\n"
+        "-> not a valid Punch line\n"
+        "-CONT-                 5.000000E+00      6.000000E+00                          3\n";
+
+    Reader reader;
+    reader.parsePUNCH(content.data(), content.data() + content.size());
+    const Diagnostics &diagnostics = reader.diagnostics();
+
+    QCOMPARE(diagnostics.recordCount(), 3);
+    QCOMPARE(diagnostics.at(0).category, Diagnostic::MissingHeader);
+    QCOMPARE(diagnostics.at(0).line, 1);
+    QCOMPARE(diagnostics.at(0).offset, std::size_t(0));
+    QCOMPARE(diagnostics.at(1).category, Diagnostic::LineLength);
+    QCOMPARE(diagnostics.at(1).line, 3);
+    QCOMPARE(diagnostics.at(1).offset, std::size_t(162));
+    QCOMPARE(diagnostics.at(2).category, Diagnostic::OrphanContinuation);
+    QCOMPARE(diagnostics.at(2).line, 4);
+    QCOMPARE(diagnostics.at(2).offset, std::size_t(188));
+}
+
+void tst_Diagnostics::test_reader_many_short_lines()
+{
+    /* The counters aren't limited, in serial, parallel and stream parse. */
+    const int count = 200000;
+    const std::string content = shortLines(count);
+
+    Reader serialReader;
+    serialReader.parsePUNCH(content.data(), content.data() + content.size());
+
+    Reader parallelReader;
+    parallelReader.setThreadCount(4);
+    parallelReader.parsePUNCH(content.data(), content.data() + content.size());
+
+    std::stringstream stream(content);
+    Reader streamReader;
+    streamReader.parsePUNCH(&stream);
+
+    QCOMPARE(serialReader.diagnostics().count(Diagnostic::LineLength), static_cast<long long>(count));
+    QCOMPARE(parallelReader.diagnostics().count(), serialReader.diagnostics().count());
+    QCOMPARE(streamReader.diagnostics().count(), serialReader.diagnostics().count());
+    const int last = C_DIAGNOSTIC_RECORDS_SIZE - 1;
+    QCOMPARE(streamReader.diagnostics().at(last).offset,
+             serialReader.diagnostics().at(last).offset);
+
+    /* The messages are still limited */
+    const std::vector<std::string> warnings = serialReader.getWarnings();
+    QCOMPARE(static_cast<int>(warnings.size()), C_ERROR_MESSAGES_SIZE + 1);
+    QCOMPARE(warnings.back(), std::string("[Warning] Too many errors... (200000 warnings in total)"));
+}
+
+QTEST_APPLESS_MAIN(tst_Diagnostics)
+
+#include "tst_diagnostics.moc"
@@ -0,0 +1,254 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <FileFollower.h>
+#include <PunchFile.h>
+#include <Reader.h>
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+#include <algorithm>
+#include <cstdio>   // std::remove()
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const char C_FOLLOWED_FILE[] = "tst_filefollower.pch";
+static const char C_STATE_FILE[] = "tst_filefollower.pchpos";
+
+class tst_FileFollower : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void test_state_filename();
+    void test_save_and_load_state();
+    void test_last_block_start();
+    void test_parse_by_steps();
+    void test_wait();
+    void test_written();
+
+private:
+    static std::string content();
+};
+
+/******************************************************************************
+ ******************************************************************************/
+std::string tst_FileFollower::content()
+{
+    return
+        /*<--- 18 char ---><---- 18 char ---><---- 18 char ---><---- 18 char ---><8char->*/
+        "-> not a valid Punch line\n"
+        "$TITLE   = MY FEA MODEL                                                        1\n"
+        "$SUBCASE ID =         1                                                        2\n"
+        "     12345          80004230        BAR                                        3\n"
+        "     12346          80004231        BAR                                        4\n"
+        "$TITLE   = MY FEA MODEL                                                        5\n"
+        "$SUBCASE ID =         2                                                        6\n"
+        "$DISPLACEMENTS                                                                 7\n"
+        "         1       G      1.000000E+00      2.000000E+00      3.000000E+00       8\n"
+        "-CONT-                  4.000000E+00      5.000000E+00      6.000000E+00       9\n"
+        "$TITLE   = MY FEA MODEL                                                       10\n"
+        "$SUBCASE ID =         3                                                       11\n"
+        "     12347          80004232                                                  12\n";
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_FileFollower::test_state_filename()
+{
+    QCOMPARE(QString::fromStdString(FileFollower::stateFilename("model.pch")), QString("model.pchpos"));
+    QCOMPARE(QString::fromStdString(FileFollower::stateFilename("dir.v2/MODEL.PCH")), QString("dir.v2/MODEL.pchpos"));
+    QCOMPARE(QString::fromStdString(FileFollower::stateFilename("dir.v2/model")), QString("dir.v2/model.pchpos"));
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_FileFollower::test_save_and_load_state()
+{
+    // Given
+    FollowState state;
+    state.offset = 123456789012ULL;
+    state.line = 42;
+    state.output = "dir/model.csv";
+    state.headers = "\"SUBCASE ID\";\"unknown\";\"unknown\";";
+
+    // When
+    QVERIFY(FileFollower::saveState(C_STATE_FILE, state));
+    FollowState loaded;
+    const bool ok = FileFollower::loadState(C_STATE_FILE, &loaded);
+    std::remove(C_STATE_FILE);
+
+    // Then
+    QVERIFY(ok);
+    QCOMPARE(loaded.offset, state.offset);
+    QCOMPARE(loaded.line, state.line);
+    QCOMPARE(QString::fromStdString(loaded.output), QString::fromStdString(state.output));
+    QCOMPARE(QString::fromStdString(loaded.headers), QString::fromStdString(state.headers));
+
+    /* A missing or invalid state isn't loaded */
+    QVERIFY(!FileFollower::loadState(C_STATE_FILE, &loaded));
+    {
+        std::ofstream ofs(C_STATE_FILE);
+        ofs << "PCHPOS 0\n1 1\nmodel.csv\n\n";
+    }
+    QVERIFY(!FileFollower::loadState(C_STATE_FILE, &loaded));
+    std::remove(C_STATE_FILE);
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_FileFollower::test_last_block_start()
+{
+    const std::string input = content();
+    const char *begin = input.data();
+    const char *end = input.data() + input.size();
+
+    /* The first header doesn't follow a record: no complete block */
+    QVERIFY(Reader::lastBlockStart(begin, begin, begin + 26 + 4 * 81) == begin);
+
+    /* The blocks before the line 6 are complete */
+    QVERIFY(Reader::lastBlockStart(begin, begin, begin + 26 + 9 * 81) == begin + 26 + 4 * 81);
+    QVERIFY(Reader::lastBlockStart(begin, begin, end) == begin + 26 + 9 * 81);
+
+    /* The search starts at the line of 'from' */
+    QVERIFY(Reader::lastBlockStart(begin + 26 + 5 * 81, begin, begin + 26 + 9 * 81) == begin);
+    QVERIFY(Reader::lastBlockStart(begin + 26 + 8 * 81 + 10, begin, end) == begin + 26 + 9 * 81);
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_FileFollower::test_parse_by_steps()
+{
+    /* The input is parsed by steps, like a file that grows.
+     * The result must be the same as the whole input. */
+    // Given
+    std::string input = content();
+    for (int i = 0; i < 200; ++i) {
+        input += content();
+    }
+    const char *begin = input.data();
+    const char *end = input.data() + input.size();
+
+    std::vector<PunchBlock> expected;
+    Reader wholeReader;
+    wholeReader.parsePUNCH(begin, end, [&expected](PunchBlock &block) { expected.push_back(block); });
+
+    // When
+    std::vector<PunchBlock> actual;
+    Diagnostics diagnostics;
+    std::size_t offset = 0;
+    int line = 0;
+    std::size_t size = 0;
+    while (offset < input.size()) {
+        size = std::min(input.size(), size + 1000);
+        const char *from = begin + offset;
+        const char *complete = begin + size;
+        while (complete > from && complete[-1] != '\n') {
+            --complete;
+        }
+        const char *cut = (size == input.size())
+                ? end
+                : Reader::lastBlockStart(from, from, complete);
+        if (cut == from) {
+            continue;
+        }
+        Reader reader;
+        reader.setOrigin(offset, line);
+        reader.parsePUNCH(from, cut, [&actual](PunchBlock &block) { actual.push_back(block); });
+        diagnostics.merge(reader.diagnostics(), 0);
+        line += std::count(from, cut, '\n');
+        offset = cut - begin;
+    }
+
+    // Then
+    QCOMPARE(actual.size(), expected.size());
+    for (std::size_t k = 0; k < actual.size(); ++k) {
+        QCOMPARE(actual[k].sourceOffset(), expected[k].sourceOffset());
+        QCOMPARE(actual[k].sourceLine(), expected[k].sourceLine());
+        QVERIFY(actual[k].prefixRowAndHeader() == expected[k].prefixRowAndHeader());
+        QVERIFY(actual[k].rows() == expected[k].rows());
+    }
+    const Diagnostics &expectedDiagnostics = wholeReader.diagnostics();
+    QCOMPARE(diagnostics.recordCount(), expectedDiagnostics.recordCount());
+    for (int k = 0; k < diagnostics.recordCount(); ++k) {
+        QCOMPARE(diagnostics.at(k).category, expectedDiagnostics.at(k).category);
+        QCOMPARE(diagnostics.at(k).line, expectedDiagnostics.at(k).line);
+        QCOMPARE(diagnostics.at(k).offset, expectedDiagnostics.at(k).offset);
+    }
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_FileFollower::test_wait()
+{
+#if defined(Q_OS_LINUX)
+    std::ofstream(C_FOLLOWED_FILE).close();
+
+    FileFollower follower;
+    QVERIFY(follower.open(C_FOLLOWED_FILE));
+    QCOMPARE(follower.wait(0), FileFollower::Timeout);
+
+    std::ofstream ofs(C_FOLLOWED_FILE, std::ios::app);
+    ofs << content();
+    ofs.flush();
+    QCOMPARE(follower.wait(1000), FileFollower::Modified);
+
+    ofs.close();
+    QCOMPARE(follower.wait(1000), FileFollower::Closed);
+
+    std::remove(C_FOLLOWED_FILE);
+    QCOMPARE(follower.wait(1000), FileFollower::Removed);
+#else
+    QSKIP("The files are watched with inotify on Linux only.");
+#endif
+}
+
+void tst_FileFollower::test_written()
+{
+#if defined(Q_OS_LINUX)
+    /* Already closed: no Closed event will come */
+    std::ofstream(C_FOLLOWED_FILE) << content();
+
+    FileFollower follower;
+    QVERIFY(follower.open(C_FOLLOWED_FILE));
+    QVERIFY(!follower.isWritten());
+
+    {
+        std::ifstream reader(C_FOLLOWED_FILE);
+        QVERIFY(reader.is_open());
+        QVERIFY(!follower.isWritten());     /* Readers don't count */
+    }
+
+    std::ofstream writer(C_FOLLOWED_FILE, std::ios::app);
+    QVERIFY(writer.is_open());
+    QVERIFY(follower.isWritten());
+
+    writer.close();
+    QVERIFY(!follower.isWritten());
+
+    follower.close();
+    std::remove(C_FOLLOWED_FILE);
+#else
+    QSKIP("The writers are known on Linux only.");
+#endif
+}
+
+QTEST_APPLESS_MAIN(tst_FileFollower)
+
+#include "tst_filefollower.moc"
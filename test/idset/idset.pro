@@ -0,0 +1,12 @@
+#isEmpty(TEMPLATE):TEMPLATE=app
+TARGET       = tst_idset
+CONFIG      += testcase
+QT           = core testlib
+SOURCES     += tst_idset.cpp
+
+# Include:
+INCLUDEPATH += ../../include
+
+# Dependancies:
+HEADERS += ../../src/idset.h
+SOURCES += ../../src/idset.cpp
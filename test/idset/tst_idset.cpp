@@ -0,0 +1,217 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <IdSet.h>
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+#include <cstdint>
+#include <set>
+#include <string>
+
+using namespace std;
+
+class tst_IdSet : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void test_empty();
+    void test_insert();
+    void test_insert_bitmap();
+    void test_insert_range();
+    void test_parse();
+    void test_parse_invalid();
+    void test_parse_invalid_data();
+    void test_parseId();
+    void test_parseId_data();
+};
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_IdSet::test_empty()
+{
+    IdSet ids;
+    QVERIFY(ids.isEmpty());
+    QCOMPARE(ids.count(), std::size_t(0));
+    QVERIFY(!ids.contains(0));
+    QVERIFY(!ids.contains(1));
+
+    ids.insert(1);
+    QVERIFY(!ids.isEmpty());
+    ids.clear();
+    QVERIFY(ids.isEmpty());
+    QVERIFY(!ids.contains(1));
+}
+
+void tst_IdSet::test_insert()
+{
+    IdSet ids;
+    ids.insert(3);
+    ids.insert(1);
+    ids.insert(70000);
+    ids.insert(2);
+    ids.insert(3);
+    ids.insert(4294967295u);
+
+    QCOMPARE(ids.count(), std::size_t(5));
+    QVERIFY(!ids.contains(0));
+    QVERIFY(ids.contains(1));
+    QVERIFY(ids.contains(2));
+    QVERIFY(ids.contains(3));
+    QVERIFY(!ids.contains(4));
+    QVERIFY(!ids.contains(3 + 65536));
+    QVERIFY(ids.contains(70000));
+    QVERIFY(ids.contains(4294967295u));
+    QVERIFY(!ids.contains(4294967294u));
+}
+
+void tst_IdSet::test_insert_bitmap()
+{
+    /* A large group of scattered ids becomes a bitmap */
+    // Given
+    std::set<std::uint32_t> expected;
+    std::uint32_t seed = 12345;
+    for (int i = 0; i < 20000; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        expected.insert( (seed >> 8) % 200000 );
+    }
+
+    // When
+    IdSet ids;
+    for (const std::uint32_t id : expected) {
+        ids.insert(id);
+    }
+    for (const std::uint32_t id : expected) {
+        ids.insert(id);
+    }
+
+    // Then
+    QCOMPARE(ids.count(), expected.size());
+    for (std::uint32_t id = 0; id < 210000; ++id) {
+        QCOMPARE(ids.contains(id), expected.count(id) == 1);
+    }
+}
+
+void tst_IdSet::test_insert_range()
+{
+    IdSet ids;
+    ids.insert(10, 20);
+    ids.insert(15, 25);
+    ids.insert(65530, 131080);
+    ids.insert(30, 29); // empty range
+    ids.insert(4294967290u, 4294967295u);
+
+    QCOMPARE(ids.count(), std::size_t(16 + 65551 + 6));
+    QVERIFY(!ids.contains(9));
+    QVERIFY(ids.contains(10));
+    QVERIFY(ids.contains(25));
+    QVERIFY(!ids.contains(26));
+    QVERIFY(!ids.contains(29));
+    QVERIFY(!ids.contains(30));
+    QVERIFY(!ids.contains(65529));
+    QVERIFY(ids.contains(65530));
+    QVERIFY(ids.contains(65536));
+    QVERIFY(ids.contains(131071));
+    QVERIFY(ids.contains(131080));
+    QVERIFY(!ids.contains(131081));
+    QVERIFY(ids.contains(4294967295u));
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_IdSet::test_parse()
+{
+    IdSet ids;
+    QVERIFY(ids.parse("# Grids\n"
+                      "1001, 1003\n"
+                      "\n"
+                      "2000-2009   # Wing\n"
+                      "3000 THRU 3004, 4000 thru 4001\n"
+                      "5000\t5001"));
+
+    QCOMPARE(ids.count(), std::size_t(2 + 10 + 5 + 2 + 2));
+    QVERIFY(ids.contains(1001));
+    QVERIFY(!ids.contains(1002));
+    QVERIFY(ids.contains(1003));
+    QVERIFY(ids.contains(2009));
+    QVERIFY(!ids.contains(2010));
+    QVERIFY(ids.contains(3004));
+    QVERIFY(ids.contains(4001));
+    QVERIFY(ids.contains(5001));
+}
+
+void tst_IdSet::test_parse_invalid_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<int>("errorLine");
+
+    QTest::newRow("text") << "1\nGRID\n" << 2;
+    QTest::newRow("negative") << "-1" << 1;
+    QTest::newRow("real") << "1.5" << 1;
+    QTest::newRow("reversed range") << "1\n2\n20-10" << 3;
+    QTest::newRow("open range") << "10-" << 1;
+    QTest::newRow("open thru") << "10 THRU" << 1;
+    QTest::newRow("overflow") << "4294967296" << 1;
+}
+
+void tst_IdSet::test_parse_invalid()
+{
+    QFETCH(QString, text);
+    QFETCH(int, errorLine);
+
+    IdSet ids;
+    int actual = 0;
+    QVERIFY(!ids.parse(text.toStdString(), &actual));
+    QCOMPARE(actual, errorLine);
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_IdSet::test_parseId_data()
+{
+    QTest::addColumn<QString>("field");
+    QTest::addColumn<bool>("valid");
+    QTest::addColumn<uint>("id");
+
+    QTest::newRow("element") << "3000" << true << 3000u;
+    QTest::newRow("grid") << "2001       G" << true << 2001u;
+    QTest::newRow("blanks") << "    42    " << true << 42u;
+    QTest::newRow("max") << "4294967295" << true << 4294967295u;
+    QTest::newRow("empty") << "" << false << 0u;
+    QTest::newRow("text") << "FREQ" << false << 0u;
+    QTest::newRow("real") << "1.000000E+00" << false << 0u;
+    QTest::newRow("negative") << "-5" << false << 0u;
+    QTest::newRow("overflow") << "4294967296" << false << 0u;
+}
+
+void tst_IdSet::test_parseId()
+{
+    QFETCH(QString, field);
+    QFETCH(bool, valid);
+    QFETCH(uint, id);
+
+    const std::string text = field.toStdString();
+    std::uint32_t actual = 0;
+    QCOMPARE(IdSet::parseId(text.data(), text.data() + text.size(), &actual), valid);
+    if (valid) {
+        QCOMPARE(actual, static_cast<std::uint32_t>(id));
+    }
+}
+
+QTEST_APPLESS_MAIN(tst_IdSet)
+
+#include "tst_idset.moc"
@@ -0,0 +1,13 @@
+#isEmpty(TEMPLATE):TEMPLATE=app
+TARGET       = tst_inputpipeline
+CONFIG      += testcase
+CONFIG      += thread
+QT           = core testlib
+SOURCES     += tst_inputpipeline.cpp
+
+# Include:
+INCLUDEPATH += ../../include
+
+# Dependancies:
+HEADERS += ../../src/inputpipeline.h
+SOURCES += ../../src/inputpipeline.cpp
@@ -0,0 +1,120 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <InputPipeline.h>
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+class tst_InputPipeline : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void test_empty();
+    void test_buffers();
+    void test_buffers_data();
+    void test_stop_before_the_end();
+};
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_InputPipeline::test_empty()
+{
+    std::stringstream buffer;
+    InputPipeline pipeline(&buffer);
+    const char *data;
+    std::size_t size;
+    QVERIFY(!pipeline.next(&data, &size));
+    QVERIFY(!pipeline.next(&data, &size));
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_InputPipeline::test_buffers_data()
+{
+    QTest::addColumn<int>("inputSize");
+    QTest::addColumn<int>("bufferSize");
+    QTest::addColumn<int>("bufferCount");
+
+    QTest::newRow("smaller than a buffer") << 100 << 4096 << 2;
+    QTest::newRow("exactly a buffer") << 4096 << 4096 << 2;
+    QTest::newRow("several buffers") << 100000 << 4096 << 2;
+    QTest::newRow("unaligned size") << 100000 << 81 << 2;
+    QTest::newRow("ring of 3") << 100000 << 1000 << 3;
+    QTest::newRow("tiny buffers") << 1000 << 1 << 2;
+}
+
+void tst_InputPipeline::test_buffers()
+{
+    /* The buffers must give the whole stream, in the order. */
+    // Given
+    QFETCH(int, inputSize);
+    QFETCH(int, bufferSize);
+    QFETCH(int, bufferCount);
+
+    std::string input;
+    for (int i = 0; i < inputSize; ++i) {
+        input += static_cast<char>('A' + (i * 7) % 26);
+    }
+    std::stringstream buffer(input);
+
+    // When
+    std::string actual;
+    int count = 0;
+    bool aligned = true;
+    bool sized = true;
+    {
+        InputPipeline pipeline(&buffer, bufferSize, bufferCount);
+        const char *data;
+        std::size_t size;
+        while (pipeline.next(&data, &size)) {
+            aligned &= (reinterpret_cast<std::uintptr_t>(data) % C_READ_BUFFER_ALIGNMENT == 0);
+            sized &= (size > 0 && size <= static_cast<std::size_t>(bufferSize));
+            actual.append(data, size);
+            ++count;
+        }
+    }
+
+    // Then
+    QVERIFY(actual == input);
+    QCOMPARE(count, (inputSize + bufferSize - 1) / bufferSize);
+    QVERIFY(aligned);
+    QVERIFY(sized);
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_InputPipeline::test_stop_before_the_end()
+{
+    /* The I/O thread must stop, even if the buffers are not all consumed. */
+    std::stringstream buffer(std::string(100000, 'A'));
+    InputPipeline pipeline(&buffer, 100, 2);
+    const char *data;
+    std::size_t size;
+    QVERIFY(pipeline.next(&data, &size));
+    QCOMPARE(size, std::size_t(100));
+}
+
+QTEST_APPLESS_MAIN(tst_InputPipeline)
+
+#include "tst_inputpipeline.moc"
@@ -0,0 +1,12 @@
+#isEmpty(TEMPLATE):TEMPLATE=app
+TARGET       = tst_numberparser
+CONFIG      += testcase
+QT           = core testlib
+SOURCES     += tst_numberparser.cpp
+
+# Include:
+INCLUDEPATH += ../../include
+
+# Dependancies:
+HEADERS += ../../src/numberparser.h
+SOURCES += ../../src/numberparser.cpp
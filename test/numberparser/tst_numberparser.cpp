@@ -0,0 +1,188 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <NumberParser.h>
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+class tst_NumberParser : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void test_parseInteger();
+    void test_parseInteger_data();
+
+    void test_parseReal();
+    void test_parseReal_data();
+
+    void test_roundTrip();
+
+};
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_NumberParser::test_parseInteger_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<bool>("expected");
+    QTest::addColumn<qint64>("value");
+
+    QTest::newRow("zero") << "0" << true << qint64(0);
+    QTest::newRow("id") << "80004230" << true << qint64(80004230);
+    QTest::newRow("negative") << "-12" << true << qint64(-12);
+    QTest::newRow("max") << "999999999999999999" << true << qint64(999999999999999999LL);
+
+    QTest::newRow("empty") << "" << false << qint64(0);
+    QTest::newRow("minus") << "-" << false << qint64(0);
+    QTest::newRow("plus") << "+12" << false << qint64(0);
+    QTest::newRow("leading zero") << "012" << false << qint64(0);
+    QTest::newRow("negative zero") << "-0" << false << qint64(0);
+    QTest::newRow("too long") << "1234567890123456789" << false << qint64(0);
+    QTest::newRow("real") << "1.600000E+00" << false << qint64(0);
+    QTest::newRow("text") << "BAR" << false << qint64(0);
+    QTest::newRow("blank") << "12 34" << false << qint64(0);
+}
+
+void tst_NumberParser::test_parseInteger()
+{
+    // Given
+    QFETCH(QString, text);
+    QFETCH(bool, expected);
+    QFETCH(qint64, value);
+    std::string _text = text.toStdString();
+
+    // When
+    long long actual = 0;
+    bool ok = NumberParser::parseInteger(_text.data(), _text.data() + _text.size(), &actual);
+
+    // Then
+    QCOMPARE(ok, expected);
+    if (ok) {
+        QCOMPARE(qint64(actual), value);
+        QCOMPARE(QString::fromStdString(NumberParser::formatInteger(actual)), text);
+    }
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_NumberParser::test_parseReal_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<bool>("expected");
+    QTest::addColumn<double>("value");
+
+    QTest::newRow("positive") << "4.462737E-06" << true << 4.462737E-06;
+    QTest::newRow("negative") << "-1.600000E+00" << true << -1.600000E+00;
+    QTest::newRow("large") << "3.060709E+06" << true << 3.060709E+06;
+    QTest::newRow("zero") << "0.000000E+00" << true << 0.0;
+    QTest::newRow("negative zero") << "-0.000000E+00" << true << -0.0;
+    QTest::newRow("tiny") << "1.234567E-30" << true << 1.234567E-30;
+    QTest::newRow("huge") << "9.876543E+250" << true << 9.876543E+250;
+    QTest::newRow("precision") << "1.2345678901234E+03" << true << 1.2345678901234E+03;
+    QTest::newRow("short") << "2.5E+01" << true << 25.0;
+    QTest::newRow("max") << "1.797693E+308" << true << 1.797693E+308;
+    QTest::newRow("min normal") << "2.225074E-308" << true << 2.225074E-308;
+
+    QTest::newRow("empty") << "" << false << 0.0;
+    QTest::newRow("integer") << "12" << false << 0.0;
+    QTest::newRow("no exponent") << "1.600000" << false << 0.0;
+    QTest::newRow("no exponent sign") << "-2.9784151+04" << false << 0.0;
+    QTest::newRow("lowercase") << "1.600000e+00" << false << 0.0;
+    QTest::newRow("no fraction") << "1.E+00" << false << 0.0;
+    QTest::newRow("not normalized") << "0.123456E+00" << false << 0.0;
+    QTest::newRow("null exponent") << "0.000000E+05" << false << 0.0;
+    QTest::newRow("minus zero exponent") << "1.000000E-00" << false << 0.0;
+    QTest::newRow("1-digit exponent") << "1.000000E+5" << false << 0.0;
+    QTest::newRow("3-digit exponent") << "1.000000E+005" << false << 0.0;
+    QTest::newRow("plus") << "+1.000000E+05" << false << 0.0;
+    QTest::newRow("too precise") << "1.234567890123456E+00" << false << 0.0;
+    QTest::newRow("comma") << "1,600000E+00" << false << 0.0;
+    QTest::newRow("text") << "*TOTALS*" << false << 0.0;
+    QTest::newRow("overflow") << "9.999999E+308" << false << 0.0;
+    QTest::newRow("subnormal") << "1.234567E-320" << false << 0.0;
+}
+
+void tst_NumberParser::test_parseReal()
+{
+    // Given
+    QFETCH(QString, text);
+    QFETCH(bool, expected);
+    QFETCH(double, value);
+    std::string _text = text.toStdString();
+
+    // When
+    double actual = 0;
+    int precision = 0;
+    bool ok = NumberParser::parseReal(_text.data(), _text.data() + _text.size(), &actual, &precision);
+
+    // Then
+    QCOMPARE(ok, expected);
+    if (ok) {
+        QVERIFY(actual == value);   /* Exact, not fuzzy */
+        QCOMPARE(std::signbit(actual), std::signbit(value));
+        QCOMPARE(QString::fromStdString(NumberParser::formatReal(actual, precision)), text);
+    }
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_NumberParser::test_roundTrip()
+{
+    /* The decoded value must be the correctly rounded value (as strtod),
+     * and must be formatted back to the same text. */
+    std::srand(4321);
+    char text[32];
+    for (int i = 0; i < 100000; ++i) {
+        const int mantissa = std::rand() % 10000000;
+        const int exponent = std::rand() % 80 - 40;
+        const char *sign = (std::rand() % 2) ? "-" : "";
+        std::snprintf(text, sizeof(text), "%s%d.%06dE%c%02d", sign,
+                      mantissa / 1000000 + (mantissa < 1000000 ? 1 : 0), mantissa % 1000000,
+                      exponent < 0 ? '-' : '+', std::abs(exponent));
+
+        double actual = 0;
+        int precision = 0;
+        QVERIFY2(NumberParser::parseReal(text, text + std::strlen(text), &actual, &precision), text);
+        QVERIFY2(actual == std::strtod(text, 0), text);
+        QCOMPARE(NumberParser::formatReal(actual, precision), std::string(text));
+    }
+
+    /* Out of the range of the normal doubles: kept as text, so unchanged */
+    const char *outOfRange[] = { "9.999999E+308", "-9.999999E+308",
+                                 "1.234567E-320", "-1.234567E-320" };
+    for (const char *field : outOfRange) {
+        double actual = 0;
+        int precision = 0;
+        QVERIFY2(!NumberParser::parseReal(field, field + std::strlen(field), &actual, &precision), field);
+    }
+}
+
+/* *****************************************************************************
+ ***************************************************************************** */
+
+
+QTEST_APPLESS_MAIN(tst_NumberParser)
+
+#include "tst_numberparser.moc"
@@ -0,0 +1,301 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <BlockFilter.h>
+#include <PunchFile.h>
+#include <PunchIndex.h>
+#include <Reader.h>
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+#include <cstdio>   // std::remove()
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const char C_INDEX_FILE[] = "tst_punchindex.pchidx";
+
+class tst_PunchIndex : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void test_index_filename();
+    void test_block_source();
+    void test_ranges();
+    void test_save_and_load();
+    void test_consistency();
+    void test_parse_with_index();
+    void test_list_with_filter();
+
+private:
+    static std::string content();
+    static PunchIndex build(const std::string &content, const int threadCount);
+};
+
+/******************************************************************************
+ ******************************************************************************/
+std::string tst_PunchIndex::content()
+{
+    return
+        /*<--- 18 char ---><---- 18 char ---><---- 18 char ---><---- 18 char ---><8char->*/
+        "-> not a valid Punch line\n"
+        "$TITLE   = MY FEA MODEL                                                        1\n"
+        "$SUBCASE ID =         1                                                        2\n"
+        "     12345          80004230        BAR                                        3\n"
+        "     12346          80004231        BAR                                        4\n"
+        "$TITLE   = MY FEA MODEL                                                        5\n"
+        "$SUBCASE ID =         2                                                        6\n"
+        "$DISPLACEMENTS                                                                 7\n"
+        "         1       G      1.000000E+00      2.000000E+00      3.000000E+00       8\n"
+        "-CONT-                  4.000000E+00      5.000000E+00      6.000000E+00       9\n"
+        "$TITLE   = MY FEA MODEL                                                       10\n"
+        "$SUBCASE ID =         3                                                       11\n"
+        "     12347          80004232                                                  12\n";
+}
+
+PunchIndex tst_PunchIndex::build(const std::string &content, const int threadCount)
+{
+    const char *begin = content.data();
+    const char *end = content.data() + content.size();
+    PunchIndex index;
+    index.setStamp(content.size(), 0);
+    Reader reader;
+    reader.setThreadCount(threadCount);
+    reader.parsePUNCH(begin, end, [&](PunchBlock &block) { index.append(block, begin, end); });
+    return index;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_PunchIndex::test_index_filename()
+{
+    QCOMPARE(QString::fromStdString(PunchIndex::indexFilename("model.pch")), QString("model.pchidx"));
+    QCOMPARE(QString::fromStdString(PunchIndex::indexFilename("dir.v2/MODEL.PCH")), QString("dir.v2/MODEL.pchidx"));
+    QCOMPARE(QString::fromStdString(PunchIndex::indexFilename("dir.v2/model")), QString("dir.v2/model.pchidx"));
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_PunchIndex::test_block_source()
+{
+    // Given
+    const std::string input = content();
+    std::vector<std::pair<std::size_t, int> > expected = {
+        { 26, 2 }, { 26 + 4 * 81, 6 }, { 26 + 9 * 81, 11 }
+    };
+    std::vector<std::pair<std::size_t, int> > actualMemory;
+    std::vector<std::pair<std::size_t, int> > actualStream;
+
+    // When
+    Reader reader;
+    reader.parsePUNCH(input.data(), input.data() + input.size(), [&](PunchBlock &block) {
+        actualMemory.push_back( std::make_pair(block.sourceOffset(), block.sourceLine()) );
+    });
+    std::istringstream iss(input);
+    reader.parsePUNCH(&iss, [&](PunchBlock &block) {
+        actualStream.push_back( std::make_pair(block.sourceOffset(), block.sourceLine()) );
+    });
+
+    // Then
+    QVERIFY(actualMemory == expected);
+    QVERIFY(actualStream == expected);
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_PunchIndex::test_ranges()
+{
+    // Given
+    const std::string input = content();
+
+    // When
+    PunchIndex index = build(input, 1);
+
+    // Then
+    QCOMPARE(index.count(), 3);
+    QCOMPARE(index.at(0).rowCount, 2);
+    QCOMPARE(index.at(0).columnCount, 3);
+    QCOMPARE(index.at(1).rowCount, 1);
+    QCOMPARE(index.at(1).columnCount, 7);
+    QCOMPARE(QString::fromStdString(index.at(2).sequence), QString("10"));
+    QCOMPARE(index.at(2).headers.size(), std::size_t(2));
+    QCOMPARE(QString::fromStdString(index.at(2).headers[0].first), QString("SUBCASE ID"));
+    QCOMPARE(QString::fromStdString(index.at(2).headers[0].second), QString("3"));
+
+    /* The ranges are contiguous, and cover the whole file */
+    QCOMPARE(index.rangeBegin(0), std::size_t(0));
+    QCOMPARE(index.rangeEnd(0), index.rangeBegin(1));
+    QCOMPARE(index.rangeEnd(1), index.rangeBegin(2));
+    QCOMPARE(index.rangeEnd(2), input.size());
+    QCOMPARE(index.rangeLine(0), 0);
+    QCOMPARE(index.rangeLine(2), 10);
+    QVERIFY(index.isConsistent(input.data(), input.data() + input.size()));
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_PunchIndex::test_save_and_load()
+{
+    // Given
+    const std::string filename = C_INDEX_FILE;
+    const std::string input = content();
+    PunchIndex expected = build(input, 1);
+    expected.setStamp(input.size(), 1234567890);
+
+    // When
+    QVERIFY(expected.save(filename));
+    PunchIndex actual;
+    QVERIFY(actual.load(filename));
+
+    // Then
+    QCOMPARE(actual.fileSize(), expected.fileSize());
+    QCOMPARE(actual.modificationTime(), expected.modificationTime());
+    QCOMPARE(actual.count(), expected.count());
+    for (int i = 0; i < expected.count(); ++i) {
+        QCOMPARE(actual.at(i).offset, expected.at(i).offset);
+        QCOMPARE(actual.at(i).line, expected.at(i).line);
+        QCOMPARE(actual.at(i).sequence, expected.at(i).sequence);
+        QCOMPARE(actual.at(i).rowCount, expected.at(i).rowCount);
+        QCOMPARE(actual.at(i).columnCount, expected.at(i).columnCount);
+        QVERIFY(actual.at(i).headers == expected.at(i).headers);
+    }
+    std::remove(C_INDEX_FILE);
+    QVERIFY(!actual.load(filename));
+    QCOMPARE(actual.count(), 0);
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_PunchIndex::test_consistency()
+{
+    // Given
+    std::string input = content();
+    PunchIndex index = build(input, 1);
+
+    // When
+    std::string renumbered = input;
+    renumbered[26 + 9 * 81 + 79] = '9';     /* sequence number of the 3rd block */
+    std::string shifted = "\n" + input.substr(0, input.size() - 1);
+
+    // Then
+    QVERIFY(index.isConsistent(input.data(), input.data() + input.size()));
+    QVERIFY(!index.isConsistent(renumbered.data(), renumbered.data() + renumbered.size()));
+    QVERIFY(!index.isConsistent(shifted.data(), shifted.data() + shifted.size()));
+    QVERIFY(!index.isConsistent(input.data(), input.data() + input.size() - 1));
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_PunchIndex::test_parse_with_index()
+{
+    /* The input must be large enough to be cut into several chunks. */
+    // Given
+    std::string input = content();
+    int i = 0;
+    while (input.size() < 3 * C_CHUNK_SIZE) {
+        /*<--- 18 char ---><---- 18 char ---><---- 18 char ---><---- 18 char ---><8char->*/
+        input +=
+                "$TITLE   = MY FEA MODEL                                                        1\n"
+                "$SUBCASE ID =         " + std::to_string(1000000 + i) + "                                               2\n";
+        for (int j = 0; j < 1000; ++j) {
+            input += "     12345          80004230        BAR                                        3\n";
+            if (j % 500 == 0) {
+                input += "-> not a valid Punch line\n";
+            }
+        }
+        ++i;
+    }
+    const char *begin = input.data();
+    const char *end = input.data() + input.size();
+    PunchIndex index = build(input, 4);
+
+    std::vector<PunchBlock> expected;
+    std::vector<PunchBlock> actual;
+
+    // When
+    Reader serialReader;
+    serialReader.parsePUNCH(begin, end, [&expected](PunchBlock &block) { expected.push_back(block); });
+
+    Reader indexedReader;
+    indexedReader.setThreadCount(4);
+    indexedReader.parsePUNCH(begin, end, index, [&actual](PunchBlock &block) { actual.push_back(block); });
+
+    // Then
+    QVERIFY(index.isConsistent(begin, end));
+    QCOMPARE(index.count(), static_cast<int>(expected.size()));
+    QCOMPARE(actual.size(), expected.size());
+    for (std::size_t k = 0; k < actual.size(); ++k) {
+        QCOMPARE(actual[k].sourceOffset(), expected[k].sourceOffset());
+        QCOMPARE(actual[k].sourceLine(), expected[k].sourceLine());
+        QCOMPARE(index.at(k).line, expected[k].sourceLine());
+        QVERIFY(actual[k].prefixRowAndHeader() == expected[k].prefixRowAndHeader());
+        QVERIFY(actual[k].rows() == expected[k].rows());
+    }
+    QVERIFY(indexedReader.getWarnings() == serialReader.getWarnings());
+}
+
+void tst_PunchIndex::test_list_with_filter()
+{
+    /* The index lists all the blocks: with a filter, the list
+     * (option '-i -l') is scanned into a new index, like without '-i' */
+    // Given
+    const std::string input = content();
+    const char *begin = input.data();
+    const char *end = input.data() + input.size();
+    PunchIndex index = build(input, 1);
+    QVERIFY(index.isConsistent(begin, end));
+    QCOMPARE(index.count(), 3);
+
+    BlockFilter filter;
+    QVERIFY(filter.addSubcases("2"));
+
+    // When
+    PunchIndex filtered;
+    std::vector<PunchBlock> parsed;
+    Reader reader;
+    reader.setFilter(filter);
+    reader.scanPUNCH(begin, end, [&](PunchBlock &block) {
+        filtered.append(block, begin, end);
+        parsed.push_back(block);
+    });
+
+    BlockFilter none;
+    QVERIFY(none.addSubcases("999"));
+    PunchIndex empty;
+    Reader emptyReader;
+    emptyReader.setFilter(none);
+    emptyReader.scanPUNCH(begin, end, [&](PunchBlock &block) { empty.append(block, begin, end); });
+
+    // Then
+    QCOMPARE(filtered.count(), 1);
+    QCOMPARE(filtered.at(0).line, index.at(1).line);
+    QCOMPARE(filtered.at(0).offset, index.at(1).offset);
+    QCOMPARE(filtered.at(0).rowCount, index.at(1).rowCount);
+    QCOMPARE(filtered.at(0).columnCount, index.at(1).columnCount);
+    QVERIFY(filtered.at(0).headers == index.at(1).headers);
+    /* The rows are only scanned */
+    QCOMPARE(int(parsed.size()), 1);
+    QVERIFY(!parsed[0].isLoaded());
+
+    QCOMPARE(empty.count(), 0);
+}
+
+QTEST_APPLESS_MAIN(tst_PunchIndex)
+
+#include "tst_punchindex.moc"
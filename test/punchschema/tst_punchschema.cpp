@@ -0,0 +1,227 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <PunchSchema.h>
+#include <Reader.h>
+#include <Writer.h>
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class tst_PunchSchema : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void test_registry();
+    void test_find();
+    void test_find_data();
+    void test_parseFormat();
+
+    void test_select_schema();
+    void test_typed_with_schema();
+    void test_named_columns();
+
+private:
+    std::vector<PunchBlock> parse(const std::string &text, const bool typed);
+};
+
+/******************************************************************************
+ ******************************************************************************/
+static const char s_punch[] =
+        /*<--- 18 char ---><---- 18 char ---><---- 18 char ---><---- 18 char ---><8char->*/
+        "$TITLE   =                                                                     1\n"
+        "$DISPLACEMENTS                                                                 2\n"
+        "$REAL OUTPUT                                                                   3\n"
+        "$SUBCASE ID =           1                                                      4\n"
+        "         1       G      1.000000E-06      0.000000E+00      0.000000E+00       5\n"
+        "-CONT-                  0.000000E+00      0.000000E+00      0                  6\n"
+        "$TITLE   =                                                                     7\n"
+        "$ELEMENT FORCES                                                                8\n"
+        "$REAL OUTPUT                                                                   9\n"
+        "$SUBCASE ID =           1                                                     10\n"
+        "$ELEMENT TYPE =          12  ELAS2                                            11\n"
+        "      4000             -1.445403E+01                                          12\n"
+        "$TITLE   =                                                                    13\n"
+        "$ELEMENT FORCES                                                               14\n"
+        "$REAL OUTPUT                                                                  15\n"
+        "$SUBCASE ID =           1                                                     16\n"
+        "$ELEMENT TYPE =           2  BEAM                                             17\n"
+        "        10                10              0.000000E+00      5.066750E+03      18\n";
+
+std::vector<PunchBlock> tst_PunchSchema::parse(const std::string &text, const bool typed)
+{
+    std::stringstream buffer(text);
+    std::vector<PunchBlock> blocks;
+    Reader reader;
+    reader.setTyped(typed);
+    reader.parsePUNCH(&buffer, [&blocks](PunchBlock &block) { blocks.push_back(block); });
+    return blocks;
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_PunchSchema::test_registry()
+{
+    QVERIFY(PunchSchema::count() > 0);
+    QVERIFY(PunchSchema::at(-1) == 0);
+    QVERIFY(PunchSchema::at(PunchSchema::count()) == 0);
+
+    for (int i = 0; i < PunchSchema::count(); ++i) {
+        const PunchSchema *schema = PunchSchema::at(i);
+        QVERIFY(schema->columnCount > 0);
+        QVERIFY(schema->columnCount <= 4 + 3 * (schema->lineCount - 1));
+        for (int column = 0; column < schema->columnCount; ++column) {
+            QVERIFY(std::strlen(schema->columns[column]) > 0);
+        }
+        /* Each schema is unique */
+        QVERIFY(PunchSchema::find(schema->result, schema->format,
+                                  schema->elementType, schema->interleaved) == schema);
+    }
+}
+
+void tst_PunchSchema::test_find_data()
+{
+    QTest::addColumn<QString>("result");
+    QTest::addColumn<int>("format");
+    QTest::addColumn<int>("elementType");
+    QTest::addColumn<int>("columnCount");
+    QTest::addColumn<int>("lineCount");
+
+    QTest::newRow("displacements") << "DISPLACEMENTS" << int(PunchSchema::Real) << 0 << 7 << 2;
+    QTest::newRow("spcf") << "SPCF" << int(PunchSchema::Real) << 0 << 7 << 2;
+    QTest::newRow("complex eigenvector") << "EIGENVECTOR" << int(PunchSchema::RealImaginary) << 0 << 13 << 4;
+    QTest::newRow("velocity mag-phase") << "VELOCITY" << int(PunchSchema::MagnitudePhase) << 0 << 13 << 4;
+    QTest::newRow("bush forces") << "ELEMENT FORCES" << int(PunchSchema::Real) << 102 << 7 << 2;
+    QTest::newRow("bush stresses") << "ELEMENT STRESSES" << int(PunchSchema::Real) << 102 << 7 << 2;
+    QTest::newRow("bar forces") << "ELEMENT FORCES" << int(PunchSchema::Real) << 34 << 9 << 3;
+    QTest::newRow("elas2 forces") << "ELEMENT FORCES" << int(PunchSchema::Real) << 12 << 2 << 1;
+
+    QTest::newRow("unknown result") << "FOO" << int(PunchSchema::Real) << 0 << 0 << 0;
+    QTest::newRow("unknown element") << "ELEMENT FORCES" << int(PunchSchema::Real) << 2 << 0 << 0;
+    QTest::newRow("grid with element") << "DISPLACEMENTS" << int(PunchSchema::Real) << 102 << 0 << 0;
+}
+
+void tst_PunchSchema::test_find()
+{
+    QFETCH(QString, result);
+    QFETCH(int, format);
+    QFETCH(int, elementType);
+    QFETCH(int, columnCount);
+    QFETCH(int, lineCount);
+
+    const PunchSchema *schema = PunchSchema::find(result.toStdString(),
+                                                  PunchSchema::Format(format),
+                                                  elementType);
+    if (columnCount == 0) {
+        QVERIFY(schema == 0);
+    } else {
+        QVERIFY(schema != 0);
+        QCOMPARE(schema->columnCount, columnCount);
+        QCOMPARE(schema->lineCount, lineCount);
+    }
+}
+
+void tst_PunchSchema::test_parseFormat()
+{
+    PunchSchema::Format format = PunchSchema::Real;
+    QVERIFY(PunchSchema::parseFormat("REAL-IMAGINARY OUTPUT", &format));
+    QCOMPARE(int(format), int(PunchSchema::RealImaginary));
+    QVERIFY(PunchSchema::parseFormat("MAGNITUDE-PHASE OUTPUT", &format));
+    QCOMPARE(int(format), int(PunchSchema::MagnitudePhase));
+    QVERIFY(PunchSchema::parseFormat("REAL OUTPUT", &format));
+    QCOMPARE(int(format), int(PunchSchema::Real));
+    QVERIFY(!PunchSchema::parseFormat("DISPLACEMENTS", &format));
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_PunchSchema::test_select_schema()
+{
+    std::vector<PunchBlock> blocks = parse(s_punch, false);
+
+    QCOMPARE(int(blocks.size()), 3);
+    QVERIFY(blocks[0].schema() == PunchSchema::find("DISPLACEMENTS", PunchSchema::Real, 0));
+    QVERIFY(blocks[1].schema() == PunchSchema::find("ELEMENT FORCES", PunchSchema::Real, 12));
+    QVERIFY(blocks[2].schema() == 0);
+
+    /* The untyped mode keeps the text */
+    QCOMPARE(int(blocks[0].value(0, 1).type), int(PunchValue::Text));
+}
+
+void tst_PunchSchema::test_typed_with_schema()
+{
+    std::vector<PunchBlock> blocks = parse(s_punch, true);
+
+    QCOMPARE(int(blocks.size()), 3);
+    const PunchBlock &displacements = blocks[0];
+    QCOMPARE(displacements.columnCount(), 7);
+    QCOMPARE(int(displacements.value(0, 0).type), int(PunchValue::Text));
+    QCOMPARE(int(displacements.value(0, 1).type), int(PunchValue::Real));
+    QVERIFY(displacements.value(0, 1).real == 1.0e-06);
+    /* A field that doesn't match the schema falls back to the generic path */
+    QCOMPARE(int(displacements.value(0, 6).type), int(PunchValue::Integer));
+    QCOMPARE(QString::fromStdString(displacements.text(0, 6)), QString("0"));
+
+    const PunchBlock &forces = blocks[1];
+    QCOMPARE(int(forces.value(0, 0).type), int(PunchValue::Integer));
+    QCOMPARE(forces.value(0, 0).integer, 4000LL);
+    QCOMPARE(int(forces.value(0, 1).type), int(PunchValue::Real));
+
+    const PunchBlock &beam = blocks[2];
+    QCOMPARE(int(beam.value(0, 1).type), int(PunchValue::Integer));
+}
+
+void tst_PunchSchema::test_named_columns()
+{
+    std::vector<PunchBlock> blocks = parse(s_punch, false);
+
+    std::stringstream named;
+    Writer namedWriter(std::string(), false, true);
+    namedWriter.writeCSV(blocks[1], &named);
+
+    std::stringstream unknown;
+    Writer unknownWriter(std::string(), false);
+    unknownWriter.writeCSV(blocks[1], &unknown);
+
+    std::string namedHeader;
+    std::getline(named, namedHeader);
+    std::string unknownHeader;
+    std::getline(unknown, unknownHeader);
+
+    QCOMPARE(QString::fromStdString(namedHeader),
+             QString("\"ELEMENT TYPE\";\"SUBCASE ID\";\"TITLE\";\"ELEMENT ID\";\"FORCE\";"));
+    QCOMPARE(QString::fromStdString(unknownHeader),
+             QString("\"ELEMENT TYPE\";\"SUBCASE ID\";\"TITLE\";\"unknown\";\"unknown\";"));
+
+    /* The rows are the same */
+    std::string namedRow;
+    std::getline(named, namedRow);
+    std::string unknownRow;
+    std::getline(unknown, unknownRow);
+    QCOMPARE(QString::fromStdString(namedRow), QString::fromStdString(unknownRow));
+}
+
+QTEST_APPLESS_MAIN(tst_PunchSchema)
+
+#include "tst_punchschema.moc"
@@ -0,0 +1,12 @@
+#isEmpty(TEMPLATE):TEMPLATE=app
+TARGET       = tst_recordscanner
+CONFIG      += testcase
+QT           = core testlib
+SOURCES     += tst_recordscanner.cpp
+
+# Include:
+INCLUDEPATH += ../../include
+
+# Dependancies:
+HEADERS += ../../src/recordscanner.h
+SOURCES += ../../src/recordscanner.cpp
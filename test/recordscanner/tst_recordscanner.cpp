@@ -0,0 +1,196 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <RecordScanner.h>
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*! \internal
+ * Scans the given \a lines with the given implementation \a impl.
+ */
+static std::vector<PunchRecord> scanWith(RecordScanner::Implementation impl,
+                                         const std::vector<std::string> &lines)
+{
+    RecordScanner::Implementation previous = RecordScanner::implementation();
+    RecordScanner::setImplementation(impl);
+
+    std::vector<const char*> ptrs;
+    for (auto & line : lines) {
+        ptrs.push_back(line.c_str());
+    }
+    std::vector<PunchRecord> records(lines.size());
+    RecordScanner::scan(ptrs.data(), ptrs.size(), records.data());
+
+    RecordScanner::setImplementation(previous);
+    return records;
+}
+
+static bool areEqual(const PunchRecord &r1, const PunchRecord &r2)
+{
+    return r1.type == r2.type
+            && r1.equal == r2.equal
+            && std::memcmp(r1.fieldBegin, r2.fieldBegin, sizeof(r1.fieldBegin)) == 0
+            && std::memcmp(r1.fieldEnd, r2.fieldEnd, sizeof(r1.fieldEnd)) == 0;
+}
+
+/*! \internal
+ * Returns \a count random 80-character lines, made of the characters
+ * that matter for the scanner.
+ */
+static std::vector<std::string> randomLines(int count)
+{
+    static const char alphabet[] = "   \t\r\n=$-CONT0123456789.E+";
+    std::srand(12345);
+    std::vector<std::string> lines;
+    for (int i = 0; i < count; ++i) {
+        std::string line(80, ' ');
+        const int density = std::rand() % 80;
+        for (int j = 0; j < 80; ++j) {
+            if (std::rand() % 80 < density) {
+                line[j] = alphabet[std::rand() % (sizeof(alphabet) - 1)];
+            }
+        }
+        if (i % 7 == 0) {
+            line.replace(std::rand() % 13, 6, "-CONT-");
+        }
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+
+class tst_RecordScanner : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void test_scan();
+    void test_scan_data();
+
+    void test_implementations();
+
+};
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_RecordScanner::test_scan_data()
+{
+    QTest::addColumn<QString>("line");
+    QTest::addColumn<int>("type");
+    QTest::addColumn<int>("equal");
+    QTest::addColumn<QString>("fields");
+
+    /*<--- 18 char ---><---- 18 char ---><---- 18 char ---><---- 18 char ---><8char->*/
+    QTest::newRow("blank")
+            << "                                                                                "
+            << int(PunchRecord::Data) << -1 << "0-0,18-18,36-36,54-54";
+    QTest::newRow("header")
+            << "$SUBCASE ID =         666                                                      6"
+            << int(PunchRecord::Header) << 12 << "0-13,22-25,36-36,54-54";
+    QTest::newRow("equal in line number")
+            << "$EIGENVECTOR                                                                   ="
+            << int(PunchRecord::Header) << 79 << "0-12,18-18,36-36,54-54";
+    QTest::newRow("data")
+            << "     12345          80004230        BAR                                        7"
+            << int(PunchRecord::Data) << -1 << "5-10,20-28,36-39,54-54";
+    QTest::newRow("continued")
+            << "-CONT-                  2.288704E+04     -3.404367E+03      1.639255E+03       8"
+            << int(PunchRecord::Continuation) << -1 << "0-6,24-36,41-54,60-72";
+    QTest::newRow("continued with blanks")
+            << "   -CONT-               2.288704E+04                                            "
+            << int(PunchRecord::Continuation) << -1 << "3-9,24-36,36-36,54-54";
+    QTest::newRow("truncated continued")
+            << "-CONT                   2.288704E+04                                            "
+            << int(PunchRecord::Data) << -1 << "0-5,24-36,36-36,54-54";
+    QTest::newRow("full fields")
+            << "AAAAAAAAAAAAAAAAAABBBBBBBBBBBBBBBBBBCCCCCCCCCCCCCCCCCCDDDDDDDDDDDDDDDDDD99999999"
+            << int(PunchRecord::Data) << -1 << "0-18,18-36,36-54,54-72";
+    QTest::newRow("tabs")
+            << "\t\t1\t\t             "
+               "\t\t 2 \t            "
+               "\t\r\n\t3\r\n\t          "
+               "  4\t  \t  \t        "
+               " 9\t\t    "
+            << int(PunchRecord::Data) << -1 << "2-3,21-22,40-41,56-57";
+}
+
+void tst_RecordScanner::test_scan()
+{
+    // Given
+    QFETCH(QString, line);
+    QFETCH(int, type);
+    QFETCH(int, equal);
+    QFETCH(QString, fields);
+    std::vector<std::string> lines(1, line.toStdString());
+    QCOMPARE(int(lines.front().size()), 80);
+
+    // When
+    std::vector<PunchRecord> records = scanWith(RecordScanner::Implementation::Scalar, lines);
+
+    // Then
+    const PunchRecord &record = records.front();
+    std::string actualFields;
+    for (int i = 0; i < 4; ++i) {
+        if (i > 0) actualFields += ",";
+        actualFields += std::to_string(record.fieldBegin[i]) + "-" + std::to_string(record.fieldEnd[i]);
+    }
+    QCOMPARE(int(record.type), type);
+    QCOMPARE(record.equal, equal);
+    QCOMPARE(QString::fromStdString(actualFields), fields);
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_RecordScanner::test_implementations()
+{
+    // Given
+    std::vector<std::string> lines = randomLines(10000);
+
+    // When
+    std::vector<PunchRecord> expected = scanWith(RecordScanner::Implementation::Scalar, lines);
+
+    // Then
+    const RecordScanner::Implementation impls[] = {
+        RecordScanner::Implementation::SSE2,
+        RecordScanner::Implementation::AVX2
+    };
+    for (auto impl : impls) {
+        if (!RecordScanner::isSupported(impl)) {
+            qDebug() << "Implementation not supported:" << int(impl);
+            continue;
+        }
+        std::vector<PunchRecord> actual = scanWith(impl, lines);
+        for (std::size_t i = 0; i < lines.size(); ++i) {
+            QVERIFY2(areEqual(actual[i], expected[i]), lines[i].c_str());
+        }
+    }
+}
+
+/* *****************************************************************************
+ ***************************************************************************** */
+
+
+QTEST_APPLESS_MAIN(tst_RecordScanner)
+
+#include "tst_recordscanner.moc"
@@ -17,6 +17,8 @@
 #include <Utils/TestSuite.h>
 #include <Reader.h>
 #include <Writer.h>
+#include <InputPipeline.h>
+#include <NumberParser.h>
 
 #include <QtTest/QtTest>
 #include <QtCore/QDebug>
@@ -34,7 +36,27 @@ static bool run(stringstream * const idevice, stringstream * const odevice)
     for (auto & key : pch.blockKeys()) {
         auto br = pch.blockRange(key);
         for (auto b = br.first; b != br.second; ++b) {
-            PunchBlock block = b->second;
+            PunchBlock block = *b;
+            converted &= writer.writeCSV(block, odevice);
+        }
+    }
+    return converted;
+}
+
+static bool runFromMemory(const std::string &content, stringstream * const odevice,
+                          std::vector<std::string> *warnings)
+{
+    bool converted = true;
+
+    Reader reader;
+    PunchFile pch = reader.parsePUNCH(content.data(), content.data() + content.size());
+    *warnings = reader.getWarnings();
+
+    Writer writer;
+    for (auto & key : pch.blockKeys()) {
+        auto br = pch.blockRange(key);
+        for (auto b = br.first; b != br.second; ++b) {
+            PunchBlock block = *b;
             converted &= writer.writeCSV(block, odevice);
         }
     }
@@ -65,6 +87,31 @@ private slots:
     void test_comment_with_header();
     void test_unsorted_line_number();
 
+    /* test the in-memory input */
+    void test_parse_from_memory();
+    void test_parse_from_memory_data();
+
+    /* test the block handler */
+    void test_parse_with_handler();
+
+    /* test the parallel parsing */
+    void test_parse_in_parallel();
+
+    /* test the buffered stream */
+    void test_parse_stream_in_buffers();
+
+    /* test the typed mode */
+    void test_typed();
+    void test_typed_data();
+    void test_typed_values();
+
+    /* test the block cells */
+    void test_block_cells();
+
+    /* test the lazy blocks */
+    void test_scan();
+    void test_scan_data();
+
     /*test the options */
     void test_option_output();
     void test_option_column_header();
@@ -479,6 +526,369 @@ void tst_Scanner::test_several_types_in_a_single_input()
     COMPARE_STREAM( actual, expected );
 }
 
+/******************************************************************************
+ ******************************************************************************/
+void tst_Scanner::test_parse_from_memory_data()
+{
+    QTest::addColumn<QString>("content");
+
+    QTest::newRow("memory__1") << "";
+    QTest::newRow("memory__2") << "\r\n\n\r";
+    QTest::newRow("memory__3") <<
+        /*<--- 18 char ---><---- 18 char ---><---- 18 char ---><---- 18 char ---><8char->*/
+        "$TITLE   = MY FEA MODEL                                                        1\r\n"
+        "$SUBCASE ID =         666                                                      2\r\n"
+        "     12345          80004230        BAR                                        3\r\n"
+        "-CONT-                  2.288704E+04     -3.404367E+03      1.639255E+03       4\r\n"
+        "     12345          80004231        BAR                                        5\r\n"
+        "-CONT-                 -2.301775E+04     -3.107557E+03      4.195733E+02       6";
+    QTest::newRow("memory__4") <<
+        /*<--- 18 char ---><---- 18 char ---><---- 18 char ---><---- 18 char ---><8char->*/
+        "-CONT-                 -7.163730E+04                                           1\n"
+        "     80004230          -3.404367E+03                                           2\n"
+        "-> it's not a valid Punch line because has 79 characters...                  1\n"
+        "$LABEL   =MY FIRST LOAD CASE                                                   3\n"
+        "$SUBCASE ID =         777                                                      4\n"
+        "\n"
+        "     80004231           7.232352E+04                                           5\n";
+}
+
+void tst_Scanner::test_parse_from_memory()
+{
+    // Given
+    QFETCH(QString, content);
+    std::string _content = content.toStdString();
+    std::stringstream buffer( _content );
+
+    std::stringstream actual;
+    std::stringstream expected;
+    std::vector<std::string> actualWarnings;
+
+    // When
+    Reader reader;
+    reader.parsePUNCH( &buffer );
+    std::vector<std::string> expectedWarnings = reader.getWarnings();
+
+    buffer.clear();
+    buffer.seekg(0);
+    run( &buffer, &expected );
+    runFromMemory( _content, &actual, &actualWarnings );
+
+    // Then
+    QVERIFY( actualWarnings == expectedWarnings );
+    COMPARE_STREAM( actual, expected );
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_Scanner::test_parse_with_handler()
+{
+    /* The blocks are pushed in the file order, not sorted by format. */
+    // Given
+    std::stringstream buffer(
+                /*<--- 18 char ---><---- 18 char ---><---- 18 char ---><---- 18 char ---><8char->*/
+                "$TITLE   = MY FEA MODEL                                                        1\n"
+                "$SUBCASE ID =         1                                                        2\n"
+                "     80004230          -3.404367E+03                                           3\n"
+                "$LABEL   = MY LABEL                                                            4\n"
+                "$SUBCASE ID =         2                                                        5\n"
+                "     80004231           7.232352E+04                                           6\n"
+                "     80004232          -6.865467E+03                                           7\n"
+                "$TITLE   = MY FEA MODEL                                                        8\n"
+                "$SUBCASE ID =         3                                                        9\n"
+                "     80004233          -9.844569E+06                                          10\n" );
+
+    std::stringstream actual;
+    std::stringstream expected(
+                "SUBCASE ID,TITLE,unknown,unknown\n"
+                "1,MY FEA MODEL,80004230,-3.404367E+03\n"
+                "LABEL,SUBCASE ID,unknown,unknown\n"
+                "MY LABEL,2,80004231,7.232352E+04\n"
+                "MY LABEL,2,80004232,-6.865467E+03\n"
+                "SUBCASE ID,TITLE,unknown,unknown\n"
+                "3,MY FEA MODEL,80004233,-9.844569E+06\n" );
+
+    std::vector<int> rowCounts;
+
+    // When
+    Reader reader;
+    Writer writer;
+    auto sink = std::bind(&Writer::writeCSV, &writer, std::placeholders::_1, &actual);
+    reader.parsePUNCH(&buffer, [&](PunchBlock &block) {
+        rowCounts.push_back(block.rowCount());
+        sink(block);
+    });
+
+    // Then
+    QCOMPARE(rowCounts, std::vector<int>({1, 2, 1}));
+    COMPARE_STREAM( actual, expected );
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_Scanner::test_parse_in_parallel()
+{
+    /* The input must be large enough to be cut into several chunks. */
+    // Given
+    std::string content;
+    int i = 0;
+    while (content.size() < 6 * C_CHUNK_SIZE) {
+        /*<--- 18 char ---><---- 18 char ---><---- 18 char ---><---- 18 char ---><8char->*/
+        content +=
+                "$TITLE   = MY FEA MODEL                                                        1\r\n"
+                "$SUBCASE ID =         " + std::to_string(1000000 + i) + "                                               2\r\n";
+        if (i % 3 == 0) {
+            content += "$ Invalid line\r\n";
+            content += "$LABEL   =MY FIRST LOAD CASE                                                   3\r\n";
+        }
+        for (int j = 0; j < 1000; ++j) {
+            content +=
+                    "     12345          80004230        BAR                                        7\r\n"
+                    "-CONT-                  2.288704E+04     -3.404367E+03      1.639255E+03       8\r\n";
+            if (j % 500 == 0) {
+                content += "-> not a valid Punch line\r\n";
+                content += "-CONT-                 -7.163730E+04      9.975631E+05      3.060709E+06       9\r\n";
+            }
+        }
+        ++i;
+    }
+
+    std::vector<PunchBlock> expected;
+    std::vector<PunchBlock> actual;
+
+    // When
+    Reader serialReader;
+    serialReader.parsePUNCH(content.data(), content.data() + content.size(),
+                            [&expected](PunchBlock &block) { expected.push_back(block); });
+
+    Reader parallelReader;
+    parallelReader.setThreadCount(4);
+    parallelReader.parsePUNCH(content.data(), content.data() + content.size(),
+                              [&actual](PunchBlock &block) { actual.push_back(block); });
+
+    // Then
+    QCOMPARE(actual.size(), expected.size());
+    for (std::size_t k = 0; k < actual.size(); ++k) {
+        QVERIFY(actual[k].prefixRowAndHeader() == expected[k].prefixRowAndHeader());
+        QVERIFY(actual[k].rows() == expected[k].rows());
+    }
+    QVERIFY(parallelReader.getWarnings() == serialReader.getWarnings());
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_Scanner::test_parse_stream_in_buffers()
+{
+    /* The input must be larger than the buffers, so some lines straddle two buffers. */
+    // Given
+    std::string content;
+    int i = 0;
+    while (content.size() < 2 * C_READ_BUFFER_SIZE + 1000) {
+        /*<--- 18 char ---><---- 18 char ---><---- 18 char ---><---- 18 char ---><8char->*/
+        content +=
+                "$TITLE   = MY FEA MODEL                                                        1\r\n"
+                "$SUBCASE ID =         " + std::to_string(1000000 + i) + "                                               2\n";
+        for (int j = 0; j < 1000; ++j) {
+            content +=
+                    "     12345          80004230        BAR                                        7\n"
+                    "-CONT-                  2.288704E+04     -3.404367E+03      1.639255E+03       8\r\n";
+            if (j % 300 == 0) {
+                content += std::string(j % 7, '-') + "> not a valid Punch line\n";
+            }
+        }
+        ++i;
+    }
+    content += "     12345          80004230        BAR                                        9";
+
+    std::vector<PunchBlock> expected;
+    std::vector<PunchBlock> actual;
+
+    // When
+    Reader memoryReader;
+    memoryReader.parsePUNCH(content.data(), content.data() + content.size(),
+                            [&expected](PunchBlock &block) { expected.push_back(block); });
+
+    std::stringstream buffer(content);
+    Reader streamReader;
+    streamReader.parsePUNCH(&buffer, [&actual](PunchBlock &block) { actual.push_back(block); });
+
+    // Then
+    QCOMPARE(actual.size(), expected.size());
+    for (std::size_t k = 0; k < actual.size(); ++k) {
+        QCOMPARE(actual[k].sourceOffset(), expected[k].sourceOffset());
+        QCOMPARE(actual[k].sourceLine(), expected[k].sourceLine());
+        QVERIFY(actual[k].prefixRowAndHeader() == expected[k].prefixRowAndHeader());
+        QVERIFY(actual[k].rows() == expected[k].rows());
+    }
+    QVERIFY(streamReader.getWarnings() == memoryReader.getWarnings());
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_Scanner::test_typed_data()
+{
+    QTest::addColumn<QString>("content");
+
+    QTest::newRow("typed__1") <<
+        /*<--- 18 char ---><---- 18 char ---><---- 18 char ---><---- 18 char ---><8char->*/
+        "$TITLE   = MY FEA MODEL                                                        1\n"
+        "$SUBCASE ID =         132                                                      2\n"
+        "     12345          80004230        BAR                                        3\n"
+        "-CONT-                  2.288704E+04     -3.404367E+03      1.639255E+03       4\n"
+        "-CONT-                 -7.163730E+04      0.000000E+00     -0.000000E+00       5\n"
+        "  12345678                          *TOTALS*                                   6\n"
+        "-CONT-                 -3.492460E-10     -1.906592E-07     -3.516470E-07       7\n"
+        "-CONT-                 -6.166636E-06      2.537854E-08     -7.888302E-37       8\n";
+    QTest::newRow("typed__2") <<
+        /*<--- 18 char ---><---- 18 char ---><---- 18 char ---><---- 18 char ---><8char->*/
+        "     80004230          -3.404367E+03                                        1237\n"
+        "-CONT-                 -7.163730E+04                                         909\n"
+        "     80004233          -9.844569E+06                                          10\n"
+        "-CONT-                 -2.9784151+04                                    99999999\n"
+        "     +0004233          -9.844569e+06      1.5               007              11\n"
+        "AAAAAAAAAAAAAAAAAABBBBBBBBBBBBBBBBBBCCCCCCCCCCCCCCCCCCDDDDDDDDDDDDDDDDDD99999999\n";
+}
+
+void tst_Scanner::test_typed()
+{
+    /* The typed mode must give exactly the same output. */
+    // Given
+    QFETCH(QString, content);
+    std::string _content = content.toStdString();
+
+    std::stringstream actual;
+    std::stringstream expected;
+
+    // When
+    Reader reader;
+    Writer writer;
+    reader.parsePUNCH(_content.data(), _content.data() + _content.size(),
+                      std::bind(&Writer::writeCSV, &writer, std::placeholders::_1, &expected));
+
+    Reader typedReader;
+    Writer typedWriter;
+    typedReader.setTyped(true);
+    typedReader.parsePUNCH(_content.data(), _content.data() + _content.size(),
+                           std::bind(&Writer::writeCSV, &typedWriter, std::placeholders::_1, &actual));
+
+    // Then
+    QCOMPARE(QString::fromStdString(actual.str()), QString::fromStdString(expected.str()));
+    QVERIFY(typedReader.getWarnings() == reader.getWarnings());
+}
+
+void tst_Scanner::test_typed_values()
+{
+    // Given
+    std::stringstream buffer(
+                /*<--- 18 char ---><---- 18 char ---><---- 18 char ---><---- 18 char ---><8char->*/
+                "     12345          80004230        BAR                                        7\n"
+                "-CONT-                  2.288704E+04     -3.404367E+03      1.639255E+03       8\n" );
+
+    std::vector<PunchBlock> blocks;
+
+    // When
+    Reader reader;
+    reader.setTyped(true);
+    reader.parsePUNCH(&buffer, [&blocks](PunchBlock &block) { blocks.push_back(block); });
+
+    // Then
+    QCOMPARE(int(blocks.size()), 1);
+    const PunchBlock &block = blocks.front();
+    QVERIFY(block.isTyped());
+    QCOMPARE(block.rowCount(), 1);
+    QCOMPARE(block.columnCount(), 7);
+    QCOMPARE(int(block.value(0, 0).type), int(PunchValue::Integer));
+    QCOMPARE(block.value(0, 0).integer, 12345LL);
+    QCOMPARE(int(block.value(0, 2).type), int(PunchValue::Text));
+    QCOMPARE(QString::fromStdString(block.text(0, 2)), QString("BAR"));
+    QCOMPARE(int(block.value(0, 3).type), int(PunchValue::Empty));
+    QCOMPARE(int(block.value(0, 5).type), int(PunchValue::Real));
+    QVERIFY(block.value(0, 5).real == -3.404367E+03);
+    QCOMPARE(int(block.value(0, 7).type), int(PunchValue::Empty));
+}
+
+void tst_Scanner::test_block_cells()
+{
+    // Given
+    PunchRow row1 = { "1", "", "FOO" };
+    PunchRow row2 = { "2", "BAR", "", "BAZ" };
+
+    // When
+    PunchBlock block;
+    block.append(row1);
+    block.append(PunchRow());
+    block.append(row2);
+
+    // Then
+    QVERIFY(!block.isTyped());
+    QCOMPARE(block.rowCount(), 2);
+    QCOMPARE(block.columnCount(), 3);
+    QCOMPARE(block.fieldCount(0), 3);
+    QCOMPARE(block.fieldCount(1), 4);
+    QCOMPARE(block.fieldCount(2), 0);
+    QCOMPARE(int(block.value(0, 1).type), int(PunchValue::Empty));
+    QCOMPARE(int(block.value(1, 3).type), int(PunchValue::Text));
+
+    char buffer[C_NUMBER_BUFFER_SIZE];
+    PunchField field = block.field(1, 3, buffer);
+    QCOMPARE(QString::fromStdString(field.toString()), QString("BAZ"));
+    QVERIFY(field.data != buffer);
+    QVERIFY(block.field(0, 1, buffer).empty());
+    QVERIFY(block.field(5, 0, buffer).empty());
+
+    std::list<PunchRow> rows = block.rows();
+    QCOMPARE(int(rows.size()), 2);
+    QVERIFY(rows.front() == row1);
+    QVERIFY(rows.back() == row2);
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_Scanner::test_scan_data()
+{
+    test_parse_from_memory_data();
+    test_typed_data();
+}
+
+void tst_Scanner::test_scan()
+{
+    /* The lazy blocks must give the same blocks, once loaded. */
+    // Given
+    QFETCH(QString, content);
+    std::string _content = content.toStdString();
+    const char *begin = _content.data();
+    const char *end = _content.data() + _content.size();
+
+    std::vector<PunchBlock> expected;
+    std::vector<PunchBlock> actual;
+
+    // When
+    Reader reader;
+    reader.setTyped(true);
+    reader.parsePUNCH(begin, end, [&expected](PunchBlock &block) { expected.push_back(block); });
+
+    Reader lazyReader;
+    lazyReader.setTyped(true);
+    lazyReader.scanPUNCH(begin, end, [&actual](PunchBlock &block) { actual.push_back(block); });
+
+    // Then
+    QCOMPARE(actual.size(), expected.size());
+    for (std::size_t k = 0; k < actual.size(); ++k) {
+        QVERIFY(!actual[k].isLoaded());
+        QCOMPARE(actual[k].rowCount(), expected[k].rowCount());
+        QCOMPARE(actual[k].columnCount(), expected[k].columnCount());
+        QCOMPARE(actual[k].sourceOffset(), expected[k].sourceOffset());
+        QVERIFY(actual[k].prefixRowAndHeader() == expected[k].prefixRowAndHeader());
+        QVERIFY(!actual[k].isLoaded());
+
+        QVERIFY(actual[k].rows() == expected[k].rows());
+        QVERIFY(actual[k].isLoaded());
+        QCOMPARE(actual[k].rowCount(), expected[k].rowCount());
+        QCOMPARE(actual[k].isTyped(), expected[k].isTyped());
+    }
+    QVERIFY(lazyReader.getWarnings() == reader.getWarnings());
+}
+
 /* *****************************************************************************
  ***************************************************************************** */
 
@@ -0,0 +1,46 @@
+#isEmpty(TEMPLATE):TEMPLATE=app
+TARGET       = tst_scanner_scalar
+CONFIG      += testcase
+QT           = core testlib
+SOURCES     += ../scanner/tst_scanner.cpp
+
+# Build the RecordScanner without the SIMD implementations:
+DEFINES     += PCH2CSV_NO_SIMD
+
+# Include:
+INCLUDEPATH += ../../include
+
+# Dependancies:
+HEADERS += ../../utils/csvcomparer.h
+SOURCES += ../../utils/csvcomparer.cpp
+HEADERS += ../../utils/testsuite.h
+SOURCES += ../../utils/testsuite.cpp
+
+HEADERS += ../../src/inputpipeline.h
+SOURCES += ../../src/inputpipeline.cpp
+HEADERS += ../../src/reader.h
+SOURCES += ../../src/reader.cpp
+HEADERS += ../../src/recordscanner.h
+SOURCES += ../../src/recordscanner.cpp
+HEADERS += ../../src/arena.h
+SOURCES += ../../src/arena.cpp
+HEADERS += ../../src/blockfilter.h
+SOURCES += ../../src/blockfilter.cpp
+HEADERS += ../../src/idset.h
+SOURCES += ../../src/idset.cpp
+HEADERS += ../../src/complexconverter.h
+SOURCES += ../../src/complexconverter.cpp
+HEADERS += ../../src/diagnostics.h
+SOURCES += ../../src/diagnostics.cpp
+HEADERS += ../../src/punchfile.h
+SOURCES += ../../src/punchfile.cpp
+HEADERS += ../../src/punchindex.h
+SOURCES += ../../src/punchindex.cpp
+HEADERS += ../../src/punchschema.h
+SOURCES += ../../src/punchschema.cpp
+HEADERS += ../../src/symboltable.h
+SOURCES += ../../src/symboltable.cpp
+HEADERS += ../../src/numberparser.h
+SOURCES += ../../src/numberparser.cpp
+HEADERS += ../../src/writer.h
+SOURCES += ../../src/writer.cpp
@@ -0,0 +1,319 @@
+/* - pch2csv - Copyright (C) 2016 Sebastien Vavassori
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <PunchFile.h>
+#include <SymbolTable.h>
+
+#include <QtTest/QtTest>
+#include <QtCore/QDebug>
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+class tst_SymbolTable : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void test_intern();
+    void test_intern_in_threads();
+
+    void test_block_headers();
+    void test_block_groups();
+    void test_block_groups_merge();
+    void test_block_format();
+    void test_block_format_comma();
+
+};
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_SymbolTable::test_intern()
+{
+    SymbolTable &table = SymbolTable::instance();
+
+    const int title = table.intern("TITLE");
+    const int subcase = table.intern("SUBCASE ID");
+    const std::size_t size = table.size();
+
+    QVERIFY(title != subcase);
+    QCOMPARE(table.intern("TITLE"), title);
+    QCOMPARE(table.intern(std::string("SUBCASE ID")), subcase);
+    QCOMPARE(table.size(), size);
+    QCOMPARE(QString::fromStdString(table.symbol(title)), QString("TITLE"));
+    QCOMPARE(QString::fromStdString(table.symbol(subcase)), QString("SUBCASE ID"));
+}
+
+void tst_SymbolTable::test_intern_in_threads()
+{
+    SymbolTable &table = SymbolTable::instance();
+    std::vector<std::vector<int> > ids(4);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.push_back( std::thread([&table, &ids, t]() {
+            for (int i = 0; i < 1000; ++i) {
+                ids[t].push_back( table.intern("SUBCASE " + std::to_string(i)) );
+            }
+        }));
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    for (int i = 0; i < 1000; ++i) {
+        QCOMPARE(ids[1][i], ids[0][i]);
+        QCOMPARE(ids[2][i], ids[0][i]);
+        QCOMPARE(ids[3][i], ids[0][i]);
+        QCOMPARE(table.symbol(ids[0][i]), "SUBCASE " + std::to_string(i));
+    }
+}
+
+/******************************************************************************
+ ******************************************************************************/
+void tst_SymbolTable::test_block_headers()
+{
+    // Given
+    PunchBlock block1;
+    block1.insertPrefix("TITLE", "JOB");
+    block1.insertPrefix("SUBCASE ID", "1");
+    block1.insertPrefix("LABEL", "LOAD");
+    block1.insertPrefix("SUBCASE ID", "2");
+    block1.append(PunchRow({ "1", "G" }));
+
+    PunchBlock block2;
+    block2.insertPrefix("LABEL", "OTHER");
+    block2.insertPrefix("TITLE", "JOB");
+    block2.insertPrefix("SUBCASE ID", "3");
+    block2.append(PunchRow({ "2", "G" }));
+
+    // When
+    PunchFile pch;
+    pch.append(block1);
+    pch.append(block2);
+
+    // Then
+    QCOMPARE(block1.prefixCount(), 3);
+    QCOMPARE(QString::fromStdString(block1.prefixKey(0)), QString("LABEL"));
+    QCOMPARE(QString::fromStdString(block1.prefixKey(1)), QString("SUBCASE ID"));
+    QCOMPARE(QString::fromStdString(block1.prefixValue(1)), QString("2"));
+    QCOMPARE(QString::fromStdString(block1.prefixKey(2)), QString("TITLE"));
+
+    QCOMPARE(int(pch.blockKeys().size()), 1);
+    const std::string key = *pch.blockKeys().begin();
+    QCOMPARE(QString::fromStdString(key), QString("LABEL,SUBCASE ID,TITLE,2"));
+    auto range = pch.blockRange(key);
+    QCOMPARE(int(std::distance(range.first, range.second)), 2);
+    QCOMPARE(QString::fromStdString(range.first->prefixValue(0)), QString("LOAD"));
+
+    auto none = pch.blockRange("UNKNOWN,2");
+    QVERIFY(none.first == none.second);
+}
+
+void tst_SymbolTable::test_block_groups()
+{
+    /* The keys have dense ids, and the blocks keep the order of the file */
+    // Given
+    PunchFile pch;
+    const int blockCount = 100000;
+
+    // When
+    for (int i = 0; i < blockCount; ++i) {
+        PunchBlock block;
+        block.insertPrefix((i % 3 == 0) ? "SUBCASE ID" : "LABEL", std::to_string(i));
+        block.append(PunchRow({ std::to_string(i), "G" }));
+        pch.append( std::move(block) );
+    }
+
+    // Then
+    QCOMPARE(pch.keyCount(), 2);
+    QCOMPARE(QString::fromStdString(pch.key(0)), QString("SUBCASE ID,2"));
+    QCOMPARE(QString::fromStdString(pch.key(1)), QString("LABEL,2"));
+    QCOMPARE(pch.keyId("LABEL,2"), 1);
+    QCOMPARE(pch.keyId("UNKNOWN,2"), -1);
+
+    /* In the order of the keys, like blockKeys() */
+    const std::vector<int> ids = pch.keyIds();
+    QCOMPARE(int(ids.size()), 2);
+    QCOMPARE(ids[0], 1);
+    QCOMPARE(ids[1], 0);
+    QCOMPARE(pch.key(ids[0]), *pch.blockKeys().begin());
+
+    QCOMPARE(pch.blockCount(0), (blockCount + 2) / 3);
+    QCOMPARE(pch.blockCount(1), blockCount - (blockCount + 2) / 3);
+    QCOMPARE(QString::fromStdString(pch.block(0, 0).prefixValue(0)), QString("0"));
+    QCOMPARE(QString::fromStdString(pch.block(0, 1000).prefixValue(0)), QString("3000"));
+    QCOMPARE(QString::fromStdString(pch.block(1, 1000).prefixValue(0)), QString("1501"));
+
+    auto range = pch.blockRange(1);
+    QCOMPARE(int(std::distance(range.first, range.second)), pch.blockCount(1));
+    int previous = -1;
+    for (auto it = range.first; it != range.second; ++it) {
+        const int i = std::stoi(it->prefixValue(0));
+        QVERIFY(i > previous);
+        previous = i;
+    }
+}
+
+void tst_SymbolTable::test_block_groups_merge()
+{
+    // Given
+    PunchFile pch1;
+    PunchFile pch2;
+    for (int i = 0; i < 4; ++i) {
+        PunchBlock block;
+        block.insertPrefix("LABEL", std::to_string(i));
+        block.append(PunchRow({ "1", "G" }));
+        pch1.append(block);
+        block.insertPrefix("TITLE", "JOB");
+        pch2.append(block);
+        block.clear();
+        block.insertPrefix("LABEL", std::to_string(10 + i));
+        block.append(PunchRow({ "1", "G" }));
+        pch2.append(block);
+    }
+
+    // When
+    PunchFile copy;
+    copy += pch2;
+    PunchFile moved;
+    moved += std::move(pch1);
+    moved += std::move(pch2);
+
+    // Then
+    QCOMPARE(copy.keyCount(), 2);
+    QCOMPARE(copy.keyId("LABEL,TITLE,2"), 0);
+    QCOMPARE(copy.blockCount(copy.keyId("LABEL,2")), 4);
+
+    QCOMPARE(pch1.keyCount(), 0);
+    QCOMPARE(pch2.keyCount(), 0);
+    QCOMPARE(moved.keyCount(), 2);
+    const int id = moved.keyId("LABEL,2");
+    QCOMPARE(id, 0);
+    QCOMPARE(moved.blockCount(id), 8);
+    for (int i = 0; i < 8; ++i) {
+        const int expected = (i < 4) ? i : (10 + i - 4);
+        QCOMPARE(moved.block(id, i).prefixValue(0), std::to_string(expected));
+    }
+    QCOMPARE(moved.blockCount(moved.keyId("LABEL,TITLE,2")), 4);
+}
+
+void tst_SymbolTable::test_block_format()
+{
+    // Given
+    PunchBlock block;
+    block.insertPrefix("TITLE", "JOB");
+    block.insertPrefix("LABEL", "1");
+    block.append(PunchRow({ "1", "G" }));
+    block.updateFormat();
+
+    PunchBlock other;
+    other.insertPrefix("LABEL", "2");
+    other.insertPrefix("TITLE", "OTHER JOB");
+    other.append(PunchRow({ "2", "G" }));
+    other.append(PunchRow({ "3", "G" }));
+
+    // Then
+    /* The values of the header don't change the format */
+    QCOMPARE(QString::fromStdString(block.formatKey()), QString("LABEL,TITLE,2"));
+    QCOMPARE(QString::fromStdString(other.formatKey()), QString("LABEL,TITLE,2"));
+    QVERIFY(block.formatFingerprint() == other.formatFingerprint());
+    QCOMPARE(block.prefixKeyId(0), SymbolTable::instance().intern("LABEL"));
+    QCOMPARE(block.prefixKeyId(1), other.prefixKeyId(1));
+
+    /* The copies keep the fingerprint */
+    PunchFile pch;
+    pch.append(block);
+    QVERIFY(pch.block(0, 0).formatFingerprint() == block.formatFingerprint());
+
+    /* Modifying the header or the columns changes it */
+    const std::uint64_t fingerprint = other.formatFingerprint();
+    other.insertPrefix("SUBCASE ID", "1");
+    QVERIFY(other.formatFingerprint() != fingerprint);
+
+    other.removeRows();
+    other.insertPrefix("SUBCASE ID", "2");   /* Same key */
+    other.append(PunchRow({ "2", "G", "0.0" }));
+    QCOMPARE(QString::fromStdString(other.formatKey()), QString("LABEL,SUBCASE ID,TITLE,3"));
+    const std::uint64_t fingerprint3 = other.formatFingerprint();
+    QVERIFY(fingerprint3 != fingerprint);
+
+    other.append(PunchRow({ "3", "G" }));    /* Only the first row gives the columns */
+    QVERIFY(other.formatFingerprint() == fingerprint3);
+
+    other.clear();
+    other.insertPrefix("LABEL", "3");
+    other.insertPrefix("TITLE", "JOB");
+    other.append(PunchRow({ "4", "G" }));
+    QVERIFY(other.formatFingerprint() == fingerprint);
+
+    /* A lazy block has the format of its columns */
+    other.setLoader([]() { return PunchBlock(); }, 10, 3);
+    QVERIFY(other.formatFingerprint() != fingerprint);
+    QCOMPARE(QString::fromStdString(other.formatKey()), QString("LABEL,TITLE,3"));
+
+    pch.append(other);
+    QCOMPARE(pch.keyCount(), 2);
+    QCOMPARE(pch.keyId("LABEL,TITLE,3"), 1);
+}
+
+void tst_SymbolTable::test_block_format_comma()
+{
+    /* The joined keys would be the same text "A,B,2" */
+    // Given
+    PunchBlock comma;
+    comma.insertPrefix("A,B", "1");
+    comma.append(PunchRow({ "1", "G" }));
+
+    PunchBlock keys;
+    keys.insertPrefix("A", "1");
+    keys.insertPrefix("B", "2");
+    keys.append(PunchRow({ "1", "G" }));
+
+    PunchBlock backslash;
+    backslash.insertPrefix("A\\", "1");
+    backslash.insertPrefix("B", "2");
+    backslash.append(PunchRow({ "1", "G" }));
+
+    // When
+    PunchFile pch;
+    pch.append(comma);
+    pch.append(keys);
+    pch.append(backslash);
+
+    // Then
+    QCOMPARE(QString::fromStdString(comma.formatKey()), QString("A\\,B,2"));
+    QCOMPARE(QString::fromStdString(keys.formatKey()), QString("A,B,2"));
+    QCOMPARE(QString::fromStdString(backslash.formatKey()), QString("A\\\\,B,2"));
+
+    QCOMPARE(pch.keyCount(), 3);
+    QCOMPARE(int(pch.blockKeys().size()), 3);
+    for (const std::string &key : pch.blockKeys()) {
+        auto range = pch.blockRange(key);
+        QCOMPARE(int(range.second - range.first), 1);
+        QCOMPARE(range.first->formatKey(), key);
+    }
+    QCOMPARE(pch.block(pch.keyId("A\\,B,2"), 0).prefixKey(0), std::string("A,B"));
+    QCOMPARE(pch.block(pch.keyId("A,B,2"), 0).prefixCount(), 2);
+}
+
+QTEST_APPLESS_MAIN(tst_SymbolTable)
+
+#include "tst_symboltable.moc"
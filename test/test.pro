@@ -1,6 +1,22 @@
 TEMPLATE = subdirs
 CONFIG  += ordered
 
+SUBDIRS += $$PWD/arena
+SUBDIRS += $$PWD/benchmark
+SUBDIRS += $$PWD/blockfilter
+SUBDIRS += $$PWD/blockspiller
+SUBDIRS += $$PWD/complexconverter
 SUBDIRS += $$PWD/csvcomparer
+SUBDIRS += $$PWD/decompressor
+SUBDIRS += $$PWD/diagnostics
+SUBDIRS += $$PWD/filefollower
 SUBDIRS += $$PWD/filemanager
+SUBDIRS += $$PWD/idset
+SUBDIRS += $$PWD/inputpipeline
+SUBDIRS += $$PWD/numberparser
+SUBDIRS += $$PWD/punchindex
+SUBDIRS += $$PWD/punchschema
+SUBDIRS += $$PWD/recordscanner
 SUBDIRS += $$PWD/scanner
+SUBDIRS += $$PWD/scanner_scalar
+SUBDIRS += $$PWD/symboltable